@@ -0,0 +1,254 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSAdpcm.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSAdpcm.h"
+
+// Saturation to 16 bits is a single instruction on the Cortex-M4
+#if defined(__ARM_FEATURE_SAT)
+#include <arm_acle.h>
+#define ADPCM_SAT16(x)			__ssat((x), 16)
+#else
+#define ADPCM_SAT16(x)			((x) > 32767 ? 32767 : ((x) < -32768 ? -32768 : (x)))
+#endif
+
+static const int16_t step_table[89] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55,
+	60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411,
+	1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500,
+	20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t index_table[16] =
+{
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// Decodes one nibble. The difference is (nibble + 0.5) * step / 4, built with shifts.
+static inline int32_t decodeNibble(uint32_t nibble, int32_t predictor, int32_t* index)
+{
+	int32_t step = step_table[*index];
+	int32_t diff = step >> 3;
+
+	if (nibble & 4) diff += step;
+	if (nibble & 2) diff += step >> 1;
+	if (nibble & 1) diff += step >> 2;
+
+	*index += index_table[nibble];
+	if (*index < 0)
+		*index = 0;
+	else if (*index > 88)
+		*index = 88;
+
+	predictor += (nibble & 8) ? -diff : diff;
+	return ADPCM_SAT16(predictor);
+}
+
+// Picks the nibble that gets closest to 'sample', and moves the state as the decoder will
+static inline uint32_t encodeNibble(int32_t sample, int32_t* predictor, int32_t* index)
+{
+	int32_t step = step_table[*index];
+	int32_t diff = sample - *predictor;
+	uint32_t nibble = 0;
+
+	if (diff < 0)
+	{
+		nibble = 8;
+		diff = -diff;
+	}
+
+	if (diff >= step)
+	{
+		nibble |= 4;
+		diff -= step;
+	}
+
+	step >>= 1;
+	if (diff >= step)
+	{
+		nibble |= 2;
+		diff -= step;
+	}
+
+	step >>= 1;
+	if (diff >= step)
+		nibble |= 1;
+
+	*predictor = decodeNibble(nibble, *predictor, index);
+	return nibble;
+}
+
+bool PBSAdpcm::supported(uint32_t block_align, uint8_t channels)
+{
+	return (channels == 1 || channels == 2) && block_align <= PBS_ADPCM_MAX_BLOCK &&
+		   block_align > channels * 4U && (block_align % (channels * 4U)) == 0;
+}
+
+uint32_t PBSAdpcm::blockFrames(uint32_t size, uint8_t channels)
+{
+	uint32_t header = channels * 4U;
+
+	if (!channels || size < header)
+		return 0;
+
+	return 1 + ((size - header) / header) * 8;
+}
+
+uint32_t PBSAdpcm::frames(uint32_t data_size, uint32_t block_align, uint8_t channels)
+{
+	if (!block_align)
+		return 0;
+
+	return (data_size / block_align) * blockFrames(block_align, channels) +
+		   blockFrames(data_size % block_align, channels);
+}
+
+uint32_t PBSAdpcm::decodeBlock(const uint8_t* block, uint32_t size, uint8_t channels,
+							   int16_t* out)
+{
+	uint32_t frames = blockFrames(size, channels);
+	uint32_t groups = (frames - 1) / 8;
+
+	if (!frames)
+		return 0;
+
+	for (uint32_t ch = 0; ch < channels; ch++)
+	{
+		// Channels are decoded one after the other, into their slots of the output frames
+		const uint8_t* header = block + ch * 4;
+		const uint8_t* src = block + channels * 4 + ch * 4;
+		int16_t* dst = out + ch;
+		int32_t predictor = (int16_t) (header[0] | (header[1] << 8));
+		int32_t index = header[2] > 88 ? 88 : header[2];
+
+		*dst = (int16_t) predictor;
+		dst += channels;
+
+		for (uint32_t g = 0; g < groups; g++, src += channels * 4)
+		{
+			// 8 samples, low nibble first
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				uint32_t byte = src[i];
+
+				predictor = decodeNibble(byte & 0x0F, predictor, &index);
+				*dst = (int16_t) predictor;
+				dst += channels;
+
+				predictor = decodeNibble(byte >> 4, predictor, &index);
+				*dst = (int16_t) predictor;
+				dst += channels;
+			}
+		}
+	}
+
+	return frames;
+}
+
+uint32_t PBSAdpcm::decodeHeader(const uint8_t* part, uint8_t channels, adpcmState* state,
+								int16_t* out)
+{
+	for (uint32_t ch = 0; ch < channels; ch++, part += 4)
+	{
+		state->predictor[ch] = (int16_t) (part[0] | (part[1] << 8));
+		state->index[ch] = part[2] > 88 ? 88 : part[2];
+		out[ch] = (int16_t) state->predictor[ch];
+	}
+
+	return 1;
+}
+
+uint32_t PBSAdpcm::decodeGroup(const uint8_t* part, uint8_t channels, adpcmState* state,
+							   int16_t* out)
+{
+	for (uint32_t ch = 0; ch < channels; ch++, part += 4)
+	{
+		int16_t* dst = out + ch;
+		int32_t predictor = state->predictor[ch];
+		int32_t index = state->index[ch];
+
+		// 8 samples, low nibble first
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			uint32_t byte = part[i];
+
+			predictor = decodeNibble(byte & 0x0F, predictor, &index);
+			*dst = (int16_t) predictor;
+			dst += channels;
+
+			predictor = decodeNibble(byte >> 4, predictor, &index);
+			*dst = (int16_t) predictor;
+			dst += channels;
+		}
+
+		state->predictor[ch] = predictor;
+		state->index[ch] = index;
+	}
+
+	return PBS_ADPCM_GROUP_FRAMES;
+}
+
+uint32_t PBSAdpcm::encodeBlock(const int16_t* in, uint32_t frames, uint8_t channels,
+							   uint8_t* index, uint8_t* block)
+{
+	uint32_t groups = frames ? (frames - 1) / 8 : 0;
+
+	if (!frames || !channels)
+		return 0;
+
+	for (uint32_t ch = 0; ch < channels; ch++)
+	{
+		uint8_t* header = block + ch * 4;
+		uint8_t* dst = block + channels * 4 + ch * 4;
+		const int16_t* src = in + channels + ch;
+		int32_t predictor = in[ch];
+		int32_t idx = index[ch] > 88 ? 88 : index[ch];
+
+		header[0] = (uint8_t) predictor;
+		header[1] = (uint8_t) (predictor >> 8);
+		header[2] = (uint8_t) idx;
+		header[3] = 0;
+
+		for (uint32_t g = 0; g < groups; g++, dst += channels * 4)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				uint32_t low = encodeNibble(*src, &predictor, &idx);
+				src += channels;
+				uint32_t high = encodeNibble(*src, &predictor, &idx);
+				src += channels;
+
+				dst[i] = (uint8_t) (low | (high << 4));
+			}
+		}
+
+		index[ch] = (uint8_t) idx;
+	}
+
+	return channels * 4 * (groups + 1);
+}
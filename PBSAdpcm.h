@@ -0,0 +1,79 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSAdpcm.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSADPCM_H__
+#define __PBSADPCM_H__
+
+#include <Arduino.h>
+
+// IMA-ADPCM WAV files (format tag 0x11, 4 bits per sample). The audio data is a sequence of
+// blocks of block_align bytes. Each block starts with a 4-byte header per channel (first
+// sample and step index), followed by groups of 4 bytes (8 samples) of each channel in
+// turn. The last block may be shorter.
+#define PBS_ADPCM_FORMAT		0x11
+#define PBS_ADPCM_MAX_BLOCK		1024
+
+// Frames in a block of PBS_ADPCM_MAX_BLOCK bytes of a mono file, the most there can be
+#define PBS_ADPCM_MAX_FRAMES	((PBS_ADPCM_MAX_BLOCK - 4) * 2 + 1)
+
+// Frames in a group of a block, the most a part decoded on its own gives
+#define PBS_ADPCM_GROUP_FRAMES	8
+
+// Predictor and step index of each channel, carried from a part of a block to the next
+typedef struct
+{
+	int32_t predictor[2];
+	int32_t index[2];
+} adpcmState;
+
+class PBSAdpcm
+{
+public:
+	// Tells if blocks of this size can be decoded
+	static bool supported(uint32_t block_align, uint8_t channels);
+
+	// Frames (samples per channel) in a block of 'size' bytes, and in the whole audio data
+	static uint32_t blockFrames(uint32_t size, uint8_t channels);
+	static uint32_t frames(uint32_t data_size, uint32_t block_align, uint8_t channels);
+
+	// Decodes a block into interleaved 16-bit samples and returns the number of frames
+	static uint32_t decodeBlock(const uint8_t* block, uint32_t size, uint8_t channels,
+								int16_t* out);
+
+	// Decodes a block a part of channels * 4 bytes at a time, as the players stream it: its
+	// header, then each of its groups. They return the number of interleaved frames written.
+	static uint32_t decodeHeader(const uint8_t* part, uint8_t channels, adpcmState* state,
+								 int16_t* out);
+	static uint32_t decodeGroup(const uint8_t* part, uint8_t channels, adpcmState* state,
+								int16_t* out);
+
+	// Encodes 'frames' interleaved frames (1 + a multiple of 8) into a block and returns its
+	// size. 'index' holds the step index of each channel, carried from block to block.
+	// Used by the host tools.
+	static uint32_t encodeBlock(const int16_t* in, uint32_t frames, uint8_t channels,
+								uint8_t* index, uint8_t* block);
+};
+
+#endif /* __PBSADPCM_H__ */
@@ -0,0 +1,55 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSAudio.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSAUDIO_H__
+#define __PBSAUDIO_H__
+
+#include <Arduino.h>
+
+typedef enum
+{
+	AudioFormatPcm16,
+	AudioFormatImaAdpcm
+} AudioFormat;
+
+// Location and format of the audio data of a WAV file, or of a sound in a font pack. The
+// players (PBSPlayer.h) given one open the file and start reading at data_offset, without
+// parsing any header. The first data_cached bytes of the audio data may be in RAM at
+// 'data' (the sample cache, PBSCache.h); they play without opening the file.
+typedef struct
+{
+	uint32_t data_offset;
+	uint32_t data_size;
+	uint32_t sample_rate;
+	uint8_t channels;
+	uint8_t format;				// AudioFormat
+	uint16_t block_align;		// Bytes per block of IMA-ADPCM data
+	uint32_t loop_start;		// Loop region from the smpl chunk, in frames. loop_end is
+	uint32_t loop_end;			// past its last frame, or 0 to loop the whole sound.
+	const uint8_t* data;
+	uint32_t data_cached;
+} AudioTrackInfo;
+
+#endif /* __PBSAUDIO_H__ */
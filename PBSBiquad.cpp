@@ -0,0 +1,262 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSBiquad.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSBiquad.h"
+#include <math.h>
+
+// Two 16-bit multiplies added to a 64-bit accumulator, one instruction on the Cortex-M4.
+// The packing of two halfwords becomes a PKHBT.
+#if defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#define BIQUAD_SMLALD(x, y, acc)	__smlald((x), (y), (acc))
+#define BIQUAD_SAT16(x)			__ssat((x), 16)
+#else
+#define BIQUAD_SMLALD(x, y, acc)	((acc) + (int16_t) (x) * (int16_t) (y) + \
+									 ((int32_t) (x) >> 16) * ((int32_t) (y) >> 16))
+#define BIQUAD_SAT16(x)			((x) > 32767 ? 32767 : ((x) < -32768 ? -32768 : (x)))
+#endif
+
+#define BIQUAD_PACK(lo, hi)		((int32_t) (((uint32_t) (uint16_t) (lo)) | ((uint32_t) (hi) << 16)))
+
+#define BIQUAD_ONE				(1 << 30)
+
+static inline int32_t toQ30(float value)
+{
+	// a1 gets close to 2 at low frequencies, that doesn't fit
+	if (value >= 2.0f)
+		return INT32_MAX;
+
+	if (value <= -2.0f)
+		return INT32_MIN;
+
+	return (int32_t) lrintf(value * BIQUAD_ONE);
+}
+
+PBSBiquad::PBSBiquad() : type(BiquadOff), segments(0), segment_left(0), precise_now(false),
+	precise_next(false)
+{
+	memset(coefs, 0, sizeof(coefs));
+	coefs[0] = BIQUAD_ONE;
+	memcpy(target, coefs, sizeof(target));
+	memset(delta, 0, sizeof(delta));
+	reset();
+}
+
+void PBSBiquad::reset()
+{
+	x1 = x2 = 0;
+	y1 = y2 = 0;
+}
+
+void PBSBiquad::set(PBSBiquadType type, float freq, float q, uint32_t fs, uint32_t samples)
+{
+	float b[3] = { 1.0f, 0, 0 };
+	float a[3] = { 1.0f, 0, 0 };
+
+	if (!fs)
+		return;
+
+	if (freq < 10.0f)
+		freq = 10.0f;
+	else if (freq > fs * 0.45f)
+		freq = fs * 0.45f;
+
+	if (q < 0.1f)
+		q = 0.1f;
+
+	if (type != BiquadOff)
+	{
+		float w0 = 2.0f * (float) M_PI * freq / fs;
+		float cosw = cosf(w0);
+		float alpha = sinf(w0) / (2.0f * q);
+
+		switch (type)
+		{
+			case BiquadLowPass:
+				b[0] = b[2] = (1.0f - cosw) / 2.0f;
+				b[1] = 1.0f - cosw;
+				break;
+			case BiquadHighPass:
+				b[0] = b[2] = (1.0f + cosw) / 2.0f;
+				b[1] = -(1.0f + cosw);
+				break;
+			default:
+				b[0] = alpha;
+				b[2] = -alpha;
+				break;
+		}
+
+		a[0] = 1.0f + alpha;
+		a[1] = -2.0f * cosw;
+		a[2] = 1.0f - alpha;
+	}
+
+	int32_t next[5];
+	next[0] = toQ30(b[0] / a[0]);
+	next[1] = toQ30(b[1] / a[0]);
+	next[2] = toQ30(b[2] / a[0]);
+	next[3] = toQ30(-a[1] / a[0]);
+	next[4] = toQ30(-a[2] / a[0]);
+
+	// Moving from a filter to another in a straight line keeps the poles inside the unit
+	// circle, as both ends are
+	uint32_t count = samples / PBS_BIQUAD_SEGMENT;
+	precise_now = precise();
+	precise_next = type != BiquadOff && freq * PBS_BIQUAD_PRECISE_DIV < fs;
+
+	if (!count)
+	{
+		memcpy(coefs, next, sizeof(coefs));
+		precise_now = precise_next;
+	} else {
+		for (uint32_t i = 0; i < 5; i++)
+			delta[i] = (int32_t) (((int64_t) next[i] - coefs[i]) / count);
+	}
+
+	if (this->type == BiquadOff && !segments)
+		reset();
+
+	memcpy(target, next, sizeof(target));
+	segments = count;
+	segment_left = PBS_BIQUAD_SEGMENT;
+	this->type = type;
+}
+
+void PBSBiquad::processFast(int16_t* buffer, uint32_t count)
+{
+	// Q14 coefficients, pairs of them against pairs of samples
+	int32_t b01 = BIQUAD_PACK(coefs[0] >> 16, coefs[1] >> 16);
+	int32_t b2a1 = BIQUAD_PACK(coefs[2] >> 16, coefs[3] >> 16);
+	int32_t a2 = coefs[4] >> 16;
+	int32_t x_1 = x1, x_2 = x2;
+	int32_t y_1 = BIQUAD_SAT16(y1 >> 8);
+	int32_t y_2 = BIQUAD_SAT16(y2 >> 8);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int32_t x0 = buffer[i];
+		int64_t acc = BIQUAD_SMLALD(BIQUAD_PACK(x0, x_1), b01, (int64_t) (1 << 13));
+		acc = BIQUAD_SMLALD(BIQUAD_PACK(x_2, y_1), b2a1, acc);
+		acc += y_2 * a2;
+		acc >>= 14;
+
+		// Saturated before it's narrowed
+		if (acc > 32767)
+			acc = 32767;
+		else if (acc < -32768)
+			acc = -32768;
+
+		int32_t y0 = (int32_t) acc;
+		buffer[i] = (int16_t) y0;
+		x_2 = x_1;
+		x_1 = x0;
+		y_2 = y_1;
+		y_1 = y0;
+	}
+
+	x1 = (int16_t) x_1;
+	x2 = (int16_t) x_2;
+	y1 = y_1 << 8;
+	y2 = y_2 << 8;
+}
+
+void PBSBiquad::processPrecise(int16_t* buffer, uint32_t count)
+{
+	// Q30 coefficients and the output history with 8 more bits, into a 64-bit accumulator
+	// (SMLAL on the Cortex-M4)
+	int32_t x_1 = x1, x_2 = x2;
+	int32_t y_1 = y1, y_2 = y2;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int32_t x0 = buffer[i];
+		int64_t acc = (int64_t) coefs[0] * x0;
+		acc += (int64_t) coefs[1] * x_1;
+		acc += (int64_t) coefs[2] * x_2;
+		acc <<= 8;
+		acc += (int64_t) coefs[3] * y_1;
+		acc += (int64_t) coefs[4] * y_2;
+
+		int32_t y0 = (int32_t) ((acc + (1 << 29)) >> 30);
+		int32_t out = (y0 + (1 << 7)) >> 8;
+
+		buffer[i] = (int16_t) BIQUAD_SAT16(out);
+		x_2 = x_1;
+		x_1 = x0;
+		y_2 = y_1;
+		y_1 = y0;
+	}
+
+	x1 = (int16_t) x_1;
+	x2 = (int16_t) x_2;
+	y1 = y_1;
+	y2 = y_2;
+}
+
+void PBSBiquad::process(int16_t* buffer, uint32_t count)
+{
+	if (!active())
+		return;
+
+	while (count)
+	{
+		// Whole segments while the coefficients move, all the rest when they don't
+		uint32_t run = segments ? segment_left : count;
+		if (run > count)
+			run = count;
+
+		if (precise())
+			processPrecise(buffer, run);
+		else
+			processFast(buffer, run);
+
+		buffer += run;
+		count -= run;
+
+		if (!segments)
+			continue;
+
+		segment_left -= run;
+		if (segment_left)
+			continue;
+
+		segment_left = PBS_BIQUAD_SEGMENT;
+		if (--segments)
+		{
+			for (uint32_t i = 0; i < 5; i++)
+				coefs[i] += delta[i];
+		} else {
+			memcpy(coefs, target, sizeof(coefs));
+			precise_now = precise_next;
+
+			// Flat: nothing left to do
+			if (type == BiquadOff)
+			{
+				reset();
+				break;
+			}
+		}
+	}
+}
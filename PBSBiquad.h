@@ -0,0 +1,82 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSBiquad.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSBIQUAD_H__
+#define __PBSBIQUAD_H__
+
+#include <Arduino.h>
+
+typedef enum
+{
+	BiquadOff,
+	BiquadLowPass,
+	BiquadHighPass,
+	BiquadBandPass			// 0 dB at the center frequency
+} PBSBiquadType;
+
+// While the coefficients move, they are updated every PBS_BIQUAD_SEGMENT samples
+#define PBS_BIQUAD_SEGMENT		16
+
+// Below fs / PBS_BIQUAD_PRECISE_DIV the filter runs with 32-bit coefficients and a 64-bit
+// accumulator. Above, 16-bit coefficients and samples are enough, and it runs two
+// multiply-accumulates per instruction on the Cortex-M4.
+#define PBS_BIQUAD_PRECISE_DIV	8
+
+// Second-order IIR filter (RBJ cookbook designs), in direct form I. Coefficients are kept
+// in Q30. Changing the filter moves the coefficients to the new ones in a straight line, so
+// the cutoff can follow the motion without clicks.
+class PBSBiquad
+{
+public:
+	PBSBiquad();
+
+	// Designs the filter and moves there over 'samples' samples (at once if 0). BiquadOff
+	// moves to a flat response, and the filter stops when it gets there.
+	void set(PBSBiquadType type, float freq, float q, uint32_t fs, uint32_t samples);
+	void reset();
+
+	bool active() { return type != BiquadOff || segments; }
+	bool precise() { return precise_now || precise_next; }
+
+	// Filters 'count' samples in place
+	void process(int16_t* buffer, uint32_t count);
+
+private:
+	void processFast(int16_t* buffer, uint32_t count);
+	void processPrecise(int16_t* buffer, uint32_t count);
+
+	PBSBiquadType type;
+	int32_t coefs[5];						// b0, b1, b2, -a1, -a2
+	int32_t target[5];
+	int32_t delta[5];						// Per segment
+	uint32_t segments;						// Left to reach the target
+	uint32_t segment_left;					// Samples left in the current segment
+	bool precise_now;
+	bool precise_next;
+	int16_t x1, x2;
+	int32_t y1, y2;							// Q8
+};
+
+#endif /* __PBSBIQUAD_H__ */
@@ -0,0 +1,279 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSCache.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSCache.h"
+
+#define CACHE_FREE		0xFFFFFFFF
+
+PBSCache::PBSCache()
+{
+	memset(entries, 0, sizeof(entries));
+
+	for (uint32_t i = 0; i < PBS_CACHE_ENTRIES; i++)
+		entries[i].offset = CACHE_FREE;
+
+	count = used = use_counter = 0;
+	arena = NULL;
+	pending = NULL;
+	pending_read = 0;
+}
+
+PBSCache::~PBSCache()
+{
+	if (pending)
+		f_close(&file);
+
+	delete[] arena;
+}
+
+void PBSCache::pin(uint32_t font_id)
+{
+	// Only the files of the font in use stay no matter what
+	for (uint32_t i = 0; i < PBS_CACHE_ENTRIES; i++)
+	{
+		if (entries[i].offset != CACHE_FREE)
+			entries[i].pinned = (entries[i].font_id == font_id);
+	}
+}
+
+cacheEntry* PBSCache::lookup(uint32_t font_id, uint8_t type, uint32_t num)
+{
+	for (uint32_t i = 0; i < PBS_CACHE_ENTRIES; i++)
+	{
+		cacheEntry* entry = &entries[i];
+
+		if (entry->offset != CACHE_FREE && !entry->loading && entry->font_id == font_id &&
+			entry->type == type && entry->num == num)
+			return entry;
+	}
+
+	return NULL;
+}
+
+const AudioTrackInfo* PBSCache::find(uint32_t font_id, uint8_t type, uint32_t num)
+{
+	cacheEntry* entry = lookup(font_id, type, num);
+
+	if (!entry)
+		return NULL;
+
+	entry->last_used = ++use_counter;
+	return &entry->track;
+}
+
+bool PBSCache::allocate(uint32_t size, uint32_t* offset)
+{
+	// First fit: look for a gap between the files, in arena order
+	uint32_t start = 0;
+
+	for (;;)
+	{
+		uint32_t next = PBS_CACHE_SIZE;
+		uint32_t end = 0;
+		bool overlap = false;
+
+		for (uint32_t i = 0; i < PBS_CACHE_ENTRIES && !overlap; i++)
+		{
+			cacheEntry* entry = &entries[i];
+
+			if (entry->offset == CACHE_FREE || entry->offset + entry->size <= start)
+				continue;
+
+			if (entry->offset <= start)
+			{
+				// The gap can't start here, skip this file
+				start = entry->offset + entry->size;
+				overlap = true;
+			} else if (entry->offset < next)
+			{
+				next = entry->offset;
+				end = entry->offset + entry->size;
+			}
+		}
+
+		if (overlap)
+			continue;
+
+		if (next - start >= size)
+		{
+			*offset = start;
+			return true;
+		}
+
+		if (next == PBS_CACHE_SIZE)
+			return false;
+
+		start = end;
+	}
+}
+
+bool PBSCache::evict()
+{
+	cacheEntry* oldest = NULL;
+
+	for (uint32_t i = 0; i < PBS_CACHE_ENTRIES; i++)
+	{
+		cacheEntry* entry = &entries[i];
+
+		if (entry->offset == CACHE_FREE || entry->pinned || entry->loading)
+			continue;
+
+		if (!oldest || entry->last_used < oldest->last_used)
+			oldest = entry;
+	}
+
+	if (!oldest)
+		return false;
+
+	release(oldest);
+	return true;
+}
+
+void PBSCache::release(cacheEntry* entry)
+{
+	if (entry == pending)
+	{
+		f_close(&file);
+		pending = NULL;
+	}
+
+	used -= entry->size;
+	count--;
+	memset(entry, 0, sizeof(cacheEntry));
+	entry->offset = CACHE_FREE;
+}
+
+bool PBSCache::add(uint32_t font_id, uint8_t type, uint32_t num, const char* path,
+				   const AudioTrackInfo* track)
+{
+	cacheEntry* entry = NULL;
+	uint32_t head = track->data_size < PBS_CACHE_HEAD ? track->data_size : PBS_CACHE_HEAD;
+	uint32_t size = (head + 3) & ~3;
+	uint32_t offset;
+
+	if (lookup(font_id, type, num))
+		return true;
+
+	if (pending || !track->channels || !head)
+		return false;
+
+	if (!arena)
+	{
+		arena = new uint8_t[PBS_CACHE_SIZE];
+		if (!arena)
+			return false;
+	}
+
+	for (uint32_t i = 0; i < PBS_CACHE_ENTRIES && !entry; i++)
+	{
+		if (entries[i].offset == CACHE_FREE)
+			entry = &entries[i];
+	}
+
+	// Make room, if there are files of other fonts
+	while (!entry || !allocate(size, &offset))
+	{
+		if (!evict())
+			return false;
+
+		for (uint32_t i = 0; i < PBS_CACHE_ENTRIES && !entry; i++)
+		{
+			if (entries[i].offset == CACHE_FREE)
+				entry = &entries[i];
+		}
+	}
+
+	if (f_open(&file, path, FA_READ) != FR_OK)
+		return false;
+
+	if (f_lseek(&file, track->data_offset) != FR_OK)
+	{
+		f_close(&file);
+		return false;
+	}
+
+	// Reserved now, found once load() has read the whole file
+	entry->track = *track;
+	entry->track.data = arena + offset;
+	entry->track.data_cached = head;
+	entry->font_id = font_id;
+	entry->offset = offset;
+	entry->size = size;
+	entry->last_used = ++use_counter;
+	entry->num = (uint16_t) num;
+	entry->type = type;
+	entry->pinned = true;
+	entry->loading = true;
+
+	used += size;
+	count++;
+
+	pending = entry;
+	pending_read = 0;
+	return true;
+}
+
+bool PBSCache::load()
+{
+	cacheEntry* entry = pending;
+	uint32_t size;
+	UINT read;
+
+	if (!entry)
+		return false;
+
+	size = entry->track.data_cached - pending_read;
+	if (size > PBS_CACHE_READ)
+		size = PBS_CACHE_READ;
+
+	if (f_read(&file, arena + entry->offset + pending_read, size, &read) != FR_OK ||
+		read != size)
+	{
+		debugMsg(DebugWarning, "Error caching sound %lu of font%lu", (uint32_t) entry->num,
+				 entry->font_id);
+		release(entry);
+		return false;
+	}
+
+	pending_read += size;
+
+	if (pending_read == entry->track.data_cached)
+	{
+		f_close(&file);
+		pending = NULL;
+		entry->loading = false;
+	}
+
+	return true;
+}
+
+void PBSCache::flush(uint32_t font_id)
+{
+	for (uint32_t i = 0; i < PBS_CACHE_ENTRIES; i++)
+	{
+		if (entries[i].offset != CACHE_FREE && entries[i].font_id == font_id)
+			release(&entries[i]);
+	}
+}
@@ -0,0 +1,103 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSCache.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSCACHE_H__
+#define __PBSCACHE_H__
+
+#include <Arduino.h>
+#include "PBSAudio.h"
+#include "PBSDebug.h"
+
+// RAM taken by the sample cache, allocated when the first file is added. The players keep
+// their rings in the same RAM, so only the start of every sound is cached: 2 KB is ~46 ms
+// at 22050 Hz, time enough for the file to be opened and read while it plays. Shorter
+// sounds are cached whole, and never read from the SD.
+#ifndef PBS_CACHE_SIZE
+#define PBS_CACHE_SIZE			(32 * 1024)
+#endif
+
+#ifndef PBS_CACHE_HEAD
+#define PBS_CACHE_HEAD			(2 * 1024)
+#endif
+
+#define PBS_CACHE_ENTRIES		32
+
+// Files are read a chunk per call of load()
+#define PBS_CACHE_READ			4096
+
+// The start of a sound file held in the cache. track.data points into the arena, and
+// track.data_cached is the size of it.
+typedef struct
+{
+	AudioTrackInfo track;
+	uint32_t font_id;
+	uint32_t offset;			// In the arena, 0xFFFFFFFF if the entry is free
+	uint32_t size;
+	uint32_t last_used;
+	uint16_t num;
+	uint8_t type;
+	bool pinned;
+	bool loading;				// Not found until the whole file is read
+} cacheEntry;
+
+// Keeps the start of sound files in RAM, so they start playing without waiting for the SD.
+// Files are placed in a fixed arena, and read a chunk at a time. Files of the current font
+// are pinned; the others are evicted, least recently used first, when there is no room
+// for a new file.
+class PBSCache
+{
+public:
+	PBSCache();
+	~PBSCache();
+	void pin(uint32_t font_id);
+	bool add(uint32_t font_id, uint8_t type, uint32_t num, const char* path,
+			 const AudioTrackInfo* track);
+	bool load();
+	const AudioTrackInfo* find(uint32_t font_id, uint8_t type, uint32_t num);
+	void flush(uint32_t font_id);
+
+	inline bool loading() { return pending != NULL; }
+	inline uint32_t getUsed() { return used; }
+	inline uint32_t getCount() { return count; }
+
+private:
+	cacheEntry* lookup(uint32_t font_id, uint8_t type, uint32_t num);
+	bool allocate(uint32_t size, uint32_t* offset);
+	bool evict();
+	void release(cacheEntry* entry);
+
+	cacheEntry entries[PBS_CACHE_ENTRIES];
+	uint32_t count;
+	uint32_t used;
+	uint32_t use_counter;
+	uint8_t* arena;
+
+	// File being read by load()
+	cacheEntry* pending;
+	uint32_t pending_read;
+	FIL file;
+};
+
+#endif /* __PBSCACHE_H__ */
@@ -24,143 +24,394 @@
 ***************************************************************************/
 
 #include "PBSConfig.h"
+#include "PBSPack.h"
 
-PBSConfig::PBSConfig()
+#define SNAPSHOT_PROFILE_OFFSET(id) \
+	(sizeof(snapshotHeader) + ((id) - 1) * (sizeof(saberProfile) + sizeof(uint32_t)))
+
+#define SNAPSHOT_FONT_OFFSET(id) \
+	(SNAPSHOT_PROFILE_OFFSET(snapshot_profile_count + 1) + \
+	((id) - 1) * (sizeof(fontInfo) + sizeof(uint32_t)))
+
+// Key table entry for the 'field' member of the 'type' structure
+#define KEY(name, value_type, type, field, values, id, flags) \
+	{ name, value_type, id, flags, sizeof(((type*) 0)->field), offsetof(type, field), values }
+
+#define KEY_COUNT(table)	(sizeof(table) / sizeof(configKey))
+
+static const configEnumValue blade_types[] =
 {
-	hardware_offset = settings_offset = first_profile_offset = first_font_offset = 0;
-	profile_count = 0;
-}
+	{ "hbled", bladeHBLED },
+	{ "pixel", bladeStrip },
+	{ NULL, 0 }
+};
 
-bool PBSConfig::readSettings()
+static const configEnumValue strip_types[] =
 {
-	debugMsg(DebugInfo, "Reading general settings");
+	{ "apa102", APA102 },
+	{ "ws2812", WS2812B },
+	{ "sk6812rgbw", SK6812RGBW },
+	{ NULL, 0 }
+};
 
-	if (!config_file.setFileRWPointer(settings_offset))
-		return false;
+static const configEnumValue ignition_modes[] =
+{
+	{ "ramp", ignitionRamp },
+	{ "full", ignitionFull },
+	{ "scroll", ignitionScroll },
+	{ NULL, 0 }
+};
 
-	if (!config_file.startSectionScan("settings"))
-		return false;
+static const configEnumValue retraction_modes[] =
+{
+	{ "ramp", retractionRamp },
+	{ "full", retractionFull },
+	{ "scroll", retractionScroll },
+	{ NULL, 0 }
+};
 
-	memset(&settings, 0, sizeof(settings));
+static const configEnumValue shimmer_modes[] =
+{
+	{ "pulse", false },
+	{ "random", true },
+	{ NULL, 0 }
+};
 
-	char* key_name;
-	uint32_t key_len;
-	uint32_t token;
+static const configEnumValue effect_types[] =
+{
+	{ "static", effectTypeStatic },
+	{ "shimmer", effectTypeShimmer },
+	{ "flash", effectTypeFlash },
+	{ "spark", effectTypeSpark },
+	{ "flash_spark", effectTypeFlashSpark },
+	{ "big_spark", effectTypeBigSpark },
+	{ "tip_spark", effectTypeTipSpark },
+	{ "flash_flicker", effectTypeFlashFlicker },
+	{ NULL, 0 }
+};
+
+// [settings] keys, sorted by name
+static const configKey settings_keys[] =
+{
+	KEY("boot_log",					valueString,	saberSettings, boot_log,				NULL, 0, 0),
+	KEY("button_debounce",			valueNumber,	saberSettings, button_debounce,			NULL, 0, 0),
+	KEY("clash_limiter",			valueNumber,	saberSettings, clash_limiter,			NULL, 0, 0),
+	KEY("clash_sensitivity",		valueNumber,	saberSettings, clash_sensitivity,		NULL, 0, 0),
+	KEY("dump_boot_info",			valueBool,		saberSettings, dump_boot_info,			NULL, 0, 0),
+	KEY("dump_font_info",			valueBool,		saberSettings, dump_font_info,			NULL, 0, 0),
+	KEY("dump_profile_info",		valueBool,		saberSettings, dump_profile_info,		NULL, 0, 0),
+	KEY("dynamic_swing_depth",		valueNumber,	saberSettings, dynamic_swing_depth,		NULL, 0, 0),
+	KEY("hum_filter",				valueNumber,	saberSettings, hum_filter,				NULL, 0, 0),
+	KEY("hum_pitch",				valueNumber,	saberSettings, hum_pitch,				NULL, 0, 0),
+	KEY("initial_profile",			valueNumber,	saberSettings, initial_profile,			NULL, 0, 0),
+	KEY("limiter",					valueBool,		saberSettings, limiter,					NULL, 0, 0),
+	KEY("lock_button_time",			valueNumber,	saberSettings, lock_time,				NULL, 0, 0),
+	KEY("low_power",				valueNumber,	saberSettings, low_power,				NULL, 0, 0),
+	KEY("master_volume",			valueFloat,		saberSettings, master_volume,			NULL, 0, 0),
+	KEY("music_filter",				valueNumber,	saberSettings, music_filter,			NULL, 0, 0),
+	KEY("off_button_time",			valueNumber,	saberSettings, off_time,				NULL, 0, 0),
+	KEY("profile_count",			valueNumber,	saberSettings, profile_count,			NULL, 0, 0),
+	KEY("sound_utils",				valueString,	saberSettings, sound_utils,				NULL, 0, 0),
+	KEY("spin_limiter",				valueNumber,	saberSettings, spin_limiter,			NULL, 0, 0),
+	KEY("swing_limiter",			valueNumber,	saberSettings, swing_limiter,			NULL, 0, 0),
+	KEY("swing_sensitivity",		valueNumber,	saberSettings, swing_sensitivity,		NULL, 0, 0),
+	KEY("update_initial_profile",	valueBool,		saberSettings, update_initial_profile,	NULL, 0, 0),
+};
+
+// [hardware] keys, sorted by name
+typedef enum
+{
+	hwKeyBladeType,
+	hwKeyStripType,
+	hwKeyStripCount,
+	hwKeyHBLEDCurrent,
+	hwKeyHBLEDIsRGB,
+	hwKeyOnOffPad,
+	hwKeyOnOffPol,
+	hwKeyFxPad,
+	hwKeyFxPol,
+} hardwareKeyId;
+
+// saberHardware holds the button objects, so readHardwareConfiguration() resolves the
+// field of every key by its id.
+#define HW_KEY(name, value_type, field_type, values, id, flags) \
+	{ name, value_type, id, flags, sizeof(field_type), 0, values }
+
+static const configKey hardware_keys[] =
+{
+	HW_KEY("blade_type",		valueEnum,		bladeType,		blade_types, hwKeyBladeType, 0),
+	HW_KEY("fx_button_pad",		valueNumber,	uint32_t,		NULL, hwKeyFxPad, 0),
+	HW_KEY("fx_button_pol",		valueBool,		bool,			NULL, hwKeyFxPol, 0),
+	HW_KEY("hbled_current",		valueArray,		uint16_t[3],	NULL, hwKeyHBLEDCurrent, KEY_HBLED_ONLY),
+	HW_KEY("hbled_is_rgb",		valueBool,		bool,			NULL, hwKeyHBLEDIsRGB, KEY_HBLED_ONLY),
+	HW_KEY("onoff_button_pad",	valueNumber,	uint32_t,		NULL, hwKeyOnOffPad, 0),
+	HW_KEY("onoff_button_pol",	valueBool,		bool,			NULL, hwKeyOnOffPol, 0),
+	HW_KEY("pixel_count",		valueNumber,	uint32_t,		NULL, hwKeyStripCount, KEY_STRIP_ONLY),
+	HW_KEY("pixel_type",		valueEnum,		LedStripeType,	strip_types, hwKeyStripType, KEY_STRIP_ONLY),
+};
+
+// [profileN] keys, sorted by name
+typedef enum
+{
+	profileKeyOther = 0,
+	profileKeyIgnitionDuration,
+	profileKeyRetractionDuration,
+} profileKeyId;
+
+#define EFFECT_KEYS(name, effect) \
+	KEY(name "_blend",		valueNumber,	saberProfile, effect.blend,		NULL, 0, 0), \
+	KEY(name "_color",		valueColor,		saberProfile, effect.base_color, NULL, 0, 0), \
+	KEY(name "_depth",		valueNumber,	saberProfile, effect.depth,		NULL, 0, 0), \
+	KEY(name "_duration",	valueNumber,	saberProfile, effect.duration,	NULL, 0, 0), \
+	KEY(name "_freq",		valueNumber,	saberProfile, effect.freq,		NULL, 0, 0), \
+	KEY(name "_mode",		valueEnum,		saberProfile, effect.type,		effect_types, 0, 0), \
+	KEY(name "_random",		valueBool,		saberProfile, effect.randomize,	NULL, 0, 0)
+
+static const configKey profile_keys[] =
+{
+	EFFECT_KEYS("blaster", blaster),
+	EFFECT_KEYS("clash", clash),
+	KEY("font",					valueNumber,	saberProfile, font_num,				NULL, 0, 0),
+	KEY("ignition_duration",	valueNumber,	saberProfile, ignition_duration,	NULL,
+		profileKeyIgnitionDuration, 0),
+	KEY("ignition_mode",		valueEnum,		saberProfile, ignition_mode,		ignition_modes, 0, 0),
+	KEY("ignition_on_stab",		valueBool,		saberProfile, ignition_on_stab,		NULL, 0, 0),
+	EFFECT_KEYS("lockup", lockup),
+	KEY("retraction_duration",	valueNumber,	saberProfile, retraction_duration,	NULL,
+		profileKeyRetractionDuration, 0),
+	KEY("retraction_mode",		valueEnum,		saberProfile, retraction_mode,		retraction_modes, 0, 0),
+	KEY("shimmer_color",		valueColor,		saberProfile, shimmer.base_color,	NULL, 0, 0),
+	KEY("shimmer_depth",		valueNumber,	saberProfile, shimmer.depth,		NULL, 0, 0),
+	KEY("shimmer_freq",			valueNumber,	saberProfile, shimmer.freq,			NULL, 0, 0),
+	KEY("shimmer_mode",			valueEnum,		saberProfile, shimmer.randomize,	shimmer_modes, 0, 0),
+	EFFECT_KEYS("stab", stab),
+};
+
+// [fontN] keys, sorted by name
+typedef enum
+{
+	fontKeyOther = 0,
+	fontKeyPoly,
+} fontKeyId;
 
-	while (config_file.getNextKey(&token, &key_name, &key_len))
+#define SOUND_KEYS(name, sound) \
+	KEY(name,				valueSound,		fontInfo, files[sound],	NULL, 0, 0), \
+	KEY(name "_min_max",	valueMinMax,	fontInfo, files[sound],	NULL, 0, 0)
+
+static const configKey font_keys[] =
+{
+	SOUND_KEYS("background", fontBackground),
+	SOUND_KEYS("blaster", fontBlaster),
+	SOUND_KEYS("boot", fontBoot),
+	SOUND_KEYS("clash", fontClash),
+	KEY("folder",	valueString,	fontInfo, folder,	NULL, 0, 0),
+	SOUND_KEYS("force", fontForce),
+	SOUND_KEYS("hum", fontHum),
+	SOUND_KEYS("ignition", fontIgnition),
+	SOUND_KEYS("lock", fontLock),
+	SOUND_KEYS("low_power", fontLowPower),
+	KEY("name",		valueSound,		fontInfo, files[fontName],	NULL, 0, 0),
+	KEY("pack",		valueString,	fontInfo, pack,		NULL, 0, 0),
+	KEY("poly",		valueBool,		fontInfo, poly,		NULL, fontKeyPoly, 0),
+	SOUND_KEYS("retraction", fontRetraction),
+	SOUND_KEYS("spin", fontSpin),
+	SOUND_KEYS("stab", fontStab),
+	SOUND_KEYS("swing", fontSwing),
+	SOUND_KEYS("swingh", fontSwingHigh),
+	SOUND_KEYS("swingl", fontSwingLow),
+	KEY("title",	valueString,	fontInfo, title,	NULL, 0, KEY_KEEP_IF_EMPTY),
+};
+
+// Binary search of a key in a key table
+static const configKey* findKey(const configKey* keys, uint32_t count, const char* name,
+								uint32_t len)
+{
+	uint32_t low = 0;
+	uint32_t high = count;
+
+	while (low < high)
 	{
-		// Profile count
-		if (strncasecmp("profile_count", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.profile_count);
-			continue;
-		}
+		uint32_t mid = (low + high) / 2;
+		int32_t cmp = strncasecmp(keys[mid].name, name, len);
 
-		// Initial profile
-		if (strncasecmp("initial_profile", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.initial_profile);
-			continue;
-		}
+		// Same first 'len' characters but the table key is longer
+		if (cmp == 0 && keys[mid].name[len] != 0)
+			cmp = 1;
 
-		// Update initial profile
-		if (strncasecmp("update_initial_profile", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.update_initial_profile);
-			continue;
-		}
+		if (cmp == 0)
+			return &keys[mid];
 
-		// Low-power timeout
-		if (strncasecmp("low_power", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.low_power);
-			continue;
-		}
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
 
-		// Audio volume
-		if (strncasecmp("master_volume", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.master_volume);
-			continue;
-		}
+	return NULL;
+}
 
-		// Swing sensitivity
-		if (strncasecmp("swing_sensitivity", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.swing_sensitivity);
-			continue;
-		}
+// Sets an integer field of 1, 2 or 4 bytes
+static void setField(void* field, uint8_t size, uint32_t value)
+{
+	switch (size)
+	{
+		case 1: *(uint8_t*) field = (uint8_t) value; break;
+		case 2: *(uint16_t*) field = (uint16_t) value; break;
+		default: *(uint32_t*) field = value; break;
+	}
+}
 
-		// Swing limiter in milliseconds
-		if (strncasecmp("swing_limiter", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.swing_limiter);
-			continue;
-		}
+static uint32_t getField(const void* field, uint8_t size)
+{
+	switch (size)
+	{
+		case 1: return *(const uint8_t*) field;
+		case 2: return *(const uint16_t*) field;
+		default: return *(const uint32_t*) field;
+	}
+}
 
-		// Clash limiter in milliseconds
-		if (strncasecmp("clash_limiter", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.clash_limiter);
-			continue;
-		}
+#if PBS_DEBUG
+// Prints the keys of a table with their values in 'src'
+static void dumpKeys(const configKey* keys, uint32_t count, const void* src, const char* folder)
+{
+	char value[80];
 
-		// Spin limiter in milliseconds
-		if (strncasecmp("spin_limiter", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.spin_limiter);
-			continue;
-		}
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const configKey* key = &keys[i];
+		const void* field = (const uint8_t*) src + key->offset;
 
-		// Clash sensitivity
-		if (strncasecmp("clash_sensitivity", key_name, key_len) == 0)
+		switch (key->type)
 		{
-			config_file.readValue(token, &settings.clash_sensitivity);
-			continue;
-		}
+			case valueNumber:
+				snprintf(value, sizeof(value), "%lu",
+						 (unsigned long) getField(field, key->size));
+				break;
 
-		// Button debounce counter
-		if (strncasecmp("button_debounce", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.button_debounce);
-			continue;
-		}
+			case valueBool:
+				snprintf(value, sizeof(value), "%s", *(const bool*) field ? "yes" : "no");
+				break;
 
-		//  On/Off button press debounce time to turn the thing off
-		if (strncasecmp("off_button_time", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.off_time);
-			continue;
-		}
+			case valueFloat:
+				snprintf(value, sizeof(value), "%i", (int32_t) *(const float*) field);
+				break;
 
-		//  FX button press time for lock-up
-		if (strncasecmp("lock_button_time", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.lock_time);
-			continue;
-		}
+			case valueString:
+				snprintf(value, sizeof(value), "%s", (const char*) field);
+				break;
 
-		// Utility sounds folder
-		if (strncasecmp("sound_utils", key_name, key_len) == 0)
-		{
-			uint32_t len = sizeof(settings.sound_utils);
-			config_file.readValue(token, settings.sound_utils, &len);
-			continue;
-		}
+			case valueEnum:
+			{
+				uint32_t val = getField(field, key->size);
+				const configEnumValue* ev;
 
-		//  Dump profile info to debug port
-		if (strncasecmp("dump_profile_info", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.dump_profile_info);
-			continue;
-		}
+				for (ev = key->values; ev->name && ev->value != val; ev++);
+				snprintf(value, sizeof(value), "%s", ev->name ? ev->name : "unknown");
+				break;
+			}
 
-		//  Dump profile info to debug port
-		if (strncasecmp("dump_font_info", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &settings.dump_font_info);
-			continue;
+			case valueColor:
+			{
+				const COLOR* color = (const COLOR*) field;
+				snprintf(value, sizeof(value), "%i,%i,%i,%i", color->r, color->g, color->b,
+						 color->w);
+				break;
+			}
+
+			case valueArray:
+			{
+				const uint16_t* array = (const uint16_t*) field;
+				uint32_t len = 0;
+
+				value[0] = 0;
+				for (uint32_t j = 0; j < key->size / sizeof(uint16_t); j++)
+					len += snprintf(value + len, sizeof(value) - len, j ? ",%u" : "%u", array[j]);
+				break;
+			}
+
+			case valueSound:
+			{
+				const fontSoundFile* file = (const fontSoundFile*) field;
+
+				if (!file->present)
+				{
+					snprintf(value, sizeof(value), "not present");
+				} else if (file->random) // It means they have min and max values
+				{
+					snprintf(value, sizeof(value), "%s\\%s(%lu-%lu).wav", folder, file->filename,
+							 (unsigned long) file->min, (unsigned long) file->max);
+				} else {
+					snprintf(value, sizeof(value), "%s\\%s.wav", folder, file->filename);
+				}
+				break;
+			}
+
+			default:
+				// Dumped with their valueSound key
+				continue;
 		}
+
+		debugMsg(DebugInfo, "%s = %s", key->name, value);
+	}
+}
+#endif
+
+PBSConfig::PBSConfig()
+{
+	hardware_offset = settings_offset = first_profile_offset = first_font_offset = 0;
+	profile_count = 0;
+	memset(&profile_index, 0, sizeof(sectionIndex));
+	memset(&font_index, 0, sizeof(sectionIndex));
+	memset(&file_settings, 0, sizeof(saberSettings));
+	mapped = false;
+	snapshot_open = false;
+	config_path[0] = snapshot_file[0] = 0;
+	snapshot_profile_count = snapshot_font_count = 0;
+	snapshot_header = NULL;
+	snapshot_record = snapshot_start = 0;
+}
+
+PBSConfig::~PBSConfig()
+{
+	if (snapshot_open)
+		f_close(&snapshot);
+
+	if (snapshot_header)
+	{
+		f_close(&snapshot_write);
+		delete snapshot_header;
+	}
+
+	delete[] profile_index.entries;
+	delete[] font_index.entries;
+}
+
+bool PBSConfig::readSettings()
+{
+	debugMsg(DebugInfo, "Reading general settings");
+
+	if (!config_file.setFileRWPointer(settings_offset))
+		return false;
+
+	if (!config_file.startSectionScan("settings"))
+		return false;
+
+	// Keep audio_fs, read before by readAudioSettings()
+	uint32_t audio_fs = settings.audio_fs;
+	memset(&settings, 0, sizeof(settings));
+	settings.audio_fs = audio_fs;
+
+	char* key_name;
+	uint32_t key_len;
+	uint32_t token;
+
+	while (config_file.getNextKey(&token, &key_name, &key_len))
+	{
+		const configKey* key = findKey(settings_keys, KEY_COUNT(settings_keys), key_name, key_len);
+
+		if (key)
+			readKey(key, token, &settings);
 	}
 
 	// Check
@@ -204,6 +455,31 @@ bool PBSConfig::readSettings()
 		settings.spin_limiter = 250;
 	}
 
+	if (settings.dynamic_swing_depth > 100)
+	{
+		debugMsg(DebugWarning, "dynamic_swing_depth value %lu. Defaulting to 100",
+								settings.dynamic_swing_depth);
+		settings.dynamic_swing_depth = 100;
+	}
+
+	if (settings.hum_pitch > 1200)
+	{
+		debugMsg(DebugWarning, "hum_pitch value %lu. Defaulting to 1200", settings.hum_pitch);
+		settings.hum_pitch = 1200;
+	}
+
+	if (settings.hum_filter && settings.hum_filter < 20)
+	{
+		debugMsg(DebugWarning, "hum_filter value %lu. Defaulting to 20", settings.hum_filter);
+		settings.hum_filter = 20;
+	}
+
+	if (settings.music_filter && settings.music_filter < 20)
+	{
+		debugMsg(DebugWarning, "music_filter value %lu. Defaulting to 20", settings.music_filter);
+		settings.music_filter = 20;
+	}
+
 	if (!settings.clash_sensitivity)
 	{
 		debugMsg(DebugWarning, "clash_sensitivity value %i. Defaulting to 50",
@@ -235,11 +511,18 @@ bool PBSConfig::readSettings()
 	debugMsg(DebugInfo, "Default profile is %lu", settings.initial_profile);
 
 	config_file.endSectionScan();
+	file_settings = settings;
 	return true;
 }
 
 bool PBSConfig::read()
 {
+	PBS_PROFILE_SCOPE("PBSConfig::read");
+
+	// Already loaded from the snapshot
+	if (snapshot_open)
+		return true;
+
 	timeCounter.startCounter();
 
 	if (!readHardwareConfiguration())
@@ -260,6 +543,10 @@ bool PBSConfig::read()
 
 bool PBSConfig::readAudioSettings()
 {
+	// Already loaded from the snapshot
+	if (snapshot_open)
+		return true;
+
 	settings.audio_fs = 0;
 
 	// Point to [settings] offset
@@ -269,7 +556,7 @@ bool PBSConfig::readAudioSettings()
 	if (!config_file.readValue("settings", "audio_fs", &settings.audio_fs))
 		return false;
 
-	if (settings.audio_fs != 22050 && settings.audio_fs != 32000 && settings.audio_fs != 44000 &&
+	if (settings.audio_fs != 22050 && settings.audio_fs != 32000 && settings.audio_fs != 44100 &&
 		settings.audio_fs != 48000 && settings.audio_fs != 96000)
 	{
 		debugMsg(DebugWarning, "audio_fs value %i. Defaulting to 22050", settings.audio_fs);
@@ -282,11 +569,9 @@ bool PBSConfig::readAudioSettings()
 bool PBSConfig::readHardwareConfiguration()
 {
 	bool ret = true;
-	uint32_t len;
 	char* key_name;
 	uint32_t key_len;
 	uint32_t token;
-	uint8_t output_count = 3;
 	bool onoff_button = false;
 	bool onoff_button_pol = false;
 
@@ -304,183 +589,80 @@ bool PBSConfig::readHardwareConfiguration()
 
 	while (config_file.getNextKey(&token, &key_name, &key_len))
 	{
-		// Blade type
-		if (strncasecmp("blade_type", key_name, key_len) == 0)
-		{
-			uint32_t len = sizeof(tmp);
-			if (!config_file.readValue(token, tmp, &len))
-			{
-				debugMsg(DebugError, "Error reading blade_type value");
-				ret = false;
-				break;
-			}
+		const configKey* key = findKey(hardware_keys, KEY_COUNT(hardware_keys), key_name, key_len);
+		void* field;
+		bool valid;
 
-			if (strcasecmp(tmp, "pixel") == 0)
-				hw.blade_type = bladeStrip;
-			else if (strcasecmp(tmp, "hbled") == 0)
-				hw.blade_type = bladeHBLED;
-			else
-			{
-				debugMsg(DebugError, "blade_type invalid value");
-				ret = false;
-				break;
-			}
+		if (!key)
 			continue;
-		}
 
-		// Blade type = bladeStrip
-		if (hw.blade_type == bladeStrip)
-		{
-			if (strncasecmp("pixel_type", key_name, key_len) == 0)
-			{
-				// Strip type
-				len = sizeof(tmp);
-				if (!config_file.readValue(token, tmp, &len))
-				{
-					debugMsg(DebugError, "Error reading pixel_type value");
-					ret = false;
-					break;
-				}
-
-				if (len)
-				{
-					if (strcasecmp(tmp, "apa102") == 0)
-						hw.strip_type = APA102;
-					else if (strcasecmp(tmp, "ws2812") == 0)
-						hw.strip_type = WS2812B;
-					else if (strcasecmp(tmp, "sk6812rgbw") == 0)
-						hw.strip_type = SK6812RGBW;
-				}
-
-				if (hw.strip_type == 0)
-				{
-					debugMsg(DebugError, "pixel_type invalid value: %s", tmp);
-					ret = false;
-					break;
-				}
-				continue;
-			}
-
-			// Strip LED count
-			if (strncasecmp("pixel_count", key_name, key_len) == 0)
-			{
-				if (!config_file.readValue(token, &hw.strip_count))
-				{
-					debugMsg(DebugError, "Error reading pixel_count value");
-					ret = false;
-					break;
-				}
-
-				if (hw.strip_count == 0)
-				{
-					debugMsg(DebugError, "Invalid pixel_count value");
-					ret = false;
-					break;
-				}
-				continue;
-			}
-		} else if (hw.blade_type == bladeHBLED)
-		{
-			if (strncasecmp("hbled_current", key_name, key_len) == 0)
-			{
-				if (!config_file.readArray(token, hw.hbled_current, &output_count))
-				{
-					debugMsg(DebugError, "Error reading hbled_current value");
-					ret = false;
-					break;
-				}
-
-				if (output_count == 0)
-				{
-					debugMsg(DebugError, "hbled_current invalid count");
-					ret = false;
-					break;
-				}
-				continue;
-			}
-
-			if (strncasecmp("hbled_is_rgb", key_name, key_len) == 0)
-			{
-				if (!config_file.readValue(token, &hw.hbled_is_rgb))
-				{
-					debugMsg(DebugError, "Error reading hbled_is_rgb value");
-					ret = false;
-					break;
-				}
-
-				if (hw.hbled_is_rgb)
-					debugMsg(DebugInfo, "HBLED is RGB");
-				else
-					debugMsg(DebugInfo, "HBLED is not RGB");
+		// Keys of the other blade type are ignored
+		if (((key->flags & KEY_STRIP_ONLY) && hw.blade_type != bladeStrip) ||
+			((key->flags & KEY_HBLED_ONLY) && hw.blade_type != bladeHBLED))
+			continue;
 
-				continue;
-			}
+		switch (key->id)
+		{
+			case hwKeyBladeType:	field = &hw.blade_type; break;
+			case hwKeyStripType:	field = &hw.strip_type; break;
+			case hwKeyStripCount:	field = &hw.strip_count; break;
+			case hwKeyHBLEDCurrent:	field = hw.hbled_current; break;
+			case hwKeyHBLEDIsRGB:	field = &hw.hbled_is_rgb; break;
+			case hwKeyOnOffPad:		field = &hw.button_onoff.pin; break;
+			case hwKeyOnOffPol:		field = &hw.button_onoff.active_high; break;
+			case hwKeyFxPad:		field = &hw.button_fx.pin; break;
+			case hwKeyFxPol:		field = &hw.button_fx.active_high; break;
+			default: continue;
 		}
 
-		// Read buttons configuration
-		if (strncasecmp("onoff_button_pad", key_name, key_len) == 0)
+		// The FX button is optional
+		if (key->id == hwKeyFxPad)
 		{
-			if (!config_file.readValue(token, &hw.button_onoff.pin))
-			{
-				// We need at least an ON/OFF button
-				debugMsg(DebugError, "Error reading onoff_button_pad value");
-				ret = false;
-				break;
-			}
-
-			onoff_button = true;
+			if (readKey(key, token, field))
+				hw.has_button_fx = true;
+			else
+				debugMsg(DebugWarning, "Configuration for fx_button_pad not found");
 			continue;
 		}
 
-		if (strncasecmp("onoff_button_pol", key_name, key_len) == 0)
+		if (key->id == hwKeyFxPol)
 		{
-			if (!config_file.readValue(token, &hw.button_onoff.active_high))
+			if (hw.has_button_fx && !readKey(key, token, field))
 			{
-				// We need at least an ON/OFF button
-				debugMsg(DebugError, "Error reading onoff_button_pol value");
-				return false;
+				debugMsg(DebugWarning, "Configuration for fx_button_pol not found");
+				hw.has_button_fx = false;
 			}
-
-			onoff_button_pol = true;
 			continue;
 		}
 
-		if (strncasecmp("fx_button_pad", key_name, key_len) == 0)
+		valid = readKey(key, token, field);
+
+		// We need at least an ON/OFF button
+		if (key->id == hwKeyOnOffPad)
+			onoff_button = valid;
+		else if (key->id == hwKeyOnOffPol)
+			onoff_button_pol = valid;
+
+		if (!valid)
 		{
-			if (!config_file.readValue(token, &hw.button_fx.pin))
-			{
-				debugMsg(DebugWarning, "Configuration for fx_button_pad not found");
-			} else {
-				hw.has_button_fx = true;
-			}
-			continue;
+			debugMsg(DebugError, "Error reading %s value", key->name);
+			ret = false;
+			break;
 		}
 
-		if (hw.has_button_fx)
+		if (key->id == hwKeyHBLEDIsRGB)
 		{
-			if (strncasecmp("fx_button_pol", key_name, key_len) == 0)
-			{
-				if (!config_file.readValue(token, &hw.button_fx.active_high))
-				{
-					debugMsg(DebugWarning, "Configuration for fx_button_pol not found");
-					hw.has_button_fx = false;
-				}
-				continue;
-			}
+			if (hw.hbled_is_rgb)
+				debugMsg(DebugInfo, "HBLED is RGB");
+			else
+				debugMsg(DebugInfo, "HBLED is not RGB");
 		}
 	}
 
 	// Verify
 	if (ret)
 	{
-		if (hw.blade_type == bladeHBLED)
-		{
-			if (output_count == 0)
-			{
-				debugMsg(DebugError, "blade_type invalid value");
-				ret = false;
-			}
-		} else if (hw.blade_type == bladeStrip)
+		if (hw.blade_type == bladeStrip)
 		{
 			if (!hw.strip_type)
 			{
@@ -494,7 +676,8 @@ bool PBSConfig::readHardwareConfiguration()
 				ret = false;
 			}
 
-		} else {
+		} else if (hw.blade_type != bladeHBLED)
+		{
 			debugMsg(DebugError, "blade_type invalid value");
 			ret = false;
 		}
@@ -552,25 +735,47 @@ bool PBSConfig::readHardwareConfiguration()
 bool PBSConfig::loadProfile(uint32_t id, saberProfile* dst)
 {
 	char profile[32];
-	uint8_t array_count;
 	uint32_t as_profile = 0;
 	static uint8_t recursion = 0;
 
 	if (!id)
 		return false;
 
-	sprintf(profile, "profile%lu", id);
+	PBS_PROFILE_SCOPE("loadProfile", id);
+
+	// Read it from the snapshot, if there is one
+	if (!recursion && snapshot_open && id <= snapshot_profile_count)
+	{
+		timeCounter.startCounter();
+
+		if (readSnapshotRecord(SNAPSHOT_PROFILE_OFFSET(id), dst, sizeof(saberProfile)) &&
+			dst->id == id)
+		{
+			debugMsg(DebugInfo, "profile%lu read from snapshot in %lu ms", id,
+					 timeCounter.elapsed());
+			return true;
+		}
+	}
+
+	if (!mapped)
+		map();
+
+	sprintf(profile, "profile%lu", (unsigned long) id);
 	debugMsg(DebugInfo, "Reading profile %s", profile);
 
 	if (!recursion)
 	{
-		memset(dst, 0, sizeof(saberProfile));
+		memset((void*) dst, 0, sizeof(saberProfile));
 		timeCounter.startCounter();
 	}
 
-	// Put the configuration file cursor at the first found profile
-	if (!config_file.setFileRWPointer(first_profile_offset))
+	// Put the configuration file cursor at the profile section
+	if (!seekSection(&profile_index, id, first_profile_offset))
+	{
+		recursion = 0;
+		debugMsg(DebugError, "Profile %s does not exist", profile);
 		return false;
+	}
 
 	// Check if the profile is like another one that already exists
 	if (config_file.readValue(profile, "as_profile", &as_profile))
@@ -596,9 +801,8 @@ bool PBSConfig::loadProfile(uint32_t id, saberProfile* dst)
 
 	if (as_profile)
 	{
-		// We have to set pointer back again at the first found profile since we don't know
-		// if the as_profile profile comes before or after the profile we want to read
-		if (!config_file.setFileRWPointer(first_profile_offset))
+		// Loading the as_profile profile moved the pointer, set it back to our section
+		if (!seekSection(&profile_index, id, first_profile_offset))
 			return false;
 	}
 
@@ -613,256 +817,155 @@ bool PBSConfig::loadProfile(uint32_t id, saberProfile* dst)
 	char* key_name;
 	uint32_t key_len;
 	uint32_t token;
-	uint8_t color_array[4];
-	array_count = 4;
-	uint32_t strsize;
 
 	while (config_file.getNextKey(&token, &key_name, &key_len))
 	{
-		// Font
-		if (strncasecmp("font", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &dst->font_num);
-			continue;
-		}
+		const configKey* key = findKey(profile_keys, KEY_COUNT(profile_keys), key_name, key_len);
 
-		// Ignition
-		if (strncasecmp("ignition_mode", key_name, key_len) == 0)
-		{
-			strsize = sizeof(tmp);
-			config_file.readValue(token, tmp, &strsize);
+		if (!key)
+			continue;
 
-			if (strsize)
-			{
-				if (strcasecmp(tmp, "ramp") == 0)
-					dst->ignition_mode = ignitionRamp;
-				else if (strcasecmp(tmp, "full") == 0)
-					dst->ignition_mode = ignitionFull;
-				else if (strcasecmp(tmp, "scroll") == 0)
-					dst->ignition_mode = ignitionScroll;
-			}
+		// Durations are not used by the 'full' ignition/retraction modes
+		if ((key->id == profileKeyIgnitionDuration && dst->ignition_mode == ignitionFull) ||
+			(key->id == profileKeyRetractionDuration && dst->retraction_mode == retractionFull))
 			continue;
-		}
 
-		if (dst->ignition_mode != ignitionFull)
-		{
-			if (strncasecmp("ignition_duration", key_name, key_len) == 0)
-			{
-				config_file.readValue(token, &dst->ignition_duration);
-				continue;
-			}
-		}
+		readKey(key, token, dst);
+	}
 
-		if (strncasecmp("ignition_on_stab", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &dst->ignition_on_stab);
-			continue;
-		}
+	config_file.endSectionScan();
 
-		// Retraction
-		if (strncasecmp("retraction_mode", key_name, key_len) == 0)
-		{
-			strsize = sizeof(tmp);
-			config_file.readValue(token, tmp, &strsize);
+	// If not doing a recursion do dump and check
+	if (!recursion)
+	{
+		if (settings.dump_profile_info)
+			dumpProfileInfo(dst);
 
-			if (strsize)
-			{
-				if (strcasecmp(tmp, "ramp") == 0)
-					dst->retraction_mode = retractionRamp;
-				else if (strcasecmp(tmp, "full") == 0)
-					dst->retraction_mode = retractionFull;
-				else if (strcasecmp(tmp, "scroll") == 0)
-					dst->retraction_mode = retractionScroll;
-			}
-			continue;
-		}
+		if (!checkProfile(dst))
+			return false;
 
-		if (dst->retraction_mode != retractionFull)
-		{
-			if (strncasecmp("retraction_mode", key_name, key_len) == 0)
-			{
-				config_file.readValue(token, &dst->retraction_duration);
-				continue;
-			}
-		}
+		debugMsg(DebugInfo, "profile%lu successfully read in %lu ms", id, timeCounter.elapsed());
+	}
 
-		// Shimmer color
-		if (strncasecmp("shimmer_color", key_name, key_len) == 0)
-		{
-			memset(color_array, 0, sizeof(color_array));
-			config_file.readArray(token, color_array, &array_count);
+	return true;
+}
 
-			if (array_count)
-				dst->shimmer.base_color = RGBW(color_array[0], color_array[1],
-										  	   color_array[2], color_array[3]);
+bool PBSConfig::readKey(const configKey* key, uint32_t token, void* dst)
+{
+	void* field = (uint8_t*) dst + key->offset;
+	uint32_t len;
 
-			continue;
-		}
+	switch (key->type)
+	{
+		case valueNumber:
+			if (key->size == sizeof(uint8_t))
+				return config_file.readValue(token, (uint8_t*) field);
 
-		// Shimmer depth
-		if (strncasecmp("shimmer_depth", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &dst->shimmer.depth);
-			continue;
-		}
+			return config_file.readValue(token, (uint32_t*) field);
 
-		// Shimmer mode
-		if (strncasecmp("shimmer_mode", key_name, key_len) == 0)
-		{
-			strsize = sizeof(tmp);
-			config_file.readValue(token, tmp, &strsize);
+		case valueBool:
+			return config_file.readValue(token, (bool*) field);
+
+		case valueFloat:
+			return config_file.readValue(token, (float*) field);
 
-			if (strsize)
+		case valueString:
+			len = key->size;
+
+			if (key->flags & KEY_KEEP_IF_EMPTY)
 			{
-				if (strcasecmp(tmp, "random") == 0)
-					dst->shimmer.randomize = true;
-				else
-					dst->shimmer.randomize = false;
+				if (!config_file.readValue(token, tmp, &len))
+					return false;
+
+				if (len)
+					strcpy((char*) field, tmp);
+
+				return true;
 			}
-			continue;
-		}
 
-		// Shimmer frequency
-		if (strncasecmp("shimmer_freq", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &dst->shimmer.freq);
-			continue;
-		}
-		char key[32];
-		char key_type[8];
-		bladeEffect *effect;
+			return config_file.readValue(token, (char*) field, &len);
 
-		if (strncasecmp(key_name, "clash", 5) == 0)
-		{
-			strcpy(key_type, "clash");
-			effect = &dst->clash;
-		} else if (strncasecmp(key_name, "blaster", 7) == 0)
+		case valueEnum:
 		{
-			strcpy(key_type, "blaster");
-			effect = &dst->blaster;
-		} else if (strncasecmp(key_name, "stab", 4) == 0)
-		{
-			strcpy(key_type, "stab");
-			effect = &dst->stab;
-		} else if (strncasecmp(key_name, "lockup", 6) == 0)
-		{
-			strcpy(key_type, "lockup");
-			effect = &dst->lockup;
-		} else continue;
+			len = sizeof(tmp);
+			if (!config_file.readValue(token, tmp, &len))
+				return false;
 
-		// Mode
-		sprintf(key, "%s_mode", key_type);
-		if (strncasecmp(key, key_name, key_len) == 0)
-		{
-			strsize = sizeof(tmp);
-			config_file.readValue(token, tmp, &strsize);
+			// Empty, keep the current value
+			if (!len)
+				return true;
 
-			if (strsize)
+			for (const configEnumValue* value = key->values; value->name; value++)
 			{
-				if (strcasecmp(tmp, "static") == 0)
-					effect->type = effectTypeStatic;
-				else if (strcasecmp(tmp, "shimmer") == 0)
-					effect->type = effectTypeShimmer;
-				else if (strcasecmp(tmp, "flash") == 0)
-					effect->type = effectTypeFlash;
-				else if (strcasecmp(tmp, "spark") == 0)
-					effect->type = effectTypeSpark;
-				else if (strcasecmp(tmp, "flash_spark") == 0)
-					effect->type = effectTypeFlashSpark;
-				else if (strcasecmp(tmp, "big_spark") == 0)
-					effect->type = effectTypeBigSpark;
-				else if (strcasecmp(tmp, "tip_spark") == 0)
-					effect->type = effectTypeTipSpark;
-				else if (strcasecmp(tmp, "flash_flicker") == 0)
-					effect->type = effectTypeFlashFlicker;
+				if (strcasecmp(tmp, value->name) == 0)
+				{
+					setField(field, key->size, value->value);
+					return true;
+				}
 			}
-			continue;
+
+			debugMsg(DebugWarning, "%s invalid value: %s", key->name, tmp);
+			return false;
 		}
 
-		// Color
-		sprintf(key, "%s_color", key_type);
-		if (strncasecmp(key, key_name, key_len) == 0)
+		case valueColor:
 		{
-			array_count = 4;
-			memset(color_array, 0, sizeof(color_array));
-			config_file.readArray(token, color_array, &array_count);
+			uint8_t color[4];
+			uint8_t count = 4;
 
-			if (array_count)
-			{
-				effect->base_color = RGBW(color_array[0], color_array[1],
-										  color_array[2], color_array[3]);
-			}
-			continue;
-		}
+			memset(color, 0, sizeof(color));
+			config_file.readArray(token, color, &count);
 
-		// Random
-		sprintf(key, "%s_random", key_type);
-		if (strncasecmp(key, key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &effect->randomize);
-			continue;
-		}
+			if (!count)
+				return false;
 
-		// Blend
-		sprintf(key, "%s_blend", key_type);
-		if (strncasecmp(key, key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &effect->blend);
-			continue;
+			*(COLOR*) field = RGBW(color[0], color[1], color[2], color[3]);
+			return true;
 		}
 
-		// Frequency
-		sprintf(key, "%s_freq", key_type);
-		if (strncasecmp(key, key_name, key_len) == 0)
+		case valueArray:
 		{
-			config_file.readValue(token, &effect->freq);
-			continue;
-		}
+			uint8_t count = key->size / sizeof(uint16_t);
 
-		// Depth
-		sprintf(key, "%s_depth", key_type);
-		if (strncasecmp(key, key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &effect->depth);
-			continue;
+			return config_file.readArray(token, (uint16_t*) field, &count) && count;
 		}
 
-		sprintf(key, "%s_duration", key_type);
-		if (strncasecmp(key, key_name, key_len) == 0)
+		case valueSound:
 		{
-			config_file.readValue(token, &effect->duration);
-			continue;
-		}
-	}
+			fontSoundFile* file = (fontSoundFile*) field;
 
-	config_file.endSectionScan();
+			len = sizeof(file->filename);
+			config_file.readValue(token, file->filename, &len);
 
-	// If not doing a recursion do dump, check and font loading
-	if (!recursion)
-	{
-		if (settings.dump_profile_info)
-			dumpProfileInfo(dst);
-
-		if (!checkProfile(dst))
-			return false;
+			file->present = (len > 0);
+			return true;
+		}
 
-		if (loadFontInfo(dst->font_num, &dst->font))
+		case valueMinMax:
 		{
-			if (settings.dump_font_info)
-				dumpFontInfo(&dst->font);
+			fontSoundFile* file = (fontSoundFile*) field;
+			uint8_t min_max[2];
+			uint8_t count = 2;
 
-			if (strlen(dst->font.title))
+			config_file.readArray(token, min_max, &count);
+
+			if (count == 2)
 			{
-				debugMsg(DebugInfo, "Using font %s", dst->font.title);
+				file->min = min_max[0];
+				file->max = min_max[1];
+
+				if (file->min != file->max)
+					file->random = true;
 			} else {
-				debugMsg(DebugInfo, "Using font %i", dst->font.id);
+				file->min = 0;
+				file->max = 0;
+				file->random = false;
 			}
-
-			debugMsg(DebugInfo, "profile%lu successfully read in %lu ms", id, timeCounter.elapsed());
-		} else return false;
+			return true;
+		}
 	}
 
-	return true;
+	return false;
 }
 
 bool PBSConfig::checkProfile(saberProfile* profile)
@@ -1012,12 +1115,23 @@ bool PBSConfig::folderExists(char* folder)
 	return true;
 }
 
+bool PBSConfig::getPackPath(fontInfo* fi, char* path, uint32_t size)
+{
+	if (!strlen(fi->pack))
+		return false;
+
+	if (strlen(fi->folder))
+		snprintf(path, size, "%s\\%s", fi->folder, fi->pack);
+	else
+		snprintf(path, size, "%s", fi->pack);
+
+	return true;
+}
+
 bool PBSConfig::loadFontInfo(uint32_t id, fontInfo* fi)
 {
-	uint32_t len;
-	const char* name;
-	const char* min_max;
 	char section[32];
+	char path[PBS_PACK_PATH_LEN];
 	uint32_t as_font = 0;
 	static uint8_t recursion = 0;
 	bool ret = true;
@@ -1026,15 +1140,31 @@ bool PBSConfig::loadFontInfo(uint32_t id, fontInfo* fi)
 	uint32_t token;
 	bool poly_found = false;
 
-	sprintf(section, "font%lu", id);
+	PBS_PROFILE_SCOPE("loadFontInfo", id);
+
+	// Read it from the snapshot, if there is one
+	if (!recursion && snapshot_open && id && id <= snapshot_font_count)
+	{
+		if (readSnapshotRecord(SNAPSHOT_FONT_OFFSET(id), fi, sizeof(fontInfo)) && fi->id == id)
+			return true;
+	}
+
+	if (!mapped)
+		map();
+
+	sprintf(section, "font%lu", (unsigned long) id);
 	debugMsg(DebugInfo, "Reading %s", section);
 
 	if (!recursion)
 		memset(fi, 0, sizeof(fontInfo));
 
-	// Put the configuration file pointer to the first found font
-	if (!config_file.setFileRWPointer(first_font_offset))
+	// Put the configuration file pointer at the font section
+	if (!seekSection(&font_index, id, first_font_offset))
+	{
+		recursion = 0;
+		debugMsg(DebugError, "Error locating section '%s'", section);
 		return false;
+	}
 
 	// Check if the font info is like another one that already exists
 	if (config_file.readValue(section, "as_font", &as_font))
@@ -1057,9 +1187,8 @@ bool PBSConfig::loadFontInfo(uint32_t id, fontInfo* fi)
 
 	if (as_font)
 	{
-		// We have to set pointer back again at the first found font since we don't know
-		// if the as_font font comes before or after the font we want to read
-		if (!config_file.setFileRWPointer(first_font_offset))
+		// Loading the as_font font moved the pointer, set it back to our section
+		if (!seekSection(&font_index, id, first_font_offset))
 			return false;
 	}
 
@@ -1073,141 +1202,16 @@ bool PBSConfig::loadFontInfo(uint32_t id, fontInfo* fi)
 
 	while (config_file.getNextKey(&token, &key_name, &key_len))
 	{
-		// Font title is not mandatory
-		if (strncasecmp("title", key_name, key_len) == 0)
-		{
-			len = MAX_FONT_NAME_LEN;
-			config_file.readValue(token, tmp, &len);
+		const configKey* key = findKey(font_keys, KEY_COUNT(font_keys), key_name, key_len);
 
-			if (len)
-				strcpy(fi->title, tmp);
+		if (!key)
 			continue;
-		}
 
-		// Font folder is mandatory and must exists
-		if (strncasecmp("folder", key_name, key_len) == 0)
-		{
-			len = MAX_FONT_NAME_LEN;
-			config_file.readValue(token, fi->folder, &len);
-			continue;
-		}
+		readKey(key, token, fi);
 
 		// Polyphony info is mandatory
-		if (strncasecmp("poly", key_name, key_len) == 0)
-		{
-			config_file.readValue(token, &fi->poly);
+		if (key->id == fontKeyPoly)
 			poly_found = true;
-			continue;
-		}
-
-		fontSoundFile* sound_file = NULL;
-
-		if (strncasecmp(key_name, "boot", 4) == 0)
-		{
-			name = "boot";
-			min_max = "boot_min_max";
-			sound_file = &fi->files[fontBoot];
-		} else if (strncasecmp(key_name, "ignition", 8) == 0)
-		{
-			name = "ignition";
-			min_max = "ignition_min_max";
-			sound_file = &fi->files[fontIgnition];
-		} else if (strncasecmp(key_name, "retraction", 10) == 0)
-		{
-			name = "retraction";
-			min_max = "retraction_min_max";
-			sound_file = &fi->files[fontRetraction];
-		} else if (strncasecmp(key_name, "low_power", 9) == 0)
-		{
-			name = "low_power";
-			min_max = "low_power_min_max";
-			sound_file = &fi->files[fontLowPower];
-		} else if (strncasecmp(key_name, "hum", 3) == 0)
-		{
-			name = "hum";
-			min_max = "hum_min_max";
-			sound_file = &fi->files[fontHum];
-		} else if (strncasecmp(key_name, "blaster", 7) == 0)
-		{
-			name = "blaster";
-			min_max = "blaster_min_max";
-			sound_file = &fi->files[fontBlaster];
-		} else if (strncasecmp(key_name, "lock", 4) == 0)
-		{
-			name = "lock";
-			min_max = "lock_min_max";
-			sound_file = &fi->files[fontLock];
-		} else if (strncasecmp(key_name, "swing", 5) == 0)
-		{
-			name = "swing";
-			min_max = "swing_min_max";
-			sound_file = &fi->files[fontSwing];
-		} else if (strncasecmp(key_name, "clash", 5) == 0)
-		{
-			name = "clash";
-			min_max = "clash_min_max";
-			sound_file = &fi->files[fontClash];
-		} else if (strncasecmp(key_name, "spin", 4) == 0)
-		{
-			name = "spin";
-			min_max = "spin_min_max";
-			sound_file = &fi->files[fontSpin];
-		} else if (strncasecmp(key_name, "stab", 4) == 0)
-		{
-			name = "stab";
-			min_max = "stab_min_max";
-			sound_file = &fi->files[fontStab];
-		} else if (strncasecmp(key_name, "force", 5) == 0)
-		{
-			name = "force";
-			min_max = "force_min_max";
-			sound_file = &fi->files[fontForce];
-		} else if (strncasecmp(key_name, "background", 10) == 0)
-		{
-			name = "background";
-			min_max = "background_min_max";
-			sound_file = &fi->files[fontBackground];
-		} else if (strncasecmp(key_name, "name", 4) == 0)
-		{
-			name = "name";
-			min_max = NULL;
-			sound_file = &fi->files[fontName];
-		} else continue;
-
-		if (strncasecmp(name, key_name, key_len) == 0)
-		{
-			len = MAX_FONT_NAME_LEN;
-			config_file.readValue(token, sound_file->filename, &len);
-
-			sound_file->present = (len > 0);
-			continue;
-		}
-
-		if (min_max)
-		{
-			if (strncasecmp(min_max, key_name, key_len) == 0)
-			{
-				uint8_t min_max_array[2];
-				uint8_t min_max_array_len = 2;
-				config_file.readArray(token, min_max_array, &min_max_array_len);
-
-				if (min_max_array_len == 2)
-				{
-					sound_file->min = min_max_array[0];
-					sound_file->max = min_max_array[1];
-
-					if (sound_file->min != sound_file->max)
-						sound_file->random = true;
-				} else {
-					sound_file->min = 0;
-					sound_file->max = 0;
-					sound_file->random = false;
-				}
-				continue;
-			}
-		} else {
-			sound_file->random = false;
-		}
 	}
 
 	// Check
@@ -1215,6 +1219,10 @@ bool PBSConfig::loadFontInfo(uint32_t id, fontInfo* fi)
 	{
 		debugMsg(DebugError, "Error locating folder %s", fi->folder);
 		ret = false;
+	} else if (getPackPath(fi, path, sizeof(path)) && !PBSPack::check(path))
+	{
+		debugMsg(DebugError, "Error opening font pack %s", fi->pack);
+		ret = false;
 	}
 
 	if (!poly_found)
@@ -1224,12 +1232,17 @@ bool PBSConfig::loadFontInfo(uint32_t id, fontInfo* fi)
 	}
 
 	config_file.endSectionScan();
+
+	if (ret && !recursion && settings.dump_font_info)
+		dumpFontInfo(fi);
+
 	return ret;
 }
 
 bool PBSConfig::open(const char* file)
 {
 	debugMsg(DebugInfo, "Configuration file is %s", file);
+	PBS_PROFILE_SCOPE("PBSConfig::open");
 
 	if (!config_file.begin(file))
 	{
@@ -1237,7 +1250,21 @@ bool PBSConfig::open(const char* file)
 		return false;
 	}
 
-	map();
+	// The snapshot has the same name of the configuration file, with another extension
+	snprintf(config_path, sizeof(config_path), "%s", file);
+	snprintf(snapshot_file, sizeof(snapshot_file) - strlen(PBS_SNAPSHOT_EXT), "%s", file);
+
+	char* ext = strrchr(snapshot_file, '.');
+	if (ext && !strchr(ext, '\\') && !strchr(ext, '/'))
+		*ext = 0;
+
+	strcat(snapshot_file, PBS_SNAPSHOT_EXT);
+
+	if (loadSnapshot())
+		debugMsg(DebugInfo, "Using configuration snapshot %s", snapshot_file);
+	else
+		map();
+
 	return true;
 }
 
@@ -1257,24 +1284,126 @@ bool PBSConfig::mapCallback(uint32_t section, uint32_t data, char* str)
 
 		if (first_profile_offset == 0)
 			first_profile_offset = section;
+
+		indexSection(&profile_index, str + 7, section);
 	}
 
-	if (first_font_offset == 0 && strncasecmp(str, "font", 4) == 0)
-		first_font_offset = section;
+	if (strncasecmp(str, "font", 4) == 0)
+	{
+		if (first_font_offset == 0)
+			first_font_offset = section;
+
+		indexSection(&font_index, str + 4, section);
+	}
 
 	return true;
 }
 
+void PBSConfig::indexSection(sectionIndex* index, char* number, uint32_t offset)
+{
+	char* end;
+	uint32_t id = strtoul(number, &end, 10);
+
+	// Only index sections named like profileN or fontN
+	if (index->failed || id == 0 || *end != 0)
+		return;
+
+	if (index->count == index->size)
+	{
+		// Grow the index
+		uint32_t size = index->size ? index->size * 2 : 16;
+		sectionOffset* entries = new sectionOffset[size];
+
+		if (!entries)
+		{
+			// Without an index we fall back to scan from the first section
+			debugMsg(DebugWarning, "Not enough memory to index the configuration file");
+			index->failed = true;
+			return;
+		}
+
+		if (index->entries)
+		{
+			memcpy(entries, index->entries, index->count * sizeof(sectionOffset));
+			delete[] index->entries;
+		}
+
+		index->entries = entries;
+		index->size = size;
+	}
+
+	index->entries[index->count].id = id;
+	index->entries[index->count].offset = offset;
+	index->count++;
+}
+
+void PBSConfig::sortIndex(sectionIndex* index)
+{
+	uint32_t i, j, count;
+
+	// Sections are usually written in order, so an insertion sort is almost free.
+	// It is stable, so a duplicated section keeps the first one found, like a scan would.
+	for (i = 1; i < index->count; i++)
+	{
+		sectionOffset entry = index->entries[i];
+
+		for (j = i; j > 0 && index->entries[j - 1].id > entry.id; j--)
+			index->entries[j] = index->entries[j - 1];
+
+		index->entries[j] = entry;
+	}
+
+	// Remove duplicates
+	for (i = 1, count = index->count ? 1 : 0; i < index->count; i++)
+	{
+		if (index->entries[i].id != index->entries[count - 1].id)
+			index->entries[count++] = index->entries[i];
+	}
+
+	index->count = count;
+}
+
+bool PBSConfig::seekSection(sectionIndex* index, uint32_t id, uint32_t first_offset)
+{
+	if (index->failed)
+		return config_file.setFileRWPointer(first_offset);
+
+	// Binary search
+	uint32_t low = 0;
+	uint32_t high = index->count;
+
+	while (low < high)
+	{
+		uint32_t mid = (low + high) / 2;
+
+		if (index->entries[mid].id == id)
+			return config_file.setFileRWPointer(index->entries[mid].offset);
+
+		if (index->entries[mid].id < id)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return false;
+}
+
 void PBSConfig::map()
 {
 	hardware_offset = settings_offset = first_profile_offset = first_font_offset = 0;
 	profile_count = 0;
+	profile_index.count = font_index.count = 0;
+	profile_index.failed = font_index.failed = false;
 
 	debugMsg(DebugInfo, "Mapping configuration file");
+	PBS_PROFILE_SCOPE("map");
+	mapped = true;
 
 	timeCounter.startCounter();
 
 	config_file.mapSections(mapCallbackStub, this);
+	sortIndex(&profile_index);
+	sortIndex(&font_index);
 
 	debugMsg(DebugInfo, "Mapping done in %lums", timeCounter.elapsed());
 }
@@ -1282,149 +1411,366 @@ void PBSConfig::map()
 void PBSConfig::dumpProfileInfo(saberProfile* profile)
 {
 #if PBS_DEBUG
-	const char* str = NULL;
-
 	debugMsg(DebugInfo, "-- Start profile info dump for profile%i", profile->id);
-	debugMsg(DebugInfo, "font_num = %i", profile->font_num);
-	debugMsg(DebugInfo, "ignition_duration = %i", profile->ignition_duration);
-	switch (profile->ignition_mode)
+	dumpKeys(profile_keys, KEY_COUNT(profile_keys), profile, NULL);
+	debugMsg(DebugInfo, "-- End profile info dump for profile%i", profile->id);
+#endif
+}
+
+void PBSConfig::dumpFontInfo(fontInfo* font)
+{
+#if PBS_DEBUG
+	debugMsg(DebugInfo, "-- Start info dump for font%i", font->id);
+	dumpKeys(font_keys, KEY_COUNT(font_keys), font, font->folder);
+	debugMsg(DebugInfo, "-- End info dump for font%i", font->id);
+#endif
+}
+
+static const uint32_t crc_table[16] =
+{
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t PBSConfig::crc32(uint32_t crc, const void* data, uint32_t len)
+{
+	const uint8_t* ptr = (const uint8_t*) data;
+
+	crc = ~crc;
+
+	while (len--)
 	{
-		case ignitionRamp: str = "ramp"; break;
-		case ignitionFull: str = "full"; break;
-		case ignitionScroll: str = "scroll"; break;
-		default: str = "unknown"; break;
+		crc ^= *ptr++;
+		crc = (crc >> 4) ^ crc_table[crc & 0x0F];
+		crc = (crc >> 4) ^ crc_table[crc & 0x0F];
 	}
-	debugMsg(DebugInfo, "ignition_mode = %s", str);
 
-	debugMsg(DebugInfo, "retraction_duration = %i", profile->retraction_duration);
-	switch (profile->retraction_mode)
+	return ~crc;
+}
+
+bool PBSConfig::getConfigKey(configFileKey* key)
+{
+	FILINFO info;
+	FIL file;
+	UINT read;
+	bool ret = true;
+
+	if (f_stat(config_path, &info) != FR_OK)
+		return false;
+
+	key->size = info.fsize;
+	key->timestamp = ((uint32_t) info.fdate << 16) | info.ftime;
+	key->crc = 0;
+
+	// Read in big chunks, so FatFs can do multi-sector reads
+	uint8_t* buffer = new uint8_t[PBS_SNAPSHOT_CRC_CHUNK];
+	if (!buffer)
+		return false;
+
+	if (f_open(&file, config_path, FA_READ) != FR_OK)
 	{
-		case retractionRamp: str = "ramp"; break;
-		case retractionFull: str = "full"; break;
-		case retractionScroll: str = "scroll"; break;
-		default: str = "unknown"; break;
+		delete[] buffer;
+		return false;
 	}
-	debugMsg(DebugInfo, "retraction_mode = %s", str);
 
-	if (profile->shimmer.randomize)
-		str = "random";
-	else
-		str = "pulse";
-
-	debugMsg(DebugInfo, "shimmer_mode = %s", str);
-	debugMsg(DebugInfo, "shimmer_color = %i,%i,%i,%i", profile->shimmer.base_color.r,
-													   profile->shimmer.base_color.g,
-													   profile->shimmer.base_color.b,
-													   profile->shimmer.base_color.w);
-	debugMsg(DebugInfo, "shimmer_freq = %lu", profile->shimmer.freq);
-	debugMsg(DebugInfo, "shimmer_depth = %lu", profile->shimmer.depth);
-
-	for (uint8_t i = 0; i < 4; i++)
-	{
-		bladeEffect* effect;
-		const char* type;
-		const char* mode;
-		switch (i)
+	do
+	{
+		if (f_read(&file, buffer, PBS_SNAPSHOT_CRC_CHUNK, &read) != FR_OK)
 		{
-			case 0: type = "clash"; effect = &profile->clash; break;
-			case 1: type = "blaster"; effect = &profile->blaster; break;
-			case 2: type = "stab"; effect = &profile->stab; break;
-			case 3: type = "lockup"; effect = &profile->lockup; break;
+			ret = false;
+			break;
 		}
 
-		switch (effect->type)
-		{
-			case effectTypeStatic: mode = "static"; break;
-			case effectTypeShimmer: mode = "shimmer"; break;
-			case effectTypeFlash: mode = "flash"; break;
-			case effectTypeSpark: mode = "spark"; break;
-			case effectTypeFlashSpark: mode = "flash_spark"; break;
-			case effectTypeBigSpark: mode = "big_spark"; break;
-			case effectTypeTipSpark: mode = "tip_spark"; break;
-			case effectTypeFlashFlicker: mode = "flash_flicker"; break;
-			default: mode = "unknown";
-		}
+		key->crc = crc32(key->crc, buffer, read);
+	} while (read == PBS_SNAPSHOT_CRC_CHUNK);
+
+	f_close(&file);
+	delete[] buffer;
+	return ret;
+}
+
+bool PBSConfig::loadSnapshot()
+{
+	snapshotHeader header;
+	configFileKey key;
+	UINT read;
+
+	PBS_PROFILE_SCOPE("loadSnapshot");
 
-		debugMsg(DebugInfo, "%s_mode = %s", type, mode);
-		debugMsg(DebugInfo, "%s_color = %i,%i,%i,%i", type, effect->base_color.r,
-		         	 	 	 	 	 	 	 	 	 	 	 effect->base_color.g,
-		         	 	 	 	 	 	 	 	 	 	 	 effect->base_color.b,
-		         	 	 	 	 	 	 	 	 	 	 	 effect->base_color.w);
-		debugMsg(DebugInfo, "%s_blend = %lu", type, effect->blend);
-		debugMsg(DebugInfo, "%s_freq = %lu", type, effect->freq);
-		debugMsg(DebugInfo, "%s_depth = %lu", type, effect->depth);
-		debugMsg(DebugInfo, "%s_random = %s", type, effect->randomize ? "yes" : "no");
-		debugMsg(DebugInfo, "%s_duration = %lu", type, effect->duration);
+	if (f_open(&snapshot, snapshot_file, FA_READ | FA_WRITE) != FR_OK)
+		return false;
+
+	timeCounter.startCounter();
+
+	if (f_read(&snapshot, &header, sizeof(snapshotHeader), &read) != FR_OK ||
+		read != sizeof(snapshotHeader) ||
+		header.magic != PBS_SNAPSHOT_MAGIC ||
+		header.version != PBS_SNAPSHOT_VERSION ||
+		header.settings_size != sizeof(saberSettings) ||
+		header.hardware_size != sizeof(snapshotHardware) ||
+		header.profile_size != sizeof(saberProfile) ||
+		header.font_size != sizeof(fontInfo) ||
+		header.crc != crc32(0, &header, offsetof(snapshotHeader, crc)))
+	{
+		debugMsg(DebugWarning, "Invalid configuration snapshot");
+		f_close(&snapshot);
+		return false;
 	}
 
-	debugMsg(DebugInfo, "-- End profile info dump for profile%i", profile->id);
-#endif
+	// Check it belongs to the current configuration file
+	if (!getConfigKey(&key) || memcmp(&key, &header.key, sizeof(configFileKey)) != 0)
+	{
+		debugMsg(DebugInfo, "Configuration file has changed, ignoring snapshot");
+		f_close(&snapshot);
+		return false;
+	}
+
+	settings = header.settings;
+	file_settings = header.settings;
+	hw.blade_type = header.hw.blade_type;
+	hw.strip_type = header.hw.strip_type;
+	hw.strip_count = header.hw.strip_count;
+	memcpy(hw.hbled_current, header.hw.hbled_current, sizeof(hw.hbled_current));
+	hw.hbled_is_rgb = header.hw.hbled_is_rgb;
+	hw.button_onoff.pin = header.hw.onoff_pin;
+	hw.button_onoff.active_high = header.hw.onoff_active_high;
+	hw.button_fx.pin = header.hw.fx_pin;
+	hw.button_fx.active_high = header.hw.fx_active_high;
+	hw.has_button_fx = header.hw.has_button_fx;
+
+	hardware_offset = header.hardware_offset;
+	settings_offset = header.settings_offset;
+	first_profile_offset = header.first_profile_offset;
+	first_font_offset = header.first_font_offset;
+	snapshot_profile_count = header.profile_count;
+	snapshot_font_count = header.font_count;
+	snapshot_open = true;
+
+	debugMsg(DebugInfo, "Configuration snapshot read in %lu ms", timeCounter.elapsed());
+	return true;
 }
 
-void PBSConfig::dumpFontInfo(fontInfo* font)
+bool PBSConfig::readSnapshotRecord(uint32_t offset, void* dst, uint32_t size)
 {
-#if PBS_DEBUG
-	debugMsg(DebugInfo, "-- Start info dump for font%i", font->id);
-	debugMsg(DebugInfo, "title = %s", font->title);
-	debugMsg(DebugInfo, "folder = %s", font->folder);
-	debugMsg(DebugInfo, "poly = %s", font->poly ? "yes" : "no");
+	uint32_t crc;
+	UINT read;
+
+	if (f_lseek(&snapshot, offset) != FR_OK ||
+		f_read(&snapshot, dst, size, &read) != FR_OK || read != size ||
+		f_read(&snapshot, &crc, sizeof(uint32_t), &read) != FR_OK || read != sizeof(uint32_t))
+		return false;
+
+	return crc == crc32(0, dst, size);
+}
+
+bool PBSConfig::writeSnapshotRecord(FIL* file, void* src, uint32_t size)
+{
+	uint32_t crc = crc32(0, src, size);
+	UINT written;
+
+	if (f_write(file, src, size, &written) != FR_OK || written != size ||
+		f_write(file, &crc, sizeof(uint32_t), &written) != FR_OK || written != sizeof(uint32_t))
+		return false;
+
+	return true;
+}
+
+bool PBSConfig::saveSnapshot(bool* done)
+{
+	// Written a step per call: the header first, then a profile or a font each time, and
+	// then the header again. Nothing is left to do if the current snapshot is valid.
+	*done = true;
+
+	if (snapshot_open)
+		return true;
+
+	if (!snapshot_header)
+	{
+		if (!beginSnapshot())
+			return false;
+
+		*done = false;
+		return true;
+	}
+
+	snapshotHeader* header = snapshot_header;
+	uint32_t id = ++snapshot_record;
+	bool ret;
 
-	for (int32_t i = 0; i < fontMax; i++)
+	// Don't dump every profile and font
+	bool dump_profile_info = settings.dump_profile_info;
+	bool dump_font_info = settings.dump_font_info;
+	settings.dump_profile_info = settings.dump_font_info = false;
+
+	if (id <= header->profile_count)
 	{
-		const char* type;
+		saberProfile* profile = new saberProfile;
+		ret = profile != NULL;
 
-		switch (i)
+		if (ret)
 		{
-			case fontBoot: type = "boot"; break;
-			case fontIgnition: type = "ignition"; break;
-			case fontRetraction: type = "retraction"; break;
-			case fontLowPower: type = "low_power"; break;
-			case fontHum: type = "hum"; break;
-			case fontBlaster: type = "blaster"; break;
-			case fontLock: type = "lock"; break;
-			case fontSwing: type = "swing"; break;
-			case fontClash: type = "clash"; break;
-			case fontSpin: type = "spin"; break;
-			case fontStab: type = "stab"; break;
-			case fontBackground: type = "background"; break;
-			case fontForce: type = "force"; break;
-			case fontName: type = "name"; break;
-			default:
-			case fontMax: type = "unknown"; break;
+			if (!loadProfile(id, profile))
+				memset((void*) profile, 0, sizeof(saberProfile));
+
+			ret = writeSnapshotRecord(&snapshot_write, profile, sizeof(saberProfile));
+			delete profile;
 		}
+	} else if (id - header->profile_count <= header->font_count)
+	{
+		fontInfo* font = new fontInfo;
+		ret = font != NULL;
 
-		if (!font->files[i].present)
+		if (ret)
 		{
-			debugMsg(DebugInfo, "%s = not present", type);
-		} else {
-			if (font->files[i].random) // It means they have min and max values
-			{
-				debugMsg(DebugInfo, "%s = %s\\%s(%i-%i).wav", type, font->folder,
-																	font->files[i].filename,
-																	font->files[i].min,
-																	font->files[i].max);
-			} else {
-				debugMsg(DebugInfo, "%s = %s\\%s.wav", type, font->folder,
-															 font->files[i].filename);
-			}
+			if (!loadFontInfo(id - header->profile_count, font))
+				memset(font, 0, sizeof(fontInfo));
+
+			ret = writeSnapshotRecord(&snapshot_write, font, sizeof(fontInfo));
+			delete font;
 		}
+	} else
+	{
+		settings.dump_profile_info = dump_profile_info;
+		settings.dump_font_info = dump_font_info;
+		return endSnapshot();
 	}
 
-	debugMsg(DebugInfo, "-- End info dump for font%i", font->id);
-#endif
+	settings.dump_profile_info = dump_profile_info;
+	settings.dump_font_info = dump_font_info;
+
+	if (!ret)
+	{
+		abortSnapshot();
+		return false;
+	}
+
+	*done = false;
+	return true;
 }
 
-bool PBSConfig::saveInitialProfile(uint32_t id)
+bool PBSConfig::beginSnapshot()
 {
-	if (config_file.setFileRWPointer(settings_offset))
+	snapshotHeader* header;
+	UINT written;
+
+	if (!snapshot_file[0])
+		return false;
+
+	if (!mapped)
+		map();
+
+	header = new snapshotHeader;
+	if (!header)
+		return false;
+
+	memset(header, 0, sizeof(snapshotHeader));
+
+	if (!getConfigKey(&header->key))
 	{
-		if (config_file.writeValue("settings", "initial_profile", id))
-		{
-			// Remap
-			map();
-			return true;
-		}
+		delete header;
+		return false;
 	}
 
-	return false;
+	snapshot_start = GetTickCount();
+	debugMsg(DebugInfo, "Writing configuration snapshot %s", snapshot_file);
+
+	header->version = PBS_SNAPSHOT_VERSION;
+	header->settings_size = sizeof(saberSettings);
+	header->hardware_size = sizeof(snapshotHardware);
+	header->profile_size = sizeof(saberProfile);
+	header->font_size = sizeof(fontInfo);
+
+	// Store every profile/font up to the highest profileN/fontN found
+	if (profile_index.failed)
+		header->profile_count = settings.profile_count;
+	else if (profile_index.count)
+		header->profile_count = profile_index.entries[profile_index.count - 1].id;
+
+	if (!font_index.failed && font_index.count)
+		header->font_count = font_index.entries[font_index.count - 1].id;
+
+	header->hardware_offset = hardware_offset;
+	header->settings_offset = settings_offset;
+	header->first_profile_offset = first_profile_offset;
+	header->first_font_offset = first_font_offset;
+	header->settings = file_settings;
+	header->hw.blade_type = hw.blade_type;
+	header->hw.strip_type = hw.strip_type;
+	header->hw.strip_count = hw.strip_count;
+	memcpy(header->hw.hbled_current, hw.hbled_current, sizeof(hw.hbled_current));
+	header->hw.hbled_is_rgb = hw.hbled_is_rgb;
+	header->hw.onoff_pin = hw.button_onoff.pin;
+	header->hw.onoff_active_high = hw.button_onoff.active_high;
+	header->hw.fx_pin = hw.button_fx.pin;
+	header->hw.fx_active_high = hw.button_fx.active_high;
+	header->hw.has_button_fx = hw.has_button_fx;
+
+	if (f_open(&snapshot_write, snapshot_file, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+	{
+		delete header;
+		return false;
+	}
+
+	snapshot_header = header;
+	snapshot_record = 0;
+
+	// The header is written with a zero magic, and rewritten at the end. An interrupted
+	// write leaves an invalid snapshot.
+	if (f_write(&snapshot_write, header, sizeof(snapshotHeader), &written) != FR_OK ||
+		written != sizeof(snapshotHeader))
+	{
+		abortSnapshot();
+		return false;
+	}
+
+	return true;
+}
+
+bool PBSConfig::endSnapshot()
+{
+	snapshotHeader* header = snapshot_header;
+	UINT written;
+	bool ret = true;
+
+	header->magic = PBS_SNAPSHOT_MAGIC;
+	header->crc = crc32(0, header, offsetof(snapshotHeader, crc));
+
+	if (f_lseek(&snapshot_write, 0) != FR_OK ||
+		f_write(&snapshot_write, header, sizeof(snapshotHeader), &written) != FR_OK ||
+		written != sizeof(snapshotHeader))
+		ret = false;
+
+	if (!ret)
+	{
+		abortSnapshot();
+		return false;
+	}
+
+	f_close(&snapshot_write);
+	debugMsg(DebugInfo, "Configuration snapshot written in %lu ms",
+			 GetTickCount() - snapshot_start);
+
+	snapshot_profile_count = header->profile_count;
+	snapshot_font_count = header->font_count;
+	delete header;
+	snapshot_header = NULL;
+
+	// Use it from now on
+	if (f_open(&snapshot, snapshot_file, FA_READ | FA_WRITE) != FR_OK)
+		return false;
+
+	snapshot_open = true;
+	return true;
+}
+
+void PBSConfig::abortSnapshot()
+{
+	if (!snapshot_header)
+		return;
+
+	debugMsg(DebugError, "Error writing configuration snapshot");
+	f_close(&snapshot_write);
+	f_unlink(snapshot_file);
+	delete snapshot_header;
+	snapshot_header = NULL;
 }
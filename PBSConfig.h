@@ -31,10 +31,20 @@
 #include <PropConfig.h>
 #include <LedStripDriver.h>
 #include "PBSDebug.h"
+#include "PBSProfile.h"
 #include "TimeCounter.h"
 
 #define MAX_FONT_NAME_LEN		32
 
+// Path of a font pack: folder and file name
+#define PBS_PACK_PATH_LEN		(MAX_FONT_NAME_LEN * 2 + 2)
+
+// Binary snapshot of the parsed configuration, stored next to the configuration file
+#define PBS_SNAPSHOT_MAGIC		0x43534250		// "PBSC"
+#define PBS_SNAPSHOT_VERSION	9
+#define PBS_SNAPSHOT_EXT		".pbc"
+#define PBS_SNAPSHOT_CRC_CHUNK	4096
+
 // Blade types
 typedef enum _bladeType
 {
@@ -120,6 +130,10 @@ typedef struct
 	uint32_t clash_limiter;
 	uint32_t spin_limiter;
 	uint32_t dynamic_swing_depth;
+	uint32_t hum_pitch;
+	uint32_t hum_filter;
+	uint32_t music_filter;
+	bool limiter;
 	uint32_t clash_sensitivity;
 	uint32_t button_debounce;
 	uint32_t off_time;
@@ -127,6 +141,8 @@ typedef struct
 	char sound_utils[MAX_FONT_NAME_LEN];
 	bool dump_profile_info;
 	bool dump_font_info;
+	bool dump_boot_info;
+	char boot_log[MAX_FONT_NAME_LEN];
 
 } saberSettings;
 
@@ -154,6 +170,8 @@ typedef enum
 	fontForce,
 	fontBackground,
 	fontName,
+	fontSwingLow,				// Smooth swing pair
+	fontSwingHigh,
 	fontMax
 } fontSoundType;
 
@@ -163,6 +181,7 @@ typedef struct
 	bool poly;
 	char title[MAX_FONT_NAME_LEN];
 	char folder[MAX_FONT_NAME_LEN];
+	char pack[MAX_FONT_NAME_LEN];	// Font pack in the folder, empty to use the files
 
 	fontSoundFile files[fontMax];
 
@@ -183,8 +202,7 @@ typedef struct
 typedef struct
 {
 	uint32_t id;
-	uint32_t font_num;
-	fontInfo font;
+	uint32_t font_num;			// fontN section of the font. Fonts are loaded separately.
 	ignitionMode ignition_mode;
 	uint32_t ignition_duration;
 	bool ignition_on_stab;
@@ -197,17 +215,121 @@ typedef struct
 	bladeEffect lockup;
 } saberProfile;
 
+// Offset of a profileN/fontN section in the configuration file
+typedef struct
+{
+	uint32_t id;
+	uint32_t offset;
+} sectionOffset;
+
+// Identifies a version of the configuration file
+typedef struct
+{
+	uint32_t size;
+	uint32_t timestamp;
+	uint32_t crc;
+} configFileKey;
+
+// Index of profileN/fontN sections, sorted by N
+typedef struct
+{
+	sectionOffset* entries;
+	uint32_t count;
+	uint32_t size;
+	bool failed;
+} sectionIndex;
+
+// Hardware configuration as stored in the snapshot, without the button objects
+typedef struct
+{
+	bladeType blade_type;
+	LedStripeType strip_type;
+	uint32_t strip_count;
+	uint16_t hbled_current[3];
+	bool hbled_is_rgb;
+	uint32_t onoff_pin;
+	bool onoff_active_high;
+	uint32_t fx_pin;
+	bool fx_active_high;
+	bool has_button_fx;
+} snapshotHardware;
+
+// The snapshot file starts with this header, followed by one record for each profile and
+// font, from 1 to profile_count/font_count. Every record is followed by its CRC. Records
+// of profiles/fonts that failed to load have id = 0.
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	configFileKey key;
+	uint32_t settings_size;
+	uint32_t hardware_size;
+	uint32_t profile_size;
+	uint32_t font_size;
+	uint32_t profile_count;
+	uint32_t font_count;
+	uint32_t hardware_offset;
+	uint32_t settings_offset;
+	uint32_t first_profile_offset;
+	uint32_t first_font_offset;
+	saberSettings settings;
+	snapshotHardware hw;
+	uint32_t crc;
+} snapshotHeader;
+
+// Value types of the configuration file keys
+typedef enum
+{
+	valueNumber,		// uint8_t or uint32_t, depending on the field size
+	valueBool,
+	valueFloat,
+	valueString,
+	valueEnum,			// One of the strings of a configEnumValue list
+	valueColor,			// R,G,B[,W]
+	valueArray,			// uint16_t list
+	valueSound,			// File name of a fontSoundFile
+	valueMinMax,		// Random min,max of a fontSoundFile
+} configValueType;
+
+// Key flags
+#define KEY_STRIP_ONLY		0x01	// Read only if blade_type = pixel
+#define KEY_HBLED_ONLY		0x02	// Read only if blade_type = hbled
+#define KEY_KEEP_IF_EMPTY	0x04	// An empty string doesn't overwrite the current value
+
+// String value of a valueEnum key
+typedef struct
+{
+	const char* name;
+	uint32_t value;
+} configEnumValue;
+
+// Schema of a configuration file key. Every section has a table of keys sorted by name.
+typedef struct
+{
+	const char* name;
+	uint8_t type;
+	uint8_t id;
+	uint8_t flags;
+	uint8_t size;
+	uint16_t offset;
+	const configEnumValue* values;
+} configKey;
+
 class PBSConfig
 {
 public:
 	PBSConfig();
+	~PBSConfig();
 	bool open(const char* file);
 	bool read();
 	bool readAudioSettings();
 	bool loadProfile(uint32_t id, saberProfile* profile);
 	bool saveProfile(uint32_t id, saberProfile* profile);
 	bool loadFontInfo(uint32_t id, fontInfo* fi);
-	bool saveInitialProfile(uint32_t id);
+	bool saveSnapshot(bool* done);
+
+	static uint32_t crc32(uint32_t crc, const void* data, uint32_t len);
+	static bool getPackPath(fontInfo* fi, char* path, uint32_t size);
 
 	saberHardware hw;
 	saberSettings settings;
@@ -219,6 +341,26 @@ private:
 	uint32_t first_profile_offset;
 	uint32_t first_font_offset;
 	uint32_t profile_count;
+	sectionIndex profile_index;
+	sectionIndex font_index;
+	bool mapped;
+
+	FIL snapshot;
+	bool snapshot_open;
+	char config_path[64];
+	char snapshot_file[64];
+	uint32_t snapshot_profile_count;
+	uint32_t snapshot_font_count;
+
+	// Settings as read from the configuration file, before the saber changes them (the
+	// journal restores the last profile and volume on top). The snapshot stores these.
+	saberSettings file_settings;
+
+	// Snapshot being written by saveSnapshot(), a record per call
+	FIL snapshot_write;
+	snapshotHeader* snapshot_header;
+	uint32_t snapshot_record;
+	uint32_t snapshot_start;
 
 	bool readSettings();
 	bool readHardwareConfiguration();
@@ -228,6 +370,17 @@ private:
 	void dumpFontInfo(fontInfo* font);
 	void map();
 	bool mapCallback(uint32_t section, uint32_t data, char* str);
+	void indexSection(sectionIndex* index, char* number, uint32_t offset);
+	void sortIndex(sectionIndex* index);
+	bool seekSection(sectionIndex* index, uint32_t id, uint32_t first_offset);
+	bool getConfigKey(configFileKey* key);
+	bool loadSnapshot();
+	bool readSnapshotRecord(uint32_t offset, void* dst, uint32_t size);
+	bool writeSnapshotRecord(FIL* file, void* src, uint32_t size);
+	bool beginSnapshot();
+	bool endSnapshot();
+	void abortSnapshot();
+	bool readKey(const configKey* key, uint32_t token, void* dst);
 
 	static bool mapCallbackStub(uint32_t section,
 								uint32_t data, char* str, void* param)
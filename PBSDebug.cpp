@@ -42,7 +42,7 @@ void debugPrint(uint32_t level, const char* fmt, ...)
 {
 	uint32_t timestamp = GetTickCount();
 
-	sprintf(debug_string, "[ %08lu ] ", timestamp);
+	sprintf(debug_string, "[ %08lu ] ", (unsigned long) timestamp);
 	debugOut(debug_string, false);
 
 	if (level & DebugError)
@@ -0,0 +1,171 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSLatency.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSLatency.h"
+
+PBSLatency::PBSLatency()
+{
+	reset();
+}
+
+void PBSLatency::reset()
+{
+	memset(histograms, 0, sizeof(histograms));
+
+	for (uint32_t i = 0; i < PBS_LATENCY_TYPES; i++)
+		histograms[i].min = 0xFFFFFFFF;
+
+	event_pending = false;
+	event_time = 0;
+	waiting = false;
+	current_type = -1;
+	start_time = state_time = play_time = 0;
+}
+
+void PBSLatency::event(uint32_t time)
+{
+	event_time = time;
+	event_pending = true;
+}
+
+void PBSLatency::state(int32_t type)
+{
+	// Effects not started by an event (like a swing while in lock-up) are not measured
+	if (type < 0 || type >= PBS_LATENCY_TYPES || !event_pending)
+	{
+		event_pending = false;
+		return;
+	}
+
+	waiting = false;
+	current_type = type;
+	start_time = event_time;
+	state_time = micros();
+	play_time = 0;
+	event_pending = false;
+	waiting = true;
+}
+
+void PBSLatency::play()
+{
+	// Only the first sound of the effect
+	if (waiting && !play_time)
+		play_time = micros();
+}
+
+void PBSLatency::firstSample(uint32_t delay)
+{
+	if (!waiting || !play_time)
+		return;
+
+	uint32_t now = micros() + delay;
+	latencyHistogram* h = &histograms[current_type];
+
+	waiting = false;
+	h->stage_total[latencyState] += state_time - start_time;
+	h->stage_total[latencyPlay] += play_time - state_time;
+	h->stage_total[latencySample] += now - play_time;
+	record(current_type, now - start_time);
+}
+
+uint32_t PBSLatency::getBin(uint32_t value)
+{
+	if (value < (1UL << PBS_LATENCY_BIN_MIN))
+		return 0;
+
+	// Power of two, then the step inside it
+	uint32_t log2 = 31 - __builtin_clz(value);
+	uint32_t step = (value >> (log2 - 2)) & (PBS_LATENCY_BIN_STEPS - 1);
+	uint32_t bin = (log2 - PBS_LATENCY_BIN_MIN) * PBS_LATENCY_BIN_STEPS + step + 1;
+
+	return bin < PBS_LATENCY_BINS ? bin : PBS_LATENCY_BINS - 1;
+}
+
+uint32_t PBSLatency::getBinEdge(uint32_t bin)
+{
+	if (!bin)
+		return 1UL << PBS_LATENCY_BIN_MIN;
+
+	bin--;
+	uint32_t log2 = bin / PBS_LATENCY_BIN_STEPS + PBS_LATENCY_BIN_MIN;
+	uint32_t step = bin % PBS_LATENCY_BIN_STEPS;
+
+	return (1UL << log2) + ((step + 1) << (log2 - 2));
+}
+
+void PBSLatency::record(uint32_t type, uint32_t total)
+{
+	latencyHistogram* h = &histograms[type];
+
+	h->count++;
+	h->total += total;
+
+	if (total < h->min)
+		h->min = total;
+
+	if (total > h->max)
+		h->max = total;
+
+	if (total > PBS_LATENCY_BUDGET)
+		h->over_budget++;
+
+	uint32_t bin = getBin(total);
+	if (h->bins[bin] < UINT16_MAX)
+		h->bins[bin]++;
+}
+
+bool PBSLatency::getStats(uint32_t type, latencyStats* stats)
+{
+	if (type >= PBS_LATENCY_TYPES || !histograms[type].count)
+		return false;
+
+	latencyHistogram* h = &histograms[type];
+	uint32_t target = h->count - h->count / 100;
+	uint32_t sum = 0;
+
+	stats->count = h->count;
+	stats->min = h->min;
+	stats->max = h->max;
+	stats->avg = (uint32_t) (h->total / h->count);
+	stats->over_budget = h->over_budget;
+	stats->p99 = h->max;
+
+	for (uint32_t i = 0; i < latencyStageMax; i++)
+		stats->stage_avg[i] = (uint32_t) (h->stage_total[i] / h->count);
+
+	for (uint32_t i = 0; i < PBS_LATENCY_BINS; i++)
+	{
+		sum += h->bins[i];
+		if (sum >= target)
+		{
+			// The last bin has no upper edge
+			if (i < PBS_LATENCY_BINS - 1 && getBinEdge(i) < h->max)
+				stats->p99 = getBinEdge(i);
+			break;
+		}
+	}
+
+	return true;
+}
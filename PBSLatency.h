@@ -0,0 +1,114 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSLatency.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSLATENCY_H__
+#define __PBSLATENCY_H__
+
+#include <Arduino.h>
+
+// Histograms kept, one for each effect
+#define PBS_LATENCY_TYPES		9
+
+// Events slower than this (us) are counted apart
+#ifndef PBS_LATENCY_BUDGET
+#define PBS_LATENCY_BUDGET		10000
+#endif
+
+// Histogram bins: 4 per power of two, from 64us up to ~64ms. The last bin takes the rest.
+#define PBS_LATENCY_BIN_MIN		6		// log2(64)
+#define PBS_LATENCY_BIN_STEPS	4
+#define PBS_LATENCY_BINS		41
+
+typedef enum
+{
+	latencyState,				// Event to state transition
+	latencyPlay,				// State transition to play()
+	latencySample,				// play() to the first sample rendered
+	latencyStageMax
+} latencyStage;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	uint64_t stage_total[latencyStageMax];
+	uint32_t over_budget;
+	uint16_t bins[PBS_LATENCY_BINS];
+} latencyHistogram;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;
+	uint32_t avg;
+	uint32_t p99;				// Upper edge of the bin holding the 99th percentile
+	uint32_t max;
+	uint32_t stage_avg[latencyStageMax];
+	uint32_t over_budget;
+} latencyStats;
+
+// Measures the time from an event (accelerometer interrupt or button) to the first sample
+// of the sound it plays, in us
+class PBSLatency
+{
+public:
+	PBSLatency();
+	void reset();
+
+	// Called by the loop when it takes an event. 'time' is when it happened.
+	void event(uint32_t time);
+
+	// Called on every state transition. Effects have a type, other states -1.
+	void state(int32_t type);
+
+	void play();
+
+	// Called from the audio interrupt when a player renders its first block. 'delay' is
+	// the time the block still waits in the output chain (the limiter look-ahead), in us.
+	void firstSample(uint32_t delay = 0);
+
+	// Drops an event that didn't trigger anything
+	inline void drop() { event_pending = false; }
+
+	bool getStats(uint32_t type, latencyStats* stats);
+
+private:
+	void record(uint32_t type, uint32_t total);
+	uint32_t getBin(uint32_t value);
+	uint32_t getBinEdge(uint32_t bin);
+
+	latencyHistogram histograms[PBS_LATENCY_TYPES];
+	bool event_pending;
+	uint32_t event_time;
+	volatile bool waiting;
+	int32_t current_type;
+	uint32_t start_time;
+	uint32_t state_time;
+	volatile uint32_t play_time;
+};
+
+#endif /* __PBSLATENCY_H__ */
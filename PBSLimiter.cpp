@@ -0,0 +1,171 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSLimiter.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSLimiter.h"
+#include <math.h>
+
+#if defined(__ARM_FEATURE_SAT)
+#include <arm_acle.h>
+#define LIMITER_SAT16(x)		__ssat((x), 16)
+#else
+#define LIMITER_SAT16(x)		((x) > 32767 ? 32767 : ((x) < -32768 ? -32768 : (x)))
+#endif
+
+#define LIMITER_UNITY			32768
+
+PBSLimiter::PBSLimiter() : length(1), delay_us(0), ceiling(32767), release(LIMITER_UNITY),
+	inv_length(65536)
+{
+	reset();
+	resetStats();
+}
+
+void PBSLimiter::begin(uint32_t fs, float ceiling, uint32_t lookahead, uint32_t release)
+{
+	length = (uint32_t) (((uint64_t) lookahead * fs) / 1000000);
+	if (length < 1)
+		length = 1;
+	else if (length > PBS_LIMITER_MAX_DELAY)
+		length = PBS_LIMITER_MAX_DELAY;
+
+	// The signal comes out length - 1 samples later, when the gain reaches the peak
+	delay_us = (uint32_t) (((uint64_t) (length - 1) * 1000000) / fs);
+	inv_length = (65536 + length - 1) / length;
+
+	if (ceiling > 0)
+		ceiling = 0;
+
+	this->ceiling = (int32_t) (32767 * powf(10.0f, ceiling / 20.0f));
+
+	float samples = release * (fs / 1000.0f);
+	this->release = samples > 1 ? (int32_t) (LIMITER_UNITY * (1.0f - expf(-1.0f / samples))) :
+					LIMITER_UNITY;
+	if (!this->release)
+		this->release = 1;
+
+	reset();
+}
+
+void PBSLimiter::reset()
+{
+	memset(delay, 0, sizeof(delay));
+
+	for (uint32_t i = 0; i < PBS_LIMITER_MAX_DELAY; i++)
+		gains[i] = LIMITER_UNITY;
+
+	sum = LIMITER_UNITY * length;
+	released = LIMITER_UNITY << 15;
+	pos = 0;
+	min_head = 0;
+	min_count = 0;
+	sample = 0;
+}
+
+void PBSLimiter::resetStats()
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.min_gain = LIMITER_UNITY;
+}
+
+void PBSLimiter::process(const int32_t* in, int16_t* out, uint32_t count)
+{
+	bool limited = false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int32_t x = in[i];
+		int32_t peak = x < 0 ? -x : x;
+
+		// Gain this sample needs. Most samples are under the ceiling and need no division.
+		int32_t needed = peak > ceiling ? (int32_t) (((int64_t) ceiling << 15) / peak) :
+						 LIMITER_UNITY;
+
+		// In Q30, so the last steps up aren't lost to rounding
+		needed <<= 15;
+		if (needed < released)
+			released = needed;
+		else
+			released += (int32_t) (((int64_t) (needed - released) * release) >> 15);
+
+		int32_t wanted = (released + (1 << 14)) >> 15;
+
+		// Minimum over the window: drop the larger gains at the back, and the one at the
+		// front once it's out of the window
+		while (min_count)
+		{
+			uint32_t back = (min_head + min_count - 1) % PBS_LIMITER_MAX_DELAY;
+			if (min_gains[back] < wanted)
+				break;
+			min_count--;
+		}
+
+		uint32_t back = (min_head + min_count) % PBS_LIMITER_MAX_DELAY;
+		min_gains[back] = wanted;
+		min_expire[back] = sample + length;
+		min_count++;
+
+		if (min_expire[min_head] == sample)
+		{
+			min_head = (min_head + 1) % PBS_LIMITER_MAX_DELAY;
+			min_count--;
+		}
+
+		int32_t minimum = min_gains[min_head];
+		sample++;
+
+		// Average over the window, and the sample that entered the delay line length - 1
+		// samples ago
+		uint32_t oldest = pos;
+		sum += minimum - gains[oldest];
+		gains[oldest] = minimum;
+
+		int32_t gain = (int32_t) (((int64_t) sum * inv_length) >> 16);
+		if (gain > LIMITER_UNITY)
+			gain = LIMITER_UNITY;
+
+		delay[pos] = x;
+		if (++pos == length)
+			pos = 0;
+
+		int32_t y = (int32_t) (((int64_t) delay[pos] * gain) >> 15);
+		if (y > 32767 || y < -32768)
+			stats.clipped++;
+
+		out[i] = (int16_t) LIMITER_SAT16(y);
+
+		if (gain < LIMITER_UNITY)
+		{
+			limited = true;
+			stats.limited_samples++;
+
+			if (gain < stats.min_gain)
+				stats.min_gain = gain;
+		}
+	}
+
+	stats.blocks++;
+	if (limited)
+		stats.limited_blocks++;
+}
@@ -0,0 +1,92 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSLimiter.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSLIMITER_H__
+#define __PBSLIMITER_H__
+
+#include <Arduino.h>
+
+// Longest look-ahead, in samples (5 ms at 96 kHz)
+#define PBS_LIMITER_MAX_DELAY	512
+
+typedef struct
+{
+	uint32_t blocks;			// Blocks processed
+	uint32_t limited_blocks;	// Blocks with some gain reduction
+	uint32_t limited_samples;
+	uint32_t clipped;			// Samples still over full scale, clipped at the output
+	int32_t min_gain;			// Deepest gain reduction, Q15
+} limiterStats;
+
+// Look-ahead peak limiter for the master mix. The mix is delayed by the look-ahead, so the
+// gain can come down before a peak arrives instead of clipping it.
+//
+// Each sample asks for the gain that brings it to the ceiling. That goes through a release
+// filter (instant down, exponential up), then the minimum over the look-ahead window, then
+// the average over the same window: the gain ramps down over the look-ahead and reaches
+// what the peak needs when the peak leaves the delay line. Gains are Q15.
+class PBSLimiter
+{
+public:
+	PBSLimiter();
+
+	// 'ceiling' in dBFS (0 or less), 'lookahead' in us, 'release' in ms
+	void begin(uint32_t fs, float ceiling, uint32_t lookahead, uint32_t release);
+	void reset();
+
+	// Limits 'count' samples of the mix (any range) into 16-bit samples
+	void process(const int32_t* in, int16_t* out, uint32_t count);
+
+	// Delay added to the audio output
+	uint32_t getDelayUs() { return delay_us; }
+
+	inline const limiterStats* getStats() { return &stats; }
+	void resetStats();
+
+private:
+	uint32_t length;					// Look-ahead, samples
+	uint32_t delay_us;
+	int32_t ceiling;
+	int32_t release;					// Q15, fraction of the way up per sample
+	uint32_t inv_length;				// Q16, rounded up
+	int32_t released;					// Gain out of the release filter, Q30
+
+	// Delay line of the mix and of the released gains, and their running sum
+	int32_t delay[PBS_LIMITER_MAX_DELAY];
+	int32_t gains[PBS_LIMITER_MAX_DELAY];
+	uint32_t pos;
+	int32_t sum;
+
+	// Minimum over the window: increasing gains, with when each one leaves the window
+	int32_t min_gains[PBS_LIMITER_MAX_DELAY];
+	uint32_t min_expire[PBS_LIMITER_MAX_DELAY];
+	uint32_t min_head;
+	uint32_t min_count;
+	uint32_t sample;
+
+	limiterStats stats;
+};
+
+#endif /* __PBSLIMITER_H__ */
@@ -0,0 +1,427 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSManifest.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSManifest.h"
+#include "PBSPack.h"
+#include "PBSAdpcm.h"
+#include "PBSPlayer.h"
+
+PBSManifest::PBSManifest()
+{
+	memset(&header, 0, sizeof(fontManifestHeader));
+	manifest_file[0] = 0;
+}
+
+uint32_t PBSManifest::getFontKey(fontInfo* font)
+{
+	// What decides which files are read, and the files themselves. The 'present' flags
+	// are not included, they get cleared for sounds without files.
+	uint32_t crc = PBSConfig::crc32(0, font->folder, strlen(font->folder));
+	DIR dir;
+	FILINFO fi;
+
+	if (strlen(font->pack))
+		crc = PBSConfig::crc32(crc, font->pack, strlen(font->pack) + 1);
+
+	for (uint32_t i = 0; i < fontMax; i++)
+	{
+		fontSoundFile* file = &font->files[i];
+		crc = PBSConfig::crc32(crc, file->filename, strlen(file->filename) + 1);
+		crc = PBSConfig::crc32(crc, &file->random, sizeof(bool));
+		crc = PBSConfig::crc32(crc, &file->min, sizeof(uint32_t));
+		crc = PBSConfig::crc32(crc, &file->max, sizeof(uint32_t));
+	}
+
+	// Size and time of the sound files and the pack, so a file copied over another one
+	// builds a new manifest. One pass over the folder is cheaper than opening every file.
+	if (f_opendir(&dir, font->folder) != FR_OK)
+		return crc;
+
+	while (f_readdir(&dir, &fi) == FR_OK && fi.fname[0])
+	{
+		const char* ext = strrchr(fi.fname, '.');
+
+		if ((fi.fattrib & AM_DIR) || !ext || (strcasecmp(ext, ".wav") != 0 &&
+			strcasecmp(fi.fname, font->pack) != 0))
+			continue;
+
+		uint32_t size = (uint32_t) fi.fsize;
+		uint32_t timestamp = ((uint32_t) fi.fdate << 16) | fi.ftime;
+
+		crc = PBSConfig::crc32(crc, fi.fname, strlen(fi.fname) + 1);
+		crc = PBSConfig::crc32(crc, &size, sizeof(uint32_t));
+		crc = PBSConfig::crc32(crc, &timestamp, sizeof(uint32_t));
+	}
+
+	f_closedir(&dir);
+	return crc;
+}
+
+bool PBSManifest::load(fontInfo* font)
+{
+	PBS_PROFILE_SCOPE("manifest", font->id);
+	uint32_t key = getFontKey(font);
+
+	// There may be a manifest for each set of sounds using the folder
+	if (strlen(font->folder))
+		snprintf(manifest_file, sizeof(manifest_file), "%s\\%08lX%s", font->folder,
+				 (unsigned long) key, PBS_MANIFEST_EXT);
+	else
+		snprintf(manifest_file, sizeof(manifest_file), "%08lX%s", (unsigned long) key,
+				 PBS_MANIFEST_EXT);
+
+	// It may be already loaded, or copied from a profile with the same font
+	if (!valid() || header.key != key)
+	{
+		if (!read() || header.key != key)
+		{
+			build(font);
+			header.key = key;
+
+			if (!save())
+				debugMsg(DebugWarning, "Error writing font manifest %s", manifest_file);
+		}
+	}
+
+	// Sounds without any file are not present. Sounds that didn't fit in the manifest are
+	// still played, parsing the files when needed.
+	for (uint32_t i = 0; i < fontMax; i++)
+	{
+		bool found = false;
+
+		for (uint32_t j = 0; j < header.count[i]; j++)
+		{
+			if (entries[header.first[i] + j].track.channels)
+				found = true;
+		}
+
+		if (font->files[i].present && header.count[i] && !found)
+		{
+			debugMsg(DebugWarning, "No files for sound %s in font%lu", font->files[i].filename,
+					 font->id);
+			font->files[i].present = false;
+		}
+	}
+
+	return true;
+}
+
+bool PBSManifest::read()
+{
+	FIL file;
+	UINT count;
+	uint32_t crc;
+	bool ret = false;
+
+	if (f_open(&file, manifest_file, FA_READ) != FR_OK)
+		return false;
+
+	if (f_read(&file, &header, sizeof(fontManifestHeader), &count) == FR_OK &&
+		count == sizeof(fontManifestHeader) &&
+		header.magic == PBS_MANIFEST_MAGIC &&
+		header.version == PBS_MANIFEST_VERSION &&
+		header.entry_count <= PBS_MANIFEST_MAX_FILES)
+	{
+		uint32_t size = header.entry_count * sizeof(fontManifestEntry);
+
+		if (f_read(&file, entries, size, &count) == FR_OK && count == size &&
+			f_read(&file, &crc, sizeof(uint32_t), &count) == FR_OK && count == sizeof(uint32_t))
+		{
+			uint32_t check = PBSConfig::crc32(0, &header, sizeof(fontManifestHeader));
+			ret = crc == PBSConfig::crc32(check, entries, size);
+		}
+	}
+
+	f_close(&file);
+
+	if (!ret)
+		memset(&header, 0, sizeof(fontManifestHeader));
+
+	return ret;
+}
+
+bool PBSManifest::save()
+{
+	FIL file;
+	UINT count;
+	uint32_t size = header.entry_count * sizeof(fontManifestEntry);
+	uint32_t crc = PBSConfig::crc32(0, &header, sizeof(fontManifestHeader));
+	bool ret;
+
+	crc = PBSConfig::crc32(crc, entries, size);
+
+	if (f_open(&file, manifest_file, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+		return false;
+
+	ret = f_write(&file, &header, sizeof(fontManifestHeader), &count) == FR_OK &&
+		  count == sizeof(fontManifestHeader) &&
+		  f_write(&file, entries, size, &count) == FR_OK && count == size &&
+		  f_write(&file, &crc, sizeof(uint32_t), &count) == FR_OK && count == sizeof(uint32_t);
+
+	f_close(&file);
+
+	if (!ret)
+		f_unlink(manifest_file);
+
+	return ret;
+}
+
+void PBSManifest::invalidate()
+{
+	// A file didn't match its entry. It is built again on next load.
+	if (valid())
+	{
+		debugMsg(DebugWarning, "Font manifest %s is outdated", manifest_file);
+		f_unlink(manifest_file);
+	}
+
+	memset(&header, 0, sizeof(fontManifestHeader));
+}
+
+void PBSManifest::build(fontInfo* font)
+{
+	char path[MAX_FONT_NAME_LEN * 2 + 16];
+
+	memset(&header, 0, sizeof(fontManifestHeader));
+	memset(entries, 0, sizeof(entries));
+
+	uint32_t start = GetTickCount();
+	debugMsg(DebugInfo, "Building font manifest %s", manifest_file);
+
+	for (uint32_t i = 0; i < fontMax; i++)
+	{
+		fontSoundFile* file = &font->files[i];
+		uint32_t min = 0;
+		uint32_t count = 1;
+
+		if (!file->present)
+			continue;
+
+		if (file->random)
+		{
+			min = file->min;
+			count = (file->max >= file->min) ? file->max - file->min + 1 : 1;
+		}
+
+		if (header.entry_count + count > PBS_MANIFEST_MAX_FILES || min > UINT16_MAX)
+		{
+			debugMsg(DebugWarning, "Too many files in font%lu, %s not in manifest", font->id,
+					 file->filename);
+			continue;
+		}
+
+		header.first[i] = (uint8_t) header.entry_count;
+		header.count[i] = (uint8_t) count;
+		header.min[i] = (uint16_t) min;
+		header.entry_count += count;
+	}
+
+	// Packed fonts take the entries from the index of the pack, or from the loose files if
+	// it can't be read
+	if (PBSConfig::getPackPath(font, path, sizeof(path)))
+	{
+		header.packed = readPack(font, path);
+
+		if (!header.packed)
+		{
+			debugMsg(DebugWarning, "Using the sound files of font%lu", font->id);
+			memset(entries, 0, sizeof(entries));
+			readFiles(font);
+		}
+	} else {
+		readFiles(font);
+	}
+
+	header.magic = PBS_MANIFEST_MAGIC;
+	header.version = PBS_MANIFEST_VERSION;
+
+	debugMsg(DebugInfo, "Font manifest built in %lu ms (%lu files)", GetTickCount() - start,
+			 header.entry_count);
+}
+
+void PBSManifest::readFiles(fontInfo* font)
+{
+	char path[MAX_FONT_NAME_LEN * 2 + 16];
+
+	for (uint32_t i = 0; i < fontMax; i++)
+	{
+		fontSoundFile* file = &font->files[i];
+
+		// Sounds played in a loop get the loop region of their smpl chunk
+		bool loops = i == fontHum || i == fontLock || i == fontBackground;
+
+		for (uint32_t j = 0; j < header.count[i]; j++)
+		{
+			fontManifestEntry* entry = &entries[header.first[i] + j];
+
+			if (strlen(font->folder))
+				snprintf(path, sizeof(path), "%s\\%s", font->folder, file->filename);
+			else
+				snprintf(path, sizeof(path), "%s", file->filename);
+
+			if (file->random)
+				snprintf(path + strlen(path), sizeof(path) - strlen(path), "%lu",
+						 (unsigned long) (header.min[i] + j));
+
+			strncat(path, ".wav", sizeof(path) - strlen(path) - 1);
+
+			if (!readWavInfo(path, entry, loops))
+				debugMsg(DebugWarning, "Missing or unsupported sound file %s", path);
+		}
+	}
+}
+
+static bool packedFormatSupported(const fontPackEntry* packed)
+{
+	if (packed->format == PBS_PACK_PCM16)
+		return true;
+
+	return packed->format == PBS_PACK_IMA_ADPCM &&
+		   PBSAdpcm::supported(packed->block_align, (uint8_t) packed->channels);
+}
+
+bool PBSManifest::readPack(fontInfo* font, const char* path)
+{
+	PBSPack pack;
+	fontPackEntry packed;
+
+	if (!pack.open(path))
+		return false;
+
+	// An index entry may be used by more than one sound (like a swing used as the smooth
+	// swing pair), so it is matched against all of them
+	while (pack.next(&packed))
+	{
+		if (!packed.channels || !packed.sample_rate || !packedFormatSupported(&packed))
+			continue;
+
+		for (uint32_t i = 0; i < fontMax; i++)
+		{
+			fontSoundFile* file = &font->files[i];
+			uint32_t len = strlen(file->filename);
+			uint32_t num = 0;
+
+			if (!header.count[i] || strncasecmp(packed.name, file->filename, len) != 0)
+				continue;
+
+			if (file->random)
+			{
+				char* end;
+				const char* digits = packed.name + len;
+
+				if (*digits < '0' || *digits > '9')
+					continue;
+
+				num = strtoul(digits, &end, 10);
+				if (*end || num < header.min[i] || num - header.min[i] >= header.count[i])
+					continue;
+
+				num -= header.min[i];
+			} else if (packed.name[len])
+				continue;
+
+			fontManifestEntry* entry = &entries[header.first[i] + num];
+			entry->track.data_offset = packed.data_offset;
+			entry->track.data_size = packed.data_size;
+			entry->track.sample_rate = packed.sample_rate;
+			entry->track.channels = (uint8_t) packed.channels;
+			entry->track.block_align = packed.block_align;
+			entry->track.format = packed.format == PBS_PACK_IMA_ADPCM ?
+				AudioFormatImaAdpcm : AudioFormatPcm16;
+			entry->track.loop_start = packed.loop_start;
+			entry->track.loop_end = packed.loop_end;
+			PBSPlayer::checkLoop(&entry->track);
+			entry->duration = getDuration(&entry->track);
+		}
+	}
+
+	if (!pack.complete())
+	{
+		debugMsg(DebugError, "Error reading the index of font pack %s", path);
+		return false;
+	}
+
+	return true;
+}
+
+uint32_t PBSManifest::getDuration(const AudioTrackInfo* track)
+{
+	return (uint32_t) ((uint64_t) PBSPlayer::countFrames(track) * 1000 / track->sample_rate);
+}
+
+bool PBSManifest::readWavInfo(const char* path, fontManifestEntry* entry, bool loops)
+{
+	FIL file;
+
+	memset(entry, 0, sizeof(fontManifestEntry));
+
+	if (f_open(&file, path, FA_READ) != FR_OK)
+		return false;
+
+	bool ret = PBSPlayer::readHeader(&file, &entry->track, loops);
+	f_close(&file);
+
+	if (ret)
+		entry->duration = getDuration(&entry->track);
+
+	return ret;
+}
+
+const fontManifestEntry* PBSManifest::getEntry(fontSoundType type, uint32_t num)
+{
+	if (!valid() || !header.count[type] || num < header.min[type])
+		return NULL;
+
+	num -= header.min[type];
+	if (num >= header.count[type])
+		return NULL;
+
+	const fontManifestEntry* entry = &entries[header.first[type] + num];
+	return entry->track.channels ? entry : NULL;
+}
+
+bool PBSManifest::pickRandom(fontSoundType type, uint32_t* num)
+{
+	uint32_t count = header.count[type];
+
+	if (!valid() || !count)
+		return false;
+
+	// Pick one, and if the file is missing take the next one that exists
+	uint32_t index = getRandom(0, count - 1);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t n = (index + i) % count;
+
+		if (entries[header.first[type] + n].track.channels)
+		{
+			*num = header.min[type] + n;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,93 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSManifest.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSMANIFEST_H__
+#define __PBSMANIFEST_H__
+
+#include <Arduino.h>
+#include "PBSAudio.h"
+#include "PBSConfig.h"
+
+// Manifest of the sound files of a font, stored in the font folder. For packed fonts it's
+// built from the index of the pack, and data offsets are in the pack.
+#define PBS_MANIFEST_MAGIC		0x4D534250		// "PBSM"
+#define PBS_MANIFEST_VERSION	7
+#define PBS_MANIFEST_EXT		".pbm"
+#define PBS_MANIFEST_MAX_FILES	96
+
+// A sound file of the font. Missing or unsupported files have track.channels = 0.
+// track.data is always NULL here, the sample cache has its own copy of the entry.
+typedef struct
+{
+	AudioTrackInfo track;
+	uint32_t duration;			// ms
+} fontManifestEntry;
+
+// The manifest file is this header followed by entry_count entries and the CRC of both.
+// Entries are grouped by fontSoundType; random sounds have one entry per number, from min
+// to max.
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t key;				// Identifies the fontInfo the manifest was built for
+	uint32_t entry_count;
+	uint32_t packed;			// Entries taken from the index of the font pack
+	uint8_t first[fontMax];		// Index of the first entry of each fontSoundType
+	uint8_t count[fontMax];
+	uint16_t min[fontMax];		// Number of the first entry of random sounds
+} fontManifestHeader;
+
+class PBSManifest
+{
+public:
+	PBSManifest();
+	bool load(fontInfo* font);
+	void invalidate();
+	const fontManifestEntry* getEntry(fontSoundType type, uint32_t num);
+	bool pickRandom(fontSoundType type, uint32_t* num);
+
+	inline bool valid() { return header.magic == PBS_MANIFEST_MAGIC; }
+	inline bool indexed(fontSoundType type) { return valid() && header.count[type] != 0; }
+	inline uint32_t getKey() { return header.key; }
+	inline bool packed() { return valid() && header.packed; }
+
+	static uint32_t getFontKey(fontInfo* font);
+
+private:
+	void build(fontInfo* font);
+	bool read();
+	bool save();
+	void readFiles(fontInfo* font);
+	bool readPack(fontInfo* font, const char* path);
+	bool readWavInfo(const char* path, fontManifestEntry* entry, bool loops);
+	static uint32_t getDuration(const AudioTrackInfo* track);
+
+	fontManifestHeader header;
+	fontManifestEntry entries[PBS_MANIFEST_MAX_FILES];
+	char manifest_file[MAX_FONT_NAME_LEN + 16];
+};
+
+#endif /* __PBSMANIFEST_H__ */
@@ -0,0 +1,320 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSMixer.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSMixer.h"
+#include <math.h>
+
+PBSMixer::PBSMixer() : count(0), gain(1.0f), limiter(NULL)
+{
+	memset(players, 0, sizeof(players));
+	memset(buffer_used, 0, sizeof(buffer_used));
+	memset(&stats, 0, sizeof(mixerStats));
+	memset(stream_stats, 0, sizeof(stream_stats));
+}
+
+bool PBSMixer::begin()
+{
+	if (!Audio.initialized())
+		return false;
+
+	start();
+	return true;
+}
+
+bool PBSMixer::add(PBSPlayer* player)
+{
+	if (count == PBS_MIXER_PLAYERS)
+		return false;
+
+	player->mixer = this;
+	players[count++] = player;
+	return true;
+}
+
+void PBSMixer::setVolume(float db)
+{
+	gain = powf(10.0f, db / 20.0f);
+}
+
+bool PBSMixer::beginLimiter(float ceiling, uint32_t lookahead, uint32_t release)
+{
+	if (!Audio.initialized())
+		return false;
+
+	// Ready before the interrupt sees it
+	PBSLimiter* next = limiter ? limiter : new PBSLimiter();
+	next->begin(getSampleRate(), ceiling, lookahead, release);
+	limiter = next;
+	return true;
+}
+
+void PBSMixer::resetStats()
+{
+	memset(&stats, 0, sizeof(mixerStats));
+	memset(stream_stats, 0, sizeof(stream_stats));
+
+	if (limiter)
+		limiter->resetStats();
+}
+
+uint8_t* PBSMixer::takeBuffer()
+{
+	for (uint32_t i = 0; i < PBS_STREAMS; i++)
+	{
+		if (!buffer_used[i])
+		{
+			buffer_used[i] = true;
+			return (uint8_t*) buffers[i];
+		}
+	}
+
+	return NULL;
+}
+
+void PBSMixer::releaseBuffer(uint8_t* buffer)
+{
+	for (uint32_t i = 0; i < PBS_STREAMS; i++)
+	{
+		if ((uint8_t*) buffers[i] == buffer)
+			buffer_used[i] = false;
+	}
+}
+
+void PBSMixer::fill(playerTrack* trk, uint32_t size)
+{
+	// Reads up to 'size' bytes into the ring, as much as there is room for, in whole
+	// sectors. Looped files go on from their start. What is in the sample cache is copied,
+	// and the file is opened when the first byte that isn't is needed.
+	uint32_t room = PBS_STREAM_BUFFER - (trk->written - trk->consumed);
+	uint32_t read = 0;
+
+	if (size > room)
+		size = room;
+
+	size &= ~(PBS_STREAM_SECTOR - 1);
+
+	while (read < size)
+	{
+		UINT br = 0;
+		uint32_t offset = trk->written & (PBS_STREAM_BUFFER - 1);
+		uint32_t chunk = size - read;
+
+		if (trk->fetch >= trk->fetch_end)
+		{
+			if (!trk->loop)
+				break;
+
+			trk->fetch = trk->fetch_loop;
+		}
+
+		if (chunk > trk->fetch_end - trk->fetch)
+			chunk = trk->fetch_end - trk->fetch;
+		if (chunk > PBS_STREAM_BUFFER - offset)
+			chunk = PBS_STREAM_BUFFER - offset;
+
+		if (trk->fetch < trk->cached)
+		{
+			if (chunk > trk->cached - trk->fetch)
+				chunk = trk->cached - trk->fetch;
+
+			memcpy(trk->ring + offset, trk->cache + trk->fetch, chunk);
+			br = chunk;
+		} else
+		{
+			if (!trk->file_open)
+				trk->file_open = f_open(&trk->file, trk->filename, FA_READ) == FR_OK;
+
+			// Reads that go on from the last one don't seek
+			if (trk->file_open && f_tell(&trk->file) != trk->data_offset + trk->fetch)
+				f_lseek(&trk->file, trk->data_offset + trk->fetch);
+
+			if (!trk->file_open || f_read(&trk->file, trk->ring + offset, chunk, &br) != FR_OK ||
+				!br)
+			{
+				// Nothing more can be read, the sound ends with what there is
+				trk->loop = false;
+				trk->data_size = trk->fetch_end = trk->fetch;
+				break;
+			}
+
+			stream_stats[trk->priority].reads++;
+			stream_stats[trk->priority].bytes += br;
+		}
+
+		trk->fetch += br;
+		trk->written += br;
+		read += br;
+	}
+}
+
+bool PBSMixer::needsRefill(playerTrack* trk)
+{
+	if (!trk->loop && trk->fetch >= trk->fetch_end)
+		return false;
+
+	return PBS_STREAM_BUFFER - (trk->written - trk->consumed) >= PBS_STREAM_BUFFER / 2;
+}
+
+playerTrack* PBSMixer::nextStream()
+{
+	// Streams that run dry in less than two audio blocks go first
+	uint32_t sample_rate = getSampleRate();
+	uint32_t urgent_us = sample_rate ?
+		(uint32_t) (((uint64_t) AUDIO_BLOCK_SAMPLES * 2 * 1000000) / sample_rate) : 0;
+	playerTrack* next = NULL;
+	uint32_t next_rank = 0;
+	uint32_t next_left = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		playerTrack* trk;
+
+		for (uint32_t t = 0; (trk = players[i]->getTrack(t)) != NULL; t++)
+		{
+			if (!trk->open || trk->ended || !trk->waiting)
+				continue;
+
+			// Time left before the ring runs dry. IMA-ADPCM holds about 2 frames a byte
+			// per channel.
+			uint32_t buffered = trk->written - trk->consumed;
+			uint32_t frames = trk->format == AudioFormatImaAdpcm ?
+							  buffered * 2 / trk->channels : buffered / (trk->channels * 2);
+			uint32_t left = (uint32_t) (((uint64_t) frames * 1000000) / trk->sample_rate);
+			uint32_t rank = left < urgent_us ? 0 : 1 + trk->priority;
+
+			if (!next || rank < next_rank || (rank == next_rank && left < next_left))
+			{
+				next = trk;
+				next_rank = rank;
+				next_left = left;
+			}
+		}
+	}
+
+	return next;
+}
+
+void PBSMixer::service()
+{
+	uint32_t now = micros();
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		PBSPlayer* player = players[i];
+		playerTrack* trk;
+
+		for (uint32_t t = 0; (trk = player->getTrack(t)) != NULL; t++)
+		{
+			if (!trk->open)
+				continue;
+
+			// The interrupt can't close the files that ended
+			if (trk->ended)
+			{
+				player->closeTrack(trk);
+				continue;
+			}
+
+			if (!trk->waiting && needsRefill(trk))
+			{
+				trk->waiting = true;
+				trk->wait_us = now;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < PBS_STREAM_REFILLS; i++)
+	{
+		playerTrack* trk = nextStream();
+		if (!trk)
+			break;
+
+		fill(trk, PBS_STREAM_READ);
+
+		streamStats* stream = &stream_stats[trk->priority];
+		uint32_t wait = micros() - trk->wait_us;
+
+		if (wait > stream->max_wait_us)
+			stream->max_wait_us = wait;
+
+		trk->waiting = false;
+	}
+}
+
+uint32_t PBSMixer::render(int16_t* buffer, uint32_t samples)
+{
+	int32_t mix[AUDIO_BLOCK_SAMPLES];
+	uint32_t rendered = 0;
+
+	if (samples > AUDIO_BLOCK_SAMPLES)
+		samples = AUDIO_BLOCK_SAMPLES;
+
+	memset(mix, 0, samples * sizeof(int32_t));
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (players[i]->active)
+		{
+			players[i]->mix(mix, samples);
+			rendered++;
+		}
+	}
+
+	if (gain != 1.0f)
+	{
+		for (uint32_t i = 0; i < samples; i++)
+			mix[i] = (int32_t) (mix[i] * gain);
+	}
+
+	if (limiter)
+	{
+		limiter->process(mix, buffer, samples);
+	} else {
+		for (uint32_t i = 0; i < samples; i++)
+		{
+			int32_t sample = mix[i];
+
+			if (sample > 32767)
+			{
+				sample = 32767;
+				stats.clipped++;
+			} else if (sample < -32768)
+			{
+				sample = -32768;
+				stats.clipped++;
+			}
+
+			buffer[i] = (int16_t) sample;
+		}
+	}
+
+	stats.blocks++;
+	stats.player_blocks += rendered;
+	if (rendered > stats.peak_players)
+		stats.peak_players = rendered;
+
+	// Never less than asked for, the mixer stays attached
+	return samples;
+}
@@ -0,0 +1,125 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSMixer.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSMIXER_H__
+#define __PBSMIXER_H__
+
+#include <Arduino.h>
+#include "PBSPlayer.h"
+#include "PBSLimiter.h"
+
+// Players mixed, at most
+#define PBS_MIXER_PLAYERS		16
+
+// Ring buffers for the files being played, taken when a file is opened. A ring holds
+// ~93 ms of a mono sound at 22050 Hz, and is refilled by service() when half empty, with
+// reads of whole sectors.
+#ifndef PBS_STREAMS
+#define PBS_STREAMS				10
+#endif
+#define PBS_STREAM_BUFFER		4096		// Power of two
+#define PBS_STREAM_SECTOR		512
+#define PBS_STREAM_READ			2048
+
+// Refills done by each service() call, at most, so loop() isn't held up for long
+#define PBS_STREAM_REFILLS		4
+
+typedef struct
+{
+	uint32_t blocks;
+	uint32_t player_blocks;		// Blocks rendered by each player, added up
+	uint32_t peak_players;
+	uint32_t clipped;			// Samples over full scale, without the limiter
+} mixerStats;
+
+typedef struct
+{
+	uint32_t reads;
+	uint64_t bytes;
+	uint32_t underruns;			// Audio blocks rendered with missing data
+	uint32_t onsets;			// Sounds started from the SD
+	uint32_t max_onset_us;		// Longest wait for the first data of a sound
+	uint32_t max_wait_us;		// Longest wait for a refill
+} streamStats;
+
+// The single source the sketch attaches to the PropBoard audio engine. It renders and mixes
+// its players from the audio interrupt, out of RAM only. The SD is read from loop(), by
+// service(), and by the players when a file is opened.
+class PBSMixer : public AudioSource
+{
+public:
+	PBSMixer();
+
+	// After Audio.begin()
+	bool begin();
+	bool add(PBSPlayer* player);
+
+	// Refills the ring buffers and closes the files that ended. Called from loop(), and
+	// while waiting for a sound to end. Streams that run dry in less than two audio blocks
+	// are refilled first, earliest first, then the rest by priority and deadline.
+	void service();
+
+	// Master volume in dB, applied to the mix ahead of the limiter
+	void setVolume(float db);
+
+	// Passes the mix through a look-ahead limiter, allocated the first time. Called while
+	// the output is muted, as the output is delayed by the look-ahead from then on.
+	bool beginLimiter(float ceiling, uint32_t lookahead, uint32_t release);
+	inline PBSLimiter* getLimiter() { return limiter; }
+
+	// Delay added to the audio output, by the limiter
+	inline uint32_t getDelayUs() { return limiter ? limiter->getDelayUs() : 0; }
+
+	inline uint32_t getSampleRate() { return Audio.getSampleRate(); }
+	inline const mixerStats* getStats() { return &stats; }
+	inline const streamStats* getStreamStats(streamPriority priority)
+	{
+		return &stream_stats[priority];
+	}
+	void resetStats();
+
+protected:
+	friend class PBSPlayer;
+
+	uint32_t render(int16_t* buffer, uint32_t samples);
+	uint8_t* takeBuffer();
+	void releaseBuffer(uint8_t* buffer);
+	void fill(playerTrack* trk, uint32_t size);
+
+private:
+	bool needsRefill(playerTrack* trk);
+	playerTrack* nextStream();
+
+	PBSPlayer* players[PBS_MIXER_PLAYERS];
+	uint32_t count;
+	int16_t buffers[PBS_STREAMS][PBS_STREAM_BUFFER / 2];
+	bool buffer_used[PBS_STREAMS];
+	float gain;
+	PBSLimiter* limiter;
+	mixerStats stats;
+	streamStats stream_stats[streamPriorityMax];
+};
+
+#endif /* __PBSMIXER_H__ */
@@ -0,0 +1,130 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSPack.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSPack.h"
+#include "PBSConfig.h"
+
+PBSPack::PBSPack()
+{
+	is_open = false;
+	index_ok = false;
+	memset(&header, 0, sizeof(fontPackHeader));
+	index = crc = file_size = buffered = position = 0;
+}
+
+PBSPack::~PBSPack()
+{
+	close();
+}
+
+bool PBSPack::open(const char* path)
+{
+	UINT count;
+
+	close();
+
+	if (f_open(&file, path, FA_READ) != FR_OK)
+		return false;
+
+	is_open = true;
+	file_size = f_size(&file);
+
+	if (f_read(&file, &header, sizeof(fontPackHeader), &count) != FR_OK ||
+		count != sizeof(fontPackHeader) ||
+		header.magic != PBS_PACK_MAGIC ||
+		header.version != PBS_PACK_VERSION ||
+		sizeof(fontPackHeader) + header.entry_count * sizeof(fontPackEntry) > file_size)
+	{
+		debugMsg(DebugError, "%s is not a valid font pack", path);
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void PBSPack::close()
+{
+	if (is_open)
+		f_close(&file);
+
+	is_open = false;
+	index_ok = false;
+	index = crc = buffered = position = 0;
+}
+
+bool PBSPack::fill()
+{
+	// The index is read a sector at a time
+	uint32_t left = header.entry_count - index;
+	uint32_t size;
+	UINT count;
+
+	if (left > sizeof(buffer) / sizeof(fontPackEntry))
+		left = sizeof(buffer) / sizeof(fontPackEntry);
+
+	size = left * sizeof(fontPackEntry);
+	if (f_read(&file, buffer, size, &count) != FR_OK || count != size)
+		return false;
+
+	crc = PBSConfig::crc32(crc, buffer, size);
+	buffered = left;
+	position = 0;
+	return true;
+}
+
+bool PBSPack::next(fontPackEntry* entry)
+{
+	if (!is_open)
+		return false;
+
+	if (position == buffered)
+	{
+		if (index == header.entry_count)
+		{
+			index_ok = crc == header.index_crc;
+			return false;
+		}
+
+		if (!fill())
+			return false;
+	}
+
+	memcpy(entry, &buffer[position++], sizeof(fontPackEntry));
+	entry->name[PBS_PACK_NAME_LEN - 1] = 0;
+	index++;
+
+	// Entries pointing out of the file are dropped
+	if (entry->data_offset > file_size || entry->data_size > file_size - entry->data_offset)
+		entry->channels = 0;
+
+	return true;
+}
+
+bool PBSPack::check(const char* path)
+{
+	PBSPack pack;
+	return pack.open(path);
+}
@@ -0,0 +1,102 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSPack.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSPACK_H__
+#define __PBSPACK_H__
+
+#include <Arduino.h>
+
+// Font pack: all the sound files of a font in a single file, built on a computer with
+// host/pbspack. The file is this header followed by entry_count index entries. The audio
+// data of each entry starts at an SD sector boundary and is stored contiguously, so
+// streaming a sound is a run of sequential sector reads.
+#define PBS_PACK_MAGIC			0x46534250		// "PBSF"
+#define PBS_PACK_VERSION		3
+#define PBS_PACK_EXT			".pbf"
+#define PBS_PACK_ALIGN			512
+#define PBS_PACK_NAME_LEN		44
+
+// Formats of the audio data
+#define PBS_PACK_PCM16			1
+#define PBS_PACK_IMA_ADPCM		2
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t index_crc;			// CRC32 of the index entries
+} fontPackHeader;
+
+// A sound file. The name is its path inside the font folder, without extension and with
+// '\' as separator (like "swing3" or "swng\swng3").
+typedef struct
+{
+	char name[PBS_PACK_NAME_LEN];
+	uint32_t data_offset;		// From the start of the pack, multiple of PBS_PACK_ALIGN
+	uint32_t data_size;
+	uint32_t sample_rate;
+	uint16_t channels;
+	uint16_t format;
+	uint16_t block_align;		// Of IMA-ADPCM data
+	uint16_t reserved;
+	uint32_t loop_start;		// Loop region of the smpl chunk, in frames, loop_end past
+	uint32_t loop_end;			// its last frame. 0 if the file has none.
+} fontPackEntry;
+
+// Reads the index of a font pack, one entry after another
+class PBSPack
+{
+public:
+	PBSPack();
+	~PBSPack();
+	bool open(const char* path);
+	void close();
+
+	// Returns false after the last entry. complete() tells then if the whole index was
+	// read and its CRC matches.
+	bool next(fontPackEntry* entry);
+	inline bool complete() { return index_ok; }
+
+	inline uint32_t getCount() { return header.entry_count; }
+
+	static bool check(const char* path);
+
+private:
+	bool fill();
+
+	FIL file;
+	bool is_open;
+	bool index_ok;
+	fontPackHeader header;
+	uint32_t index;
+	uint32_t crc;
+	uint32_t file_size;
+	fontPackEntry buffer[PBS_PACK_ALIGN / sizeof(fontPackEntry)];
+	uint32_t buffered;
+	uint32_t position;
+};
+
+#endif /* __PBSPACK_H__ */
@@ -0,0 +1,950 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSPlayer.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSPlayer.h"
+#include "PBSMixer.h"
+#include <math.h>
+
+static uint32_t readLE32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t readLE16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+PBSPlayer::PBSPlayer() : mixer(NULL), active(false), volume(1.0f), priority(streamEffect),
+	underruns(0), pitch(1.0f), pitched(false),
+	start_callback(NULL), start_arg(NULL), filter(NULL), filter_pending(false),
+	filter_type(BiquadOff), filter_freq(0), filter_q(0), filter_samples(0), ramp_from(0), ramp_to(0), ramp_length(0),
+	ramp_left(0), ramp_curve(volumeLinear)
+{
+	memset(&track, 0, sizeof(playerTrack));
+}
+
+PBSPlayer::~PBSPlayer()
+{
+	active = false;
+	closeTrack(&track);
+	delete track.resampler;
+	delete[] track.loop_head;
+	delete filter;
+}
+
+void PBSPlayer::readLoop(FIL* file, uint32_t chunk_size, AudioTrackInfo* info)
+{
+	// Reads the smpl chunk at the file pointer. The first loop is taken if it's a forward
+	// one; loop_end is kept past the last frame of the loop.
+	uint8_t buffer[36];
+	UINT count;
+
+	if (chunk_size < 36 + 24 ||
+		f_read(file, buffer, 36, &count) != FR_OK || count != 36 ||
+		!readLE32(buffer + 28) ||
+		f_read(file, buffer, 24, &count) != FR_OK || count != 24 ||
+		readLE32(buffer + 4) != 0)
+		return;
+
+	info->loop_start = readLE32(buffer + 8);
+	info->loop_end = readLE32(buffer + 12) + 1;
+}
+
+bool PBSPlayer::readHeader(FIL* file, AudioTrackInfo* info, bool loops)
+{
+	uint8_t buffer[16];
+	UINT count;
+	uint32_t offset = 12;
+	bool fmt_found = false;
+	bool ret = false;
+
+	// Loop regions are only of use to players that loop on them. The smpl chunk may be
+	// before or after the audio data, so then every chunk is walked.
+	bool loop_found = !loops;
+
+	memset(info, 0, sizeof(AudioTrackInfo));
+
+	if (f_lseek(file, 0) != FR_OK ||
+		f_read(file, buffer, 12, &count) != FR_OK || count != 12 ||
+		memcmp(buffer, "RIFF", 4) != 0 || memcmp(buffer + 8, "WAVE", 4) != 0)
+		return false;
+
+	// Walk the chunks up to the data chunk, and the smpl chunk if needed. 16-bit PCM and
+	// IMA-ADPCM are supported.
+	while (f_read(file, buffer, 8, &count) == FR_OK && count == 8)
+	{
+		uint32_t chunk_size = readLE32(buffer + 4);
+		offset += 8;
+
+		if (memcmp(buffer, "fmt ", 4) == 0)
+		{
+			if (f_read(file, buffer, 16, &count) != FR_OK || count != 16)
+				break;
+
+			info->channels = (uint8_t) readLE16(buffer + 2);
+			info->sample_rate = readLE32(buffer + 4);
+			info->block_align = readLE16(buffer + 12);
+
+			if (readLE16(buffer) == 1 && readLE16(buffer + 14) == 16)
+				info->format = AudioFormatPcm16;
+			else if (readLE16(buffer) == PBS_ADPCM_FORMAT && readLE16(buffer + 14) == 4 &&
+					 PBSAdpcm::supported(info->block_align, info->channels))
+				info->format = AudioFormatImaAdpcm;
+			else
+				break;
+
+			fmt_found = info->channels && info->sample_rate;
+		} else if (memcmp(buffer, "data", 4) == 0)
+		{
+			if (!fmt_found || offset + chunk_size > f_size(file))
+				break;
+
+			info->data_offset = offset;
+			info->data_size = chunk_size;
+			ret = true;
+		} else if (loops && memcmp(buffer, "smpl", 4) == 0)
+		{
+			readLoop(file, chunk_size, info);
+			loop_found = true;
+		}
+
+		if (ret && loop_found)
+			break;
+
+		offset += chunk_size + (chunk_size & 1);
+		if (f_lseek(file, offset) != FR_OK)
+			break;
+	}
+
+	if (!ret)
+		memset(info, 0, sizeof(AudioTrackInfo));
+
+	checkLoop(info);
+	return ret;
+}
+
+uint32_t PBSPlayer::countFrames(const AudioTrackInfo* info)
+{
+	if (!info->channels)
+		return 0;
+
+	if (info->format == AudioFormatImaAdpcm)
+		return PBSAdpcm::frames(info->data_size, info->block_align, info->channels);
+
+	return info->data_size / (info->channels * 2);
+}
+
+void PBSPlayer::checkLoop(AudioTrackInfo* info)
+{
+	if (info->loop_start >= info->loop_end || info->loop_end > countFrames(info))
+		info->loop_start = info->loop_end = 0;
+}
+
+static uint32_t trackFrames(playerTrack* trk)
+{
+	if (trk->format == AudioFormatImaAdpcm)
+		return PBSAdpcm::frames(trk->data_size, trk->block_align, trk->channels);
+
+	return trk->data_size / (trk->channels * 2);
+}
+
+static uint32_t frameOffset(playerTrack* trk, uint32_t frame, uint32_t* skip)
+{
+	// Offset in the audio data of a frame. IMA-ADPCM data is decoded from the start of the
+	// block holding it, and 'skip' frames of the block are dropped.
+	if (trk->format == AudioFormatImaAdpcm)
+	{
+		uint32_t block_frames = PBSAdpcm::blockFrames(trk->block_align, trk->channels);
+
+		*skip = frame % block_frames;
+		return (frame / block_frames) * trk->block_align;
+	}
+
+	*skip = 0;
+	return frame * trk->channels * 2;
+}
+
+void PBSPlayer::beginLoop(playerTrack* trk, uint32_t start, uint32_t end)
+{
+	// Regions that don't fit in the sound, or too short to crossfade, loop the whole sound
+	uint32_t fade = trk->sample_rate * PBS_LOOP_FADE_MS / 1000;
+
+	if (fade > PBS_LOOP_FADE_MAX)
+		fade = PBS_LOOP_FADE_MAX;
+
+	if (end > start && fade > (end - start) / 2)
+		fade = (end - start) / 2;
+
+	trk->frame = 0;
+	trk->decoded_skip = 0;
+	trk->loop_end = 0;
+	trk->fetch_end = trk->data_size;
+	trk->fetch_loop = 0;
+
+	if (!trk->loop || end <= start || end > trackFrames(trk) || !fade)
+		return;
+
+	if (!trk->loop_head)
+		trk->loop_head = new int16_t[PBS_LOOP_FADE_MAX];
+
+	trk->loop_start = start;
+	trk->loop_end = end;
+	trk->loop_fade = fade;
+
+	// Reads stop with the last frame of the region, or the part of an IMA-ADPCM block
+	// holding it. They go on after the start of the region, that plays from RAM.
+	uint32_t last = end - 1;
+	uint32_t skip;
+	uint32_t offset = frameOffset(trk, last, &skip);
+
+	if (trk->format == AudioFormatImaAdpcm)
+		offset += (skip ? 1 + (skip - 1) / PBS_ADPCM_GROUP_FRAMES : 0) * trk->channels * 4 +
+				  trk->channels * 4;
+	else
+		offset += trk->channels * 2;
+
+	trk->fetch_end = offset < trk->data_size ? offset : trk->data_size;
+	trk->fetch_loop = frameOffset(trk, start + fade, &trk->loop_skip);
+}
+
+bool PBSPlayer::openTrack(playerTrack* trk, const char* filename, const AudioTrackInfo* info,
+						  bool loop, PBSPreparedTrack* prepared)
+{
+	AudioTrackInfo header;
+	uint32_t start = micros();
+
+	closeTrack(trk);
+	snprintf(trk->filename, sizeof(trk->filename), "%s", filename);
+
+	if (!mixer)
+		return false;
+
+	// Prepared tracks hand over their open file. Sounds that start in the sample cache open
+	// their file when the rest is read.
+	if (prepared)
+	{
+		trk->file = prepared->file;
+		trk->file_open = true;
+		prepared->open = false;
+		info = &prepared->info;
+	} else if (!info || !info->data_cached)
+	{
+		if (f_open(&trk->file, filename, FA_READ) != FR_OK)
+			return false;
+
+		trk->file_open = true;
+	}
+
+	trk->open = true;
+
+	if (!info)
+	{
+		if (!readHeader(&trk->file, &header, loop))
+		{
+			closeTrack(trk);
+			return false;
+		}
+
+		info = &header;
+	}
+
+	// Audio data is rendered a frame at a time, or a part of an IMA-ADPCM block at a time
+	bool adpcm = info->format == AudioFormatImaAdpcm;
+	uint32_t part = adpcm ? info->channels * 4 : info->channels * 2;
+
+	if ((!adpcm && info->format != AudioFormatPcm16) ||
+		(adpcm && !PBSAdpcm::supported(info->block_align, info->channels)) ||
+		!info->channels || info->channels > 2 || !info->sample_rate ||
+		info->data_size < part ||
+		(trk->file_open && info->data_offset + info->data_size > f_size(&trk->file)) ||
+		!(trk->ring = mixer->takeBuffer()))
+	{
+		closeTrack(trk);
+		return false;
+	}
+
+	trk->data_offset = info->data_offset;
+	trk->data_size = info->data_size - info->data_size % part;
+	trk->sample_rate = info->sample_rate;
+	trk->channels = info->channels;
+	trk->format = info->format;
+	trk->block_align = info->block_align;
+	trk->cache = prepared ? prepared->buffer : info->data;
+	trk->cached = prepared ? prepared->buffered : info->data_cached;
+	trk->loop = loop;
+	trk->ended = false;
+	trk->started = false;
+	trk->position = 0;
+	trk->fetch = 0;
+	trk->written = 0;
+	trk->consumed = 0;
+	trk->priority = trk == &track ? priority : streamEffect;
+	trk->waiting = false;
+	trk->decoded_frames = 0;
+	trk->decoded_pos = 0;
+	beginLoop(trk, info->loop_start, info->loop_end);
+
+	uint32_t out_fs = mixer->getSampleRate();
+	uint32_t frames = AUDIO_BLOCK_SAMPLES;
+
+	trk->resampling = out_fs && (trk->sample_rate != out_fs || (trk == &track && pitched));
+	if (trk->resampling)
+	{
+		if (!trk->resampler)
+			trk->resampler = new PBSResampler();
+
+		trk->resampler->begin(trk->sample_rate, out_fs);
+		if (trk == &track)
+			trk->resampler->setPitch(pitch);
+
+		frames = trk->resampler->getInputFor(AUDIO_BLOCK_SAMPLES);
+	}
+
+	// What the first audio block needs is read now, so the sound starts with the next one.
+	// What is in the sample cache is all copied, it takes no SD reads.
+	uint32_t onset = adpcm ? (frames / PBS_ADPCM_GROUP_FRAMES + 2) * part : frames * part;
+	if (onset < trk->cached)
+		onset = trk->cached;
+
+	mixer->fill(trk, (onset + PBS_STREAM_SECTOR - 1) & ~(PBS_STREAM_SECTOR - 1));
+
+	// The buffer of a prepared track is its own again, the rest comes from the file
+	if (prepared)
+	{
+		trk->cache = NULL;
+		trk->cached = 0;
+	}
+
+	streamStats* stats = &mixer->stream_stats[trk->priority];
+	uint32_t wait = micros() - start;
+
+	stats->onsets++;
+	if (wait > stats->max_onset_us)
+		stats->max_onset_us = wait;
+
+	return true;
+}
+
+void PBSPlayer::closeTrack(playerTrack* trk)
+{
+	if (trk->file_open)
+		f_close(&trk->file);
+
+	if (trk->ring)
+		mixer->releaseBuffer(trk->ring);
+
+	trk->ring = NULL;
+	trk->open = false;
+	trk->file_open = false;
+}
+
+static inline void downmix(const int16_t* frames, uint8_t channels, int16_t* buffer,
+						   uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (channels == 2)
+			buffer[i] = (int16_t) ((frames[i*2] + frames[i*2+1]) / 2);
+		else
+			buffer[i] = frames[i];
+	}
+}
+
+uint32_t PBSPlayer::readPcm(playerTrack* trk, int16_t* buffer, uint32_t samples)
+{
+	uint32_t frame_size = trk->channels * 2;
+	uint32_t produced = 0;
+
+	while (produced < samples)
+	{
+		if (trk->position + frame_size > trk->fetch_end)
+		{
+			if (!trk->loop)
+			{
+				trk->ended = true;
+				break;
+			}
+
+			trk->position = trk->fetch_loop;
+		}
+
+		// Up to the end of the data, of what was read, and of the ring
+		uint32_t ring_pos = trk->consumed & (PBS_STREAM_BUFFER - 1);
+		uint32_t count = samples - produced;
+		uint32_t left = (trk->fetch_end - trk->position) / frame_size;
+		uint32_t buffered = (trk->written - trk->consumed) / frame_size;
+		uint32_t contiguous = (PBS_STREAM_BUFFER - ring_pos) / frame_size;
+
+		if (count > left)
+			count = left;
+		if (count > buffered)
+			count = buffered;
+		if (count > contiguous)
+			count = contiguous;
+
+		if (!count)
+			break;
+
+		downmix((const int16_t*) (trk->ring + ring_pos), trk->channels, buffer + produced,
+				count);
+
+		trk->position += count * frame_size;
+		trk->consumed += count * frame_size;
+		produced += count;
+	}
+
+	return produced;
+}
+
+uint32_t PBSPlayer::decodeAdpcm(playerTrack* trk, int16_t* buffer, uint32_t samples)
+{
+	// Parts never straddle the end of the ring: the data is made of whole parts, of 4 or 8
+	// bytes, and the ring size is a multiple of both.
+	uint32_t part_size = trk->channels * 4;
+	uint32_t produced = 0;
+
+	while (produced < samples)
+	{
+		if (trk->decoded_pos == trk->decoded_frames)
+		{
+			if (trk->position + part_size > trk->fetch_end)
+			{
+				if (!trk->loop)
+				{
+					trk->ended = true;
+					break;
+				}
+
+				trk->position = trk->fetch_loop;
+			}
+
+			if (trk->written - trk->consumed < part_size)
+				break;
+
+			const uint8_t* part = trk->ring + (trk->consumed & (PBS_STREAM_BUFFER - 1));
+
+			if (trk->position % trk->block_align == 0)
+				trk->decoded_frames = (uint8_t) PBSAdpcm::decodeHeader(part, trk->channels,
+																	   &trk->adpcm, trk->decoded);
+			else
+				trk->decoded_frames = (uint8_t) PBSAdpcm::decodeGroup(part, trk->channels,
+																	  &trk->adpcm, trk->decoded);
+
+			trk->decoded_pos = 0;
+			trk->position += part_size;
+			trk->consumed += part_size;
+
+			// Frames of the block the loop region goes on from, before the frame it needs
+			if (trk->decoded_skip)
+			{
+				uint32_t drop = trk->decoded_skip < trk->decoded_frames ? trk->decoded_skip :
+								trk->decoded_frames;
+
+				trk->decoded_pos = (uint8_t) drop;
+				trk->decoded_skip -= drop;
+			}
+		}
+
+		uint32_t count = samples - produced;
+		if (count > (uint32_t) (trk->decoded_frames - trk->decoded_pos))
+			count = trk->decoded_frames - trk->decoded_pos;
+
+		downmix(trk->decoded + trk->decoded_pos * trk->channels, trk->channels,
+				buffer + produced, count);
+
+		trk->decoded_pos += count;
+		produced += count;
+	}
+
+	return produced;
+}
+
+uint32_t PBSPlayer::renderData(playerTrack* trk, int16_t* buffer, uint32_t samples)
+{
+	if (trk->format == AudioFormatImaAdpcm)
+		return decodeAdpcm(trk, buffer, samples);
+
+	return readPcm(trk, buffer, samples);
+}
+
+static void loopFrames(playerTrack* trk, int16_t* buffer, uint32_t count)
+{
+	// Keeps the start of the loop region as it plays, and fades the end of the region into
+	// it. Linear, as both sides are the same sound.
+	uint32_t head_end = trk->loop_start + trk->loop_fade;
+	uint32_t fade_start = trk->loop_end - trk->loop_fade;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t frame = trk->frame + i;
+
+		if (frame >= trk->loop_start && frame < head_end)
+		{
+			trk->loop_head[frame - trk->loop_start] = buffer[i];
+		} else if (frame >= fade_start)
+		{
+			uint32_t pos = frame - fade_start;
+			int32_t gain = (int32_t) (((pos + 1) << 15) / (trk->loop_fade + 1));
+
+			buffer[i] = (int16_t) ((buffer[i] * (32768 - gain) + trk->loop_head[pos] * gain) >>
+								   15);
+		}
+	}
+}
+
+uint32_t PBSPlayer::renderFrames(playerTrack* trk, int16_t* buffer, uint32_t samples)
+{
+	// Renders at the sample rate of the sound
+	uint32_t produced = 0;
+
+	if (!trk->loop || !trk->loop_end)
+		return renderData(trk, buffer, samples);
+
+	while (produced < samples)
+	{
+		if (trk->frame == trk->loop_end)
+		{
+			// The start of the region was faded in, the sound goes on after it. The rest of
+			// the last part decoded is dropped; the reads did the same.
+			trk->frame = trk->loop_start + trk->loop_fade;
+			trk->position = trk->fetch_loop;
+			trk->decoded_skip = trk->loop_skip;
+			trk->decoded_frames = trk->decoded_pos = 0;
+		}
+
+		uint32_t count = samples - produced;
+		if (count > trk->loop_end - trk->frame)
+			count = trk->loop_end - trk->frame;
+
+		uint32_t rendered = renderData(trk, buffer + produced, count);
+
+		loopFrames(trk, buffer + produced, rendered);
+		trk->frame += rendered;
+		produced += rendered;
+
+		if (rendered < count)
+			break;
+	}
+
+	return produced;
+}
+
+uint32_t PBSPlayer::resample(playerTrack* trk, int16_t* buffer, uint32_t samples)
+{
+	// The resampler takes the input it needs, a chunk at a time. It stops short when the
+	// sound ends or the ring runs dry; what is left in the filter goes out next time.
+	PBSResampler* resampler = trk->resampler;
+	uint32_t produced = resampler->read(buffer, samples);
+
+	while (produced < samples)
+	{
+		uint32_t space = resampler->getSpace();
+		uint32_t count = renderFrames(trk, resampler->getInput(), space);
+
+		resampler->commit(count);
+		produced += resampler->read(buffer + produced, samples - produced);
+
+		if (count < space)
+			break;
+	}
+
+	return produced;
+}
+
+uint32_t PBSPlayer::renderTrack(playerTrack* trk, int16_t* buffer, uint32_t samples)
+{
+	uint32_t produced;
+
+	if (!trk->open || trk->ended)
+		return 0;
+
+	if (trk->resampling)
+		produced = resample(trk, buffer, samples);
+	else
+		produced = renderFrames(trk, buffer, samples);
+
+	if (produced && !trk->started)
+	{
+		trk->started = true;
+
+		if (start_callback)
+			start_callback(this, start_arg);
+	}
+
+	if (produced < samples && !trk->ended)
+	{
+		// The SD didn't keep up. Silence until there's data again.
+		memset(buffer + produced, 0, (samples - produced) * sizeof(int16_t));
+		mixer->stream_stats[trk->priority].underruns++;
+		underruns++;
+		return samples;
+	}
+
+	return produced;
+}
+
+uint32_t PBSPlayer::trackDuration(playerTrack* trk)
+{
+	if (!trk->open || !trk->sample_rate || !trk->channels)
+		return 0;
+
+	return (uint32_t) ((uint64_t) trackFrames(trk) * 1000 / trk->sample_rate);
+}
+
+uint32_t PBSPlayer::duration()
+{
+	return trackDuration(&track);
+}
+
+uint32_t PBSPlayer::render(int16_t* buffer, uint32_t samples)
+{
+	return renderTrack(&track, buffer, samples);
+}
+
+void PBSPlayer::setPitch(float ratio)
+{
+	pitch = ratio;
+	pitched = true;
+
+	if (track.open && track.resampling)
+		track.resampler->setPitch(ratio);
+}
+
+void PBSPlayer::setFilter(PBSBiquadType type, float freq, float q, uint32_t ms)
+{
+	if (!filter)
+	{
+		if (type == BiquadOff)
+			return;
+
+		filter = new PBSBiquad();
+	}
+
+	// The interrupt doesn't take the new filter before it's all written
+	filter_pending = false;
+	filter_type = type;
+	filter_freq = freq;
+	filter_q = q;
+	filter_samples = (uint32_t) (((uint64_t) ms * mixer->getSampleRate()) / 1000);
+	filter_pending = true;
+}
+
+void PBSPlayer::setVolume(float value)
+{
+	// The interrupt stops ramping before the volume changes
+	ramp_left = 0;
+	volume = value;
+}
+
+void PBSPlayer::rampVolume(float target, uint32_t ms, volumeCurve curve)
+{
+	uint32_t length = (uint32_t) (((uint64_t) ms * mixer->getSampleRate()) / 1000);
+
+	ramp_left = 0;
+
+	if (!length)
+	{
+		volume = target;
+		return;
+	}
+
+	ramp_from = volume;
+	ramp_to = target;
+	ramp_curve = curve;
+	ramp_length = length;
+	ramp_left = length;
+}
+
+float PBSPlayer::stepRamp(uint32_t samples)
+{
+	// Returns the volume after 'samples' more samples of the ramp
+	if (samples >= ramp_left)
+	{
+		ramp_left = 0;
+		volume = ramp_to;
+		return volume;
+	}
+
+	ramp_left -= samples;
+
+	float pos = (float) (ramp_length - ramp_left) / ramp_length;
+	if (ramp_curve == volumeEqualPower)
+	{
+		// Fast start when going up, slow start when going down
+		if (ramp_to > ramp_from)
+			pos = sinf(pos * (float) M_PI_2);
+		else
+			pos = 1.0f - cosf(pos * (float) M_PI_2);
+	}
+
+	volume = ramp_from + (ramp_to - ramp_from) * pos;
+	return volume;
+}
+
+void PBSPlayer::mix(int32_t* buffer, uint32_t samples)
+{
+	int16_t block[AUDIO_BLOCK_SAMPLES];
+	uint32_t count = render(block, samples);
+	float gain = volume;
+	uint32_t ramp = 0;
+
+	if (filter_pending)
+	{
+		filter_pending = false;
+		filter->set(filter_type, filter_freq, filter_q, mixer->getSampleRate(),
+					filter_samples);
+	}
+
+	if (filter && filter->active())
+		filter->process(block, count);
+
+	if (ramp_left)
+	{
+		// The curve is evaluated once per block, and followed linearly in between
+		ramp = ramp_left < count ? ramp_left : count;
+		float step = ramp ? (stepRamp(ramp) - gain) / ramp : 0;
+
+		for (uint32_t i = 0; i < ramp; i++, gain += step)
+			buffer[i] += (int32_t) (block[i] * gain);
+
+		gain = volume;
+	}
+
+	for (uint32_t i = ramp; i < count; i++)
+		buffer[i] += (int32_t) (block[i] * gain);
+
+	if (count < samples)
+		active = false;
+}
+
+void PBSPlayer::waitBlocking(volatile bool* flag)
+{
+	// The rings are only refilled from the foreground
+	while (*flag)
+	{
+		mixer->service();
+		delay(1);
+	}
+}
+
+bool PBSPlayer::play(const char* filename, PlayMode mode)
+{
+	return play(filename, NULL, mode);
+}
+
+bool PBSPlayer::play(const char* filename, const AudioTrackInfo* info, PlayMode mode)
+{
+	return start(filename, info, NULL, mode);
+}
+
+bool PBSPlayer::play(PBSPreparedTrack* prepared, PlayMode mode)
+{
+	if (!prepared->ready())
+		return false;
+
+	return start(prepared->getFileName(), NULL, prepared, mode);
+}
+
+bool PBSPlayer::start(const char* filename, const AudioTrackInfo* info,
+					  PBSPreparedTrack* prepared, PlayMode mode)
+{
+	active = false;
+
+	// A new sound doesn't ring with the end of the last one
+	if (filter)
+		filter->reset();
+
+	if (!openTrack(&track, filename, info, mode == PlayModeLoop, prepared))
+		return false;
+
+	active = true;
+
+	if (mode == PlayModeBlocking)
+		waitBlocking(&active);
+
+	return true;
+}
+
+void PBSPlayer::stop()
+{
+	active = false;
+	closeTrack(&track);
+}
+
+PBSChainPlayer::PBSChainPlayer() : chained_active(false)
+{
+	memset(&chained, 0, sizeof(playerTrack));
+}
+
+PBSChainPlayer::~PBSChainPlayer()
+{
+	chained_active = false;
+	closeTrack(&chained);
+	delete chained.resampler;
+	delete[] chained.loop_head;
+}
+
+bool PBSChainPlayer::begin(const char* filename)
+{
+	return begin(filename, NULL);
+}
+
+bool PBSChainPlayer::begin(const char* filename, const AudioTrackInfo* info)
+{
+	stop();
+	return openTrack(&track, filename, info, true);
+}
+
+bool PBSChainPlayer::chain(const char* filename, PlayMode mode)
+{
+	return chain(filename, NULL, mode);
+}
+
+bool PBSChainPlayer::chain(const char* filename, const AudioTrackInfo* info, PlayMode mode)
+{
+	return startChained(filename, info, NULL, mode);
+}
+
+bool PBSChainPlayer::chain(PBSPreparedTrack* prepared, PlayMode mode)
+{
+	if (!prepared->ready())
+		return false;
+
+	return startChained(prepared->getFileName(), NULL, prepared, mode);
+}
+
+bool PBSChainPlayer::startChained(const char* filename, const AudioTrackInfo* info,
+								  PBSPreparedTrack* prepared, PlayMode mode)
+{
+	chained_active = false;
+
+	if (!openTrack(&chained, filename, info, mode == PlayModeLoop, prepared))
+		return false;
+
+	chained_active = true;
+
+	if (mode == PlayModeBlocking && active)
+		waitBlocking(&chained_active);
+
+	return true;
+}
+
+bool PBSChainPlayer::play()
+{
+	if (!track.open)
+		return false;
+
+	active = true;
+	return true;
+}
+
+bool PBSChainPlayer::restart()
+{
+	chained_active = false;
+	closeTrack(&chained);
+	return true;
+}
+
+void PBSChainPlayer::stop()
+{
+	chained_active = false;
+	closeTrack(&chained);
+	PBSPlayer::stop();
+}
+
+uint32_t PBSChainPlayer::getChainedDuration()
+{
+	return trackDuration(&chained);
+}
+
+playerTrack* PBSChainPlayer::getTrack(uint32_t index)
+{
+	if (index == 0)
+		return &track;
+
+	return index == 1 ? &chained : NULL;
+}
+
+uint32_t PBSChainPlayer::render(int16_t* buffer, uint32_t samples)
+{
+	uint32_t produced = 0;
+
+	// The chained file is closed from loop() when it ends
+	if (chained_active)
+	{
+		produced = renderTrack(&chained, buffer, samples);
+		if (produced < samples)
+			chained_active = false;
+	}
+
+	if (produced < samples)
+		produced += renderTrack(&track, buffer + produced, samples - produced);
+
+	return produced;
+}
+
+PBSPreparedTrack::PBSPreparedTrack() : open(false), buffered(0)
+{
+	memset(&info, 0, sizeof(AudioTrackInfo));
+	filename[0] = 0;
+}
+
+PBSPreparedTrack::~PBSPreparedTrack()
+{
+	release();
+}
+
+bool PBSPreparedTrack::prepare(const char* path, const AudioTrackInfo* track)
+{
+	UINT read = 0;
+
+	release();
+
+	if (!track->channels || f_open(&file, path, FA_READ) != FR_OK)
+		return false;
+
+	buffered = track->data_size < PBS_PREPARED_SIZE ? track->data_size : PBS_PREPARED_SIZE;
+
+	if (f_lseek(&file, track->data_offset) != FR_OK ||
+		f_read(&file, buffer, buffered, &read) != FR_OK || read != buffered)
+	{
+		f_close(&file);
+		return false;
+	}
+
+	info = *track;
+	snprintf(filename, sizeof(filename), "%s", path);
+	open = true;
+	return true;
+}
+
+void PBSPreparedTrack::release()
+{
+	if (open)
+		f_close(&file);
+
+	open = false;
+}
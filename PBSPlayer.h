@@ -0,0 +1,294 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSPlayer.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSPLAYER_H__
+#define __PBSPLAYER_H__
+
+#include <Arduino.h>
+#include "PBSAudio.h"
+#include "PBSAdpcm.h"
+#include "PBSResampler.h"
+#include "PBSBiquad.h"
+
+class PBSMixer;
+class PBSPlayer;
+
+// Called from the audio interrupt when a file opened by a player renders its first samples
+typedef void (playerStartCallback)(PBSPlayer* player, void* arg);
+
+// Longest path of a file played
+#define PBS_PLAYER_NAME_LEN		96
+
+// Sounds looped on a loop region crossfade its end into its start, over up to
+// PBS_LOOP_FADE_MS. The start of the region is kept when it first plays, so the seam
+// doesn't wait for the SD.
+#define PBS_LOOP_FADE_MS		5
+#define PBS_LOOP_FADE_MAX		256
+
+typedef enum
+{
+	volumeLinear,
+	volumeEqualPower			// Sine/cosine shaped, for crossfades
+} volumeCurve;
+
+// Priority of the SD reads of a player, after the streams about to run out of data
+typedef enum
+{
+	streamEffect,
+	streamHum,
+	streamMusic,
+	streamPriorityMax
+} streamPriority;
+
+// A file being played. Its audio data goes through a ring buffer of the mixer, written
+// from loop() and read by the audio interrupt; each side only moves its own counter.
+typedef struct
+{
+	bool open;
+	bool file_open;					// Opened when the first byte not in RAM is read
+	FIL file;
+	char filename[PBS_PLAYER_NAME_LEN];
+	uint32_t data_offset;
+	uint32_t data_size;				// Whole frames, or whole parts of IMA-ADPCM blocks
+	uint32_t sample_rate;
+	uint8_t channels;
+	uint8_t format;					// AudioFormat
+	uint16_t block_align;
+	bool loop;
+	volatile bool ended;			// Set by the interrupt, the file is closed from loop()
+	bool started;					// First samples rendered
+	uint32_t position;				// Next byte of audio data to render
+
+	// 'fetch' is the next byte of audio data to read from the file, up to 'fetch_end' (the
+	// end of the data or of the loop region). Looped files go on from 'fetch_loop'.
+	uint8_t* ring;
+	uint32_t fetch;
+	uint32_t fetch_end;
+	uint32_t fetch_loop;
+	const uint8_t* cache;			// The first 'cached' bytes of the data, in RAM
+	uint32_t cached;
+	volatile uint32_t written;
+	volatile uint32_t consumed;
+	uint8_t priority;
+	bool waiting;					// For a refill, since 'wait_us'
+	uint32_t wait_us;
+
+	// IMA-ADPCM is decoded a part of a block at a time, as it's rendered
+	adpcmState adpcm;
+	int16_t decoded[PBS_ADPCM_GROUP_FRAMES * 2];
+	uint8_t decoded_frames;
+	uint8_t decoded_pos;
+	uint32_t decoded_skip;			// Frames to drop before the loop region goes on
+
+	// Loop region, in frames, and the start of it the end fades into. 'loop_head' is
+	// allocated the first time it's needed, and kept.
+	uint32_t frame;					// Next frame to render
+	uint32_t loop_start;
+	uint32_t loop_end;				// 0 without a loop region
+	uint32_t loop_fade;
+	uint32_t loop_skip;
+	int16_t* loop_head;
+
+	// Sounds at another sample rate than the output, or played at another pitch, are
+	// resampled. Allocated the first time it's needed, and kept.
+	PBSResampler* resampler;
+	bool resampling;
+} playerTrack;
+
+// Bytes of audio data read ahead by PBSPreparedTrack: two sectors, the first audio block
+// of sounds at the output sample rate and more
+#define PBS_PREPARED_SIZE		1024
+
+// A sound file opened ahead of time, positioned at its audio data, with the first bytes of
+// audio data already read. A player given one takes over the file, so playback starts
+// without waiting for the SD. The track must be prepared again to be used again.
+class PBSPreparedTrack
+{
+public:
+	PBSPreparedTrack();
+	~PBSPreparedTrack();
+	bool prepare(const char* filename, const AudioTrackInfo* info);
+	void release();
+	inline bool ready() { return open; }
+	inline const char* getFileName() { return filename; }
+
+private:
+	friend class PBSPlayer;
+
+	bool open;
+	FIL file;
+	AudioTrackInfo info;
+	uint8_t buffer[PBS_PREPARED_SIZE];
+	uint32_t buffered;
+	char filename[PBS_PLAYER_NAME_LEN];
+};
+
+// Plays WAV files, 16-bit PCM or IMA-ADPCM, through PBSMixer. Given the AudioTrackInfo of
+// a file (from the manifest), it opens the file and starts at its audio data, which may be
+// anywhere in the file, like a sound in a font pack. Everything is called from loop(); the
+// SD is never read from the audio interrupt.
+class PBSPlayer
+{
+public:
+	PBSPlayer();
+	virtual ~PBSPlayer();
+
+	bool play(const char* filename, PlayMode mode = PlayModeNormal);
+	bool play(const char* filename, const AudioTrackInfo* info, PlayMode mode = PlayModeNormal);
+	bool play(PBSPreparedTrack* prepared, PlayMode mode = PlayModeNormal);
+	virtual void stop();
+	inline bool playing() { return active; }
+	void setVolume(float value);
+	inline float getVolume() { return volume; }
+
+	// Moves the volume to 'target' over 'ms' of playback, sample by sample in the mixer.
+	// setVolume() cancels it.
+	void rampVolume(float target, uint32_t ms, volumeCurve curve = volumeLinear);
+	inline bool ramping() { return active && ramp_left; }
+
+	inline void setStartCallback(playerStartCallback* callback, void* arg)
+	{
+		start_callback = callback;
+		start_arg = arg;
+	}
+	uint32_t duration();
+	inline const char* getFileName() { return track.filename; }
+
+	// Plays the sound faster and higher (ratio > 1) or slower and lower, from the next audio
+	// block. A chained sound plays at its own pitch. Sounds opened after the first call go
+	// through the resampler from their start, so later changes don't click.
+	void setPitch(float ratio);
+	inline float getPitch() { return pitch; }
+
+	// Filters the sound with a biquad, before the volume. The coefficients move to the new
+	// filter over 'ms' of playback. BiquadOff opens the filter up to flat, and then takes it
+	// out. The filter is allocated the first time it's needed, and kept.
+	void setFilter(PBSBiquadType type, float freq, float q = 0.707f, uint32_t ms = 0);
+
+	// Takes effect on the next file opened. Files chained on a PBSChainPlayer are effects.
+	inline void setPriority(streamPriority value) { priority = value; }
+
+	// Audio blocks rendered with silence, the SD didn't keep up
+	inline uint32_t getUnderruns() { return underruns; }
+
+	// Parses the header of a WAV file, up to its audio data. With 'loops' the loop region
+	// of the smpl chunk is read too, that may come after the audio data.
+	static bool readHeader(FIL* file, AudioTrackInfo* info, bool loops);
+
+	// Frames of a sound, and the check of its loop region: one that doesn't end after its
+	// start and within the sound is dropped
+	static uint32_t countFrames(const AudioTrackInfo* info);
+	static void checkLoop(AudioTrackInfo* info);
+
+protected:
+	friend class PBSMixer;
+
+	bool openTrack(playerTrack* trk, const char* filename, const AudioTrackInfo* info,
+				   bool loop, PBSPreparedTrack* prepared = NULL);
+	bool start(const char* filename, const AudioTrackInfo* info, PBSPreparedTrack* prepared,
+			   PlayMode mode);
+	void closeTrack(playerTrack* trk);
+	uint32_t renderTrack(playerTrack* trk, int16_t* buffer, uint32_t samples);
+	void beginLoop(playerTrack* trk, uint32_t start, uint32_t end);
+	uint32_t renderFrames(playerTrack* trk, int16_t* buffer, uint32_t samples);
+	uint32_t renderData(playerTrack* trk, int16_t* buffer, uint32_t samples);
+	uint32_t readPcm(playerTrack* trk, int16_t* buffer, uint32_t samples);
+	uint32_t decodeAdpcm(playerTrack* trk, int16_t* buffer, uint32_t samples);
+	uint32_t resample(playerTrack* trk, int16_t* buffer, uint32_t samples);
+	uint32_t trackDuration(playerTrack* trk);
+	void waitBlocking(volatile bool* flag);
+
+	// Called from the audio interrupt. Renders up to 'samples' mono samples and returns
+	// how many were produced; less than requested ends the playback.
+	virtual uint32_t render(int16_t* buffer, uint32_t samples);
+	void mix(int32_t* buffer, uint32_t samples);
+
+	// The files of the player, for the mixer to refill and close
+	virtual playerTrack* getTrack(uint32_t index) { return index ? NULL : &track; }
+
+	PBSMixer* mixer;
+	volatile bool active;
+	float volume;
+	streamPriority priority;
+	volatile uint32_t underruns;
+	float pitch;
+	bool pitched;
+	playerTrack track;
+
+private:
+	float stepRamp(uint32_t samples);
+
+	playerStartCallback* start_callback;
+	void* start_arg;
+
+	// The interrupt designs the filter set from loop(), once it's pending
+	PBSBiquad* filter;
+	volatile bool filter_pending;
+	PBSBiquadType filter_type;
+	float filter_freq;
+	float filter_q;
+	uint32_t filter_samples;
+
+	float ramp_from;
+	float ramp_to;
+	uint32_t ramp_length;			// Samples
+	volatile uint32_t ramp_left;
+	volumeCurve ramp_curve;
+
+	static void readLoop(FIL* file, uint32_t chunk_size, AudioTrackInfo* info);
+};
+
+// Plays a file in a loop, with other files chained on top of it: a chained file plays
+// instead of the looped one, which goes on where it was when the chained one ends.
+class PBSChainPlayer : public PBSPlayer
+{
+public:
+	PBSChainPlayer();
+	~PBSChainPlayer();
+	bool begin(const char* filename);
+	bool begin(const char* filename, const AudioTrackInfo* info);
+	bool chain(const char* filename, PlayMode mode = PlayModeNormal);
+	bool chain(const char* filename, const AudioTrackInfo* info, PlayMode mode = PlayModeNormal);
+	bool chain(PBSPreparedTrack* prepared, PlayMode mode = PlayModeNormal);
+	bool play();
+	bool restart();
+	void stop();
+	inline bool playingChained() { return active && chained_active; }
+	uint32_t getChainedDuration();
+	inline const char* getChainedFileName() { return chained.filename; }
+
+protected:
+	uint32_t render(int16_t* buffer, uint32_t samples);
+	playerTrack* getTrack(uint32_t index);
+
+private:
+	bool startChained(const char* filename, const AudioTrackInfo* info,
+					  PBSPreparedTrack* prepared, PlayMode mode);
+
+	playerTrack chained;
+	volatile bool chained_active;
+};
+
+#endif /* __PBSPLAYER_H__ */
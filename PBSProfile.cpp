@@ -0,0 +1,161 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSProfile.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSProfile.h"
+#include "PBSDebug.h"
+
+#if PBS_PROFILE
+
+static profileEntry profile_ring[PBS_PROFILE_ENTRIES];
+static uint32_t profile_count = 0;			// Phases started since the reset
+static uint32_t profile_base = 0;			// micros() at reset
+static uint8_t profile_depth = 0;
+static bool profile_enabled = false;
+
+void profileReset()
+{
+	memset(profile_ring, 0, sizeof(profile_ring));
+	profile_count = 0;
+	profile_depth = 0;
+	profile_base = micros();
+	profile_enabled = true;
+}
+
+void profileStop()
+{
+	// Keep what was recorded, phases started from now on are ignored
+	profile_enabled = false;
+}
+
+uint32_t profileStart(const char* name, uint32_t arg)
+{
+	if (!profile_enabled)
+		return PBS_PROFILE_RUNNING;
+
+	profileEntry* entry = &profile_ring[profile_count % PBS_PROFILE_ENTRIES];
+	entry->name = name;
+	entry->start = micros() - profile_base;
+	entry->duration = PBS_PROFILE_RUNNING;
+	entry->arg = (uint16_t) arg;
+	entry->depth = profile_depth++;
+
+	return profile_count++;
+}
+
+void profileEnd(uint32_t handle)
+{
+	if (handle == PBS_PROFILE_RUNNING)
+		return;
+
+	if (profile_depth)
+		profile_depth--;
+
+	// The phase may have been overwritten already
+	if (profile_count - handle > PBS_PROFILE_ENTRIES)
+		return;
+
+	profileEntry* entry = &profile_ring[handle % PBS_PROFILE_ENTRIES];
+	entry->duration = micros() - profile_base - entry->start;
+}
+
+static uint32_t formatEntry(char* dst, uint32_t size, profileEntry* entry)
+{
+	char name[32];
+
+	if (entry->arg)
+		snprintf(name, sizeof(name), "%s(%u)", entry->name, entry->arg);
+	else
+		snprintf(name, sizeof(name), "%s", entry->name);
+
+	if (entry->duration == PBS_PROFILE_RUNNING)
+		return snprintf(dst, size, "%10lu %*s%-24s      running", (unsigned long) entry->start,
+						entry->depth * 2, "", name);
+
+	return snprintf(dst, size, "%10lu %*s%-24s %10lu us", (unsigned long) entry->start,
+					entry->depth * 2, "", name, (unsigned long) entry->duration);
+}
+
+void profileDump()
+{
+	char line[80];
+	uint32_t first = 0;
+
+	if (profile_count > PBS_PROFILE_ENTRIES)
+		first = profile_count - PBS_PROFILE_ENTRIES;
+
+	debugMsg(DebugInfo, "Boot profile (%lu phases, %lu lost)", profile_count - first, first);
+
+	for (uint32_t i = first; i < profile_count; i++)
+	{
+		formatEntry(line, sizeof(line), &profile_ring[i % PBS_PROFILE_ENTRIES]);
+		debugMsg(DebugInfo, "%s", line);
+	}
+}
+
+bool profileAppend(const char* filename)
+{
+	FIL file;
+	UINT written;
+	char line[80];
+	uint32_t len;
+	uint32_t first = 0;
+	bool ret = true;
+
+	if (f_open(&file, filename, FA_WRITE | FA_OPEN_APPEND) != FR_OK)
+		return false;
+
+	// Don't let the log grow forever
+	if (f_size(&file) > PBS_PROFILE_LOG_SIZE)
+	{
+		if (f_lseek(&file, 0) != FR_OK || f_truncate(&file) != FR_OK)
+		{
+			f_close(&file);
+			return false;
+		}
+	}
+
+	if (profile_count > PBS_PROFILE_ENTRIES)
+		first = profile_count - PBS_PROFILE_ENTRIES;
+
+	len = snprintf(line, sizeof(line), "boot at %lu ms, %lu phases\r\n",
+				   (unsigned long) GetTickCount(), (unsigned long) (profile_count - first));
+	ret = f_write(&file, line, len, &written) == FR_OK && written == len;
+
+	for (uint32_t i = first; i < profile_count && ret; i++)
+	{
+		len = formatEntry(line, sizeof(line) - 2, &profile_ring[i % PBS_PROFILE_ENTRIES]);
+		if (len > sizeof(line) - 3)
+			len = sizeof(line) - 3;
+
+		strcpy(line + len, "\r\n");
+		len += 2;
+		ret = f_write(&file, line, len, &written) == FR_OK && written == len;
+	}
+
+	f_close(&file);
+	return ret;
+}
+
+#endif // PBS_PROFILE
@@ -0,0 +1,86 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSProfile.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSPROFILE_H__
+#define __PBSPROFILE_H__
+
+#include <Arduino.h>
+
+/* Boot profiler */
+#ifndef PBS_PROFILE
+#define PBS_PROFILE 1
+#endif
+
+// Size of the ring of phases. Once full, the oldest phases are overwritten.
+#define PBS_PROFILE_ENTRIES		48
+
+// Log files are started again after this size
+#define PBS_PROFILE_LOG_SIZE	(64 * 1024)
+
+// A timed phase. Times are in us since profileReset().
+typedef struct
+{
+	const char* name;			// Must be a string literal
+	uint32_t start;
+	uint32_t duration;			// PBS_PROFILE_RUNNING until the phase ends
+	uint16_t arg;				// Profile or font number, for example
+	uint8_t depth;				// Nesting level of the phase
+} profileEntry;
+
+#define PBS_PROFILE_RUNNING		0xFFFFFFFF
+
+#if PBS_PROFILE
+
+void profileReset();
+void profileStop();
+uint32_t profileStart(const char* name, uint32_t arg = 0);
+void profileEnd(uint32_t handle);
+void profileDump();
+bool profileAppend(const char* filename);
+
+// Times the rest of the enclosing block
+class PBSProfileScope
+{
+public:
+	PBSProfileScope(const char* name, uint32_t arg = 0) { handle = profileStart(name, arg); }
+	~PBSProfileScope() { profileEnd(handle); }
+
+private:
+	uint32_t handle;
+};
+
+#define PBS_PROFILE_SCOPE(name, ...)	PBSProfileScope profile_scope(name, ##__VA_ARGS__)
+
+#else
+#define profileReset()
+#define profileStop()
+#define profileStart(name, ...) (0)
+#define profileEnd(x) (void)(0)
+#define profileDump()
+#define profileAppend(x) (false)
+#define PBS_PROFILE_SCOPE(name, ...)
+#endif /* PBS_PROFILE */
+
+#endif /* __PBSPROFILE_H__ */
@@ -0,0 +1,260 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSResampler.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSResampler.h"
+#include <math.h>
+
+// The Cortex-M4 multiplies two pairs of 16-bit samples and accumulates in one instruction,
+// and saturates to 16 bits in another
+#if defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#define RESAMPLER_SAT16(x)		__ssat((x), 16)
+#else
+#define RESAMPLER_SAT16(x)		((x) > 32767 ? 32767 : ((x) < -32768 ? -32768 : (x)))
+#endif
+
+// Kaiser window shape: about 70 dB of stopband attenuation and a flat passband, for a
+// wider transition band
+#define RESAMPLER_KAISER_BETA	7.0f
+
+// Passband edge, as a fraction of the lower Nyquist frequency
+#define RESAMPLER_CUTOFF		0.9f
+
+static int16_t* tables[PBS_RESAMPLER_TABLES];
+static uint32_t table_keys[PBS_RESAMPLER_TABLES];
+
+static inline int32_t read32(const int16_t* ptr)
+{
+	// Two samples in a word. The M4 takes unaligned loads.
+	int32_t value;
+	memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+static inline int32_t filter(const int16_t* x, const int16_t* h)
+{
+	int32_t acc = 1 << 14;
+
+#if defined(__ARM_FEATURE_DSP)
+	for (uint32_t i = 0; i < PBS_RESAMPLER_TAPS; i += 2)
+		acc = __smlad(read32(x + i), read32(h + i), acc);
+#else
+	for (uint32_t i = 0; i < PBS_RESAMPLER_TAPS; i++)
+		acc += x[i] * h[i];
+#endif
+
+	acc >>= 15;
+	return RESAMPLER_SAT16(acc);
+}
+
+static float besselI0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+
+	for (uint32_t k = 1; k < 20; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+static void buildTable(int16_t* table, float cutoff)
+{
+	// 'cutoff' is in cycles per input sample. Output sample t = i + TAPS/2 - 1 + fraction
+	// takes input samples i .. i + TAPS - 1. Each phase stands for the fractions between
+	// p/PHASES and (p + 1)/PHASES, and is centered in between, so the rounding of the
+	// fraction averages out. The phases are scaled to a gain of 1.
+	const float half = PBS_RESAMPLER_TAPS / 2;
+	const float norm = besselI0(RESAMPLER_KAISER_BETA);
+
+	for (uint32_t p = 0; p < PBS_RESAMPLER_PHASES; p++)
+	{
+		int16_t* h = table + p * PBS_RESAMPLER_TAPS;
+		float coefs[PBS_RESAMPLER_TAPS];
+		float sum = 0;
+		int32_t total = 0;
+		uint32_t center = 0;
+
+		for (uint32_t k = 0; k < PBS_RESAMPLER_TAPS; k++)
+		{
+			float d = (float) k - (half - 1) - (p + 0.5f) / PBS_RESAMPLER_PHASES;
+			float x = 2 * cutoff * d;
+			float sinc = x == 0 ? 1.0f : sinf((float) M_PI * x) / ((float) M_PI * x);
+			float r = d / half;
+			float w = r >= 1 || r <= -1 ? 0 :
+					  besselI0(RESAMPLER_KAISER_BETA * sqrtf(1 - r * r)) / norm;
+
+			coefs[k] = sinc * w;
+			sum += coefs[k];
+		}
+
+		for (uint32_t k = 0; k < PBS_RESAMPLER_TAPS; k++)
+		{
+			h[k] = (int16_t) lrintf(coefs[k] / sum * 32768);
+			total += h[k];
+
+			if (coefs[k] > coefs[center])
+				center = k;
+		}
+
+		// Rounding goes to the largest tap, so DC passes with no error
+		h[center] += (int16_t) (32768 - total);
+	}
+}
+
+PBSResampler::PBSResampler() : table(NULL), in_fs(0), out_fs(0), step_int(1), step_frac(0)
+{
+	reset();
+}
+
+const int16_t* PBSResampler::getTable(uint32_t key)
+{
+	// Tables are keyed by the cutoff, in Q16 of the input rate. When all of them are taken,
+	// the closest one with a lower cutoff is used, that only costs a bit of treble.
+	uint32_t below = PBS_RESAMPLER_TABLES;
+	uint32_t lowest = 0;
+
+	for (uint32_t i = 0; i < PBS_RESAMPLER_TABLES; i++)
+	{
+		if (table_keys[i] == key)
+			return tables[i];
+
+		if (!table_keys[i])
+		{
+			tables[i] = new int16_t[PBS_RESAMPLER_PHASES * PBS_RESAMPLER_TAPS];
+			buildTable(tables[i], RESAMPLER_CUTOFF * 0.5f * key / 65536.0f);
+			table_keys[i] = key;
+			return tables[i];
+		}
+
+		if (table_keys[i] < key && (below == PBS_RESAMPLER_TABLES ||
+			table_keys[i] > table_keys[below]))
+			below = i;
+
+		if (table_keys[i] < table_keys[lowest])
+			lowest = i;
+	}
+
+	return tables[below < PBS_RESAMPLER_TABLES ? below : lowest];
+}
+
+uint32_t PBSResampler::cutoffKey(float ratio)
+{
+	// The lower of the two Nyquist frequencies, in Q16 of the input one. Reading the input
+	// faster moves the output one down by 'ratio'. The cutoff goes down in quarter octaves,
+	// rounded down, so a pitch that moves all the time only needs a few tables.
+	uint32_t key = (uint32_t) (((uint64_t) (in_fs < out_fs ? in_fs : out_fs) << 16) / in_fs);
+	float cutoff = out_fs / (in_fs * ratio);
+
+	if (cutoff < key / 65536.0f)
+	{
+		float quarters = ceilf(log2f(key / 65536.0f / cutoff) * 4 - 0.001f);
+		key = (uint32_t) (key * exp2f(-quarters / 4));
+	}
+
+	return key;
+}
+
+void PBSResampler::begin(uint32_t in_fs, uint32_t out_fs)
+{
+	if (!in_fs || !out_fs)
+		return;
+
+	uint64_t step = ((uint64_t) in_fs << 32) / out_fs;
+	step_int = (uint32_t) (step >> 32);
+	step_frac = (uint32_t) step;
+	this->in_fs = in_fs;
+	this->out_fs = out_fs;
+	table = getTable(cutoffKey(1.0f));
+	reset();
+}
+
+void PBSResampler::setPitch(float ratio)
+{
+	if (!out_fs || ratio <= 0)
+		return;
+
+	// Up to two octaves either way. The interrupt may see the two halves of the step from
+	// different calls once, which is a single sample off.
+	if (ratio > 4.0f)
+		ratio = 4.0f;
+	else if (ratio < 0.25f)
+		ratio = 0.25f;
+
+	uint64_t step = ((uint64_t) (in_fs * ratio * 65536.0f) << 16) / out_fs;
+	table = getTable(cutoffKey(ratio));
+	step_int = (uint32_t) (step >> 32);
+	step_frac = (uint32_t) step;
+}
+
+uint32_t PBSResampler::getInputFor(uint32_t count)
+{
+	uint64_t step = ((uint64_t) step_int << 32) | step_frac;
+	return (uint32_t) ((count * step) >> 32) + PBS_RESAMPLER_TAPS;
+}
+
+void PBSResampler::reset()
+{
+	// Starts with the history of silence that puts the first input sample at the center
+	// of the filter, so the output is not delayed
+	filled = PBS_RESAMPLER_TAPS / 2 - 1;
+	memset(line, 0, filled * sizeof(int16_t));
+	pos_int = 0;
+	pos_frac = 0;
+}
+
+uint32_t PBSResampler::read(int16_t* out, uint32_t count)
+{
+	uint32_t produced = 0;
+
+	if (!table)
+		return 0;
+
+	while (produced < count && pos_int + PBS_RESAMPLER_TAPS <= filled)
+	{
+		const int16_t* h = table + (pos_frac >> (32 - PBS_RESAMPLER_PHASE_BITS)) *
+						   PBS_RESAMPLER_TAPS;
+		uint32_t frac = pos_frac + step_frac;
+
+		out[produced++] = (int16_t) filter(line + pos_int, h);
+
+		pos_int += step_int + (frac < pos_frac);
+		pos_frac = frac;
+	}
+
+	// Drop the input already behind the filter
+	uint32_t drop = pos_int < filled ? pos_int : filled;
+	if (drop)
+	{
+		memmove(line, line + drop, (filled - drop) * sizeof(int16_t));
+		filled -= drop;
+		pos_int -= drop;
+	}
+
+	return produced;
+}
@@ -0,0 +1,85 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSResampler.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSRESAMPLER_H__
+#define __PBSRESAMPLER_H__
+
+#include <Arduino.h>
+
+// Polyphase FIR: each output sample is a PBS_RESAMPLER_TAPS-tap filter over the input, with
+// the coefficients of one of PBS_RESAMPLER_PHASES fractional positions between two input
+// samples. Coefficients are Q15. Tables depend on the cutoff (the lower of the two Nyquist
+// frequencies, moved down by a higher pitch) and are shared by all the resamplers using the
+// same one. They are allocated when first used, 2 KiB each.
+#define PBS_RESAMPLER_TAPS		16
+#define PBS_RESAMPLER_PHASE_BITS	6
+#define PBS_RESAMPLER_PHASES	(1 << PBS_RESAMPLER_PHASE_BITS)
+#define PBS_RESAMPLER_TABLES	8
+
+// Input samples taken at a time
+#define PBS_RESAMPLER_INPUT		256
+
+class PBSResampler
+{
+public:
+	PBSResampler();
+
+	// Sets the input and output sample rates and clears the history. Called from the
+	// foreground: the first use of a pair of rates builds its coefficient table.
+	void begin(uint32_t in_fs, uint32_t out_fs);
+	void reset();
+
+	// Reads the input 'ratio' times faster (higher pitch) or slower, from the next output
+	// sample. Called from the foreground: a higher pitch lowers the cutoff of the filter by
+	// as much, in quarter octaves, and the first use of a cutoff builds its table.
+	void setPitch(float ratio);
+
+	// Input samples are written to getInput(), up to getSpace() of them, and then committed
+	uint32_t getSpace() { return PBS_RESAMPLER_TAPS + PBS_RESAMPLER_INPUT - filled; }
+	int16_t* getInput() { return line + filled; }
+	void commit(uint32_t count) { filled += count; }
+
+	// Input samples it takes to produce the first 'count' output samples
+	uint32_t getInputFor(uint32_t count);
+
+	// Produces up to 'count' output samples from the input committed so far
+	uint32_t read(int16_t* out, uint32_t count);
+
+private:
+	static const int16_t* getTable(uint32_t key);
+	uint32_t cutoffKey(float ratio);
+
+	const int16_t* table;
+	uint32_t in_fs;
+	uint32_t out_fs;
+	uint32_t step_int;					// Input samples per output sample, Q32
+	uint32_t step_frac;
+	uint32_t pos_int;					// Position of the next output sample in 'line'
+	uint32_t pos_frac;
+	uint32_t filled;
+	int16_t line[PBS_RESAMPLER_TAPS + PBS_RESAMPLER_INPUT];
+};
+
+#endif /* __PBSRESAMPLER_H__ */
@@ -0,0 +1,173 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSState.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSState.h"
+#include "PBSConfig.h"
+
+PBSState::PBSState()
+{
+	opened = false;
+	journal_file[0] = 0;
+	memset(&current, 0, sizeof(saberStateRecord));
+	has_state = false;
+	sequence = 0;
+	next_slot = 0;
+	config_profile = 0;
+	config_volume = 0;
+}
+
+PBSState::~PBSState()
+{
+	if (opened)
+		f_close(&journal);
+}
+
+bool PBSState::begin(const char* config_file, uint32_t config_profile, float config_volume)
+{
+	saberStateRecord records[512 / sizeof(saberStateRecord)];
+	uint32_t slot = 0;
+	uint32_t last_slot = 0;
+	UINT read;
+
+	PBS_PROFILE_SCOPE("state journal");
+
+	this->config_profile = config_profile;
+	this->config_volume = config_volume;
+
+	// The journal has the same name of the configuration file, with another extension
+	snprintf(journal_file, sizeof(journal_file) - strlen(PBS_STATE_EXT), "%s", config_file);
+
+	char* ext = strrchr(journal_file, '.');
+	if (ext && !strchr(ext, '\\') && !strchr(ext, '/'))
+		*ext = 0;
+
+	strcat(journal_file, PBS_STATE_EXT);
+
+	if (f_open(&journal, journal_file, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) != FR_OK)
+	{
+		debugMsg(DebugWarning, "Error opening state journal %s", journal_file);
+		return false;
+	}
+
+	opened = true;
+
+	// Scan the whole journal, a sector at a time. Invalid records (an interrupted write)
+	// are skipped, and the next record goes right after the newest one.
+	do
+	{
+		if (f_read(&journal, records, sizeof(records), &read) != FR_OK)
+			break;
+
+		for (uint32_t i = 0; i < read / sizeof(saberStateRecord); i++, slot++)
+		{
+			if (checkRecord(&records[i]) && records[i].sequence > sequence)
+			{
+				sequence = records[i].sequence;
+				current = records[i];
+				last_slot = slot;
+				has_state = true;
+			}
+		}
+	} while (read == sizeof(records));
+
+	next_slot = has_state ? last_slot + 1 : 0;
+
+	if (!has_state)
+		return true;
+
+	// Discard the saved state if the user has changed the configuration file values
+	if (current.config_profile != config_profile || current.config_volume != config_volume)
+	{
+		debugMsg(DebugInfo, "Configuration file values have changed, ignoring saved state");
+		has_state = false;
+		return true;
+	}
+
+	debugMsg(DebugInfo, "Saved state: profile%lu, volume %idB (record %lu)",
+			 current.profile, (int) current.volume, last_slot);
+	return true;
+}
+
+bool PBSState::checkRecord(saberStateRecord* record)
+{
+	return record->magic == PBS_STATE_MAGIC && record->sequence != 0 &&
+		   record->crc == PBSConfig::crc32(0, record, offsetof(saberStateRecord, crc));
+}
+
+bool PBSState::writeRecord(saberStateRecord* record, uint32_t slot)
+{
+	UINT written;
+
+	if (f_lseek(&journal, slot * sizeof(saberStateRecord)) != FR_OK ||
+		f_write(&journal, record, sizeof(saberStateRecord), &written) != FR_OK ||
+		written != sizeof(saberStateRecord))
+		return false;
+
+	return true;
+}
+
+bool PBSState::save(uint32_t profile, float volume)
+{
+	saberStateRecord record;
+
+	if (!opened)
+		return false;
+
+	// Nothing changed
+	if (has_state && current.profile == profile && current.volume == volume)
+		return true;
+
+	memset(&record, 0, sizeof(saberStateRecord));
+	record.magic = PBS_STATE_MAGIC;
+	record.sequence = sequence + 1;
+	record.profile = profile;
+	record.volume = volume;
+	record.config_profile = config_profile;
+	record.config_volume = config_volume;
+	record.crc = PBSConfig::crc32(0, &record, offsetof(saberStateRecord, crc));
+
+	if (next_slot >= PBS_STATE_MAX_RECORDS)
+	{
+		// Compact: the new record goes first and the rest is dropped. If the truncation
+		// doesn't happen, the old records have a lower sequence number and are ignored.
+		if (!writeRecord(&record, 0) || f_truncate(&journal) != FR_OK)
+			return false;
+
+		next_slot = 1;
+	} else {
+		if (!writeRecord(&record, next_slot))
+			return false;
+
+		next_slot++;
+	}
+
+	if (f_sync(&journal) != FR_OK)
+		return false;
+
+	sequence = record.sequence;
+	current = record;
+	has_state = true;
+	return true;
+}
@@ -0,0 +1,83 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSState.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSSTATE_H__
+#define __PBSSTATE_H__
+
+#include <Arduino.h>
+#include "PBSDebug.h"
+#include "PBSProfile.h"
+
+// Journal of the runtime state, stored next to the configuration file
+#define PBS_STATE_MAGIC			0x4A534250		// "PBSJ"
+#define PBS_STATE_EXT			".pbj"
+#define PBS_STATE_MAX_RECORDS	128				// Compact the journal after this many records
+
+// Journal record. The file is a sequence of these, the valid one with the highest sequence
+// number is the current state. Records are 32 bytes so they never straddle a sector.
+typedef struct
+{
+	uint32_t magic;
+	uint32_t sequence;
+	uint32_t profile;
+	float volume;
+
+	// initial_profile and master_volume of the configuration file when the record was
+	// written. If the user edits them, the configuration file wins.
+	uint32_t config_profile;
+	float config_volume;
+
+	uint32_t reserved;
+	uint32_t crc;
+} saberStateRecord;
+
+class PBSState
+{
+public:
+	PBSState();
+	~PBSState();
+	bool begin(const char* config_file, uint32_t config_profile, float config_volume);
+	bool save(uint32_t profile, float volume);
+
+	inline bool valid() { return has_state; }
+	inline uint32_t getProfile() { return current.profile; }
+	inline float getVolume() { return current.volume; }
+
+private:
+	bool checkRecord(saberStateRecord* record);
+	bool writeRecord(saberStateRecord* record, uint32_t slot);
+
+	FIL journal;
+	bool opened;
+	char journal_file[64];
+	saberStateRecord current;
+	bool has_state;
+	uint32_t sequence;
+	uint32_t next_slot;
+	uint32_t config_profile;
+	float config_volume;
+};
+
+#endif /* __PBSSTATE_H__ */
@@ -155,7 +155,7 @@ bool PBSStrip::setSection(uint8_t index, uint32_t start, uint32_t end)
 	sections[index].end = end;
 	sections[index].animating = false;
 	sections[index].brightness = 1.0f;
-	memset(&sections[index].anims, 0, sizeof(sectionAnimation));
+	memset((void*) &sections[index].anims, 0, sizeof(sectionAnimation));
 	sections[index].active = true;
 	return true;
 }
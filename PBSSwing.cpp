@@ -0,0 +1,94 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSSwing.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSSwing.h"
+#include <math.h>
+
+PBSSwing::PBSSwing()
+{
+	begin(0);
+}
+
+void PBSSwing::begin(uint32_t depth, uint32_t pitch)
+{
+	if (depth > 100)
+		depth = 100;
+
+	this->depth = depth / 100.0f;
+	this->pitch = pitch / 1200.0f;
+	reset();
+}
+
+void PBSSwing::reset()
+{
+	gravity[0] = gravity[1] = gravity[2] = 0;
+	settled = false;
+	level = 0;
+	hum_volume = 1.0f;
+	low_volume = high_volume = 0;
+	hum_pitch = 1.0f;
+}
+
+void PBSSwing::update(float x, float y, float z, uint32_t elapsed)
+{
+	float accel[3] = { x, y, z };
+	float dt = elapsed / 1000000.0f;
+	float motion = 0;
+
+	// Gravity is what stays after a low-pass filter. Start from the first reading, so there
+	// is no swing when the blade comes up.
+	if (!settled)
+	{
+		memcpy(gravity, accel, sizeof(gravity));
+		settled = true;
+	}
+
+	float k = dt / (PBS_SWING_GRAVITY_TAU + dt);
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		gravity[i] += (accel[i] - gravity[i]) * k;
+		float diff = accel[i] - gravity[i];
+		motion += diff * diff;
+	}
+
+	motion = sqrtf(motion);
+
+	// Map to 0..1 and follow it, faster when going up
+	float target = (motion - PBS_SWING_THRESHOLD) / (PBS_SWING_FULL - PBS_SWING_THRESHOLD);
+	if (target < 0)
+		target = 0;
+	else if (target > 1)
+		target = 1;
+
+	float tau = (target > level) ? PBS_SWING_ATTACK_TAU : PBS_SWING_RELEASE_TAU;
+	level += (target - level) * (dt / (tau + dt));
+
+	// Equal-power crossfade between the low and the high swing sounds
+	float swing = depth * level;
+	low_volume = swing * cosf(level * (float) M_PI_2);
+	high_volume = swing * sinf(level * (float) M_PI_2);
+	hum_volume = 1.0f - swing * 0.5f;
+	hum_pitch = exp2f(pitch * level);
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSSwing.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSSWING_H__
+#define __PBSSWING_H__
+
+#include <Arduino.h>
+
+// Acceleration (g, without gravity) where the swing sounds start to be heard, and where
+// they are at full volume
+#define PBS_SWING_THRESHOLD		0.15f
+#define PBS_SWING_FULL			1.5f
+
+// Time constants (s) of the gravity estimate and of the swing level
+#define PBS_SWING_GRAVITY_TAU	0.4f
+#define PBS_SWING_ATTACK_TAU	0.02f
+#define PBS_SWING_RELEASE_TAU	0.15f
+
+// Octaves the cutoff of the hum filter goes up at full speed
+#define PBS_SWING_FILTER_OCTAVES	3.0f
+
+// Smooth swing: turns the accelerometer readings into the volumes of the hum and of a pair
+// of looping swing sounds. Slow swings bring in the low swing sound, faster swings move to
+// the high one, and the hum is lowered by half of the swing level. The pitch of the hum and
+// the cutoff of its filter can also go up with the swing level.
+class PBSSwing
+{
+public:
+	PBSSwing();
+
+	// 'depth' is the volume of the swing sounds at full speed, from 0 to 100 (%), and
+	// 'pitch' how much the hum goes up at full speed, in cents
+	void begin(uint32_t depth, uint32_t pitch = 0);
+	void reset();
+
+	// Takes a reading (g) taken 'elapsed' us after the previous one
+	void update(float x, float y, float z, uint32_t elapsed);
+
+	inline float getLevel() { return level; }
+	inline float getHumVolume() { return hum_volume; }
+	inline float getLowVolume() { return low_volume; }
+	inline float getHighVolume() { return high_volume; }
+	inline float getHumPitch() { return hum_pitch; }
+
+	// What the cutoff of the hum filter is multiplied by
+	inline float getFilterScale() { return exp2f(PBS_SWING_FILTER_OCTAVES * level); }
+
+private:
+	float depth;
+	float pitch;						// Octaves at full speed
+	float gravity[3];
+	bool settled;
+	float level;
+	float hum_volume;
+	float low_volume;
+	float high_volume;
+	float hum_pitch;
+};
+
+#endif /* __PBSSWING_H__ */
@@ -0,0 +1,140 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSVoices.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "PBSVoices.h"
+
+PBSVoices::PBSVoices()
+{
+	memset(types, 0, sizeof(types));
+	memset(priorities, 0, sizeof(priorities));
+	memset(order, 0, sizeof(order));
+	memset(&stats, 0, sizeof(stats));
+	counter = 0;
+}
+
+void PBSVoices::begin(PBSMixer* mixer)
+{
+	for (uint32_t i = 0; i < PBS_FX_VOICES; i++)
+		mixer->add(&voices[i]);
+}
+
+PBSPlayer* PBSVoices::allocate(uint8_t type, uint8_t priority)
+{
+	int32_t voice = -1;
+	uint32_t busy = 0;
+
+	for (uint32_t i = 0; i < PBS_FX_VOICES; i++)
+	{
+		if (!voices[i].playing())
+		{
+			if (voice < 0)
+				voice = i;
+		} else {
+			busy++;
+		}
+	}
+
+	if (voice < 0)
+	{
+		// Steal one
+		for (uint32_t i = 0; i < PBS_FX_VOICES; i++)
+		{
+			if (priorities[i] > priority)
+				continue;
+
+			if (voice < 0 || priorities[i] < priorities[voice])
+			{
+				voice = i;
+				continue;
+			}
+
+			if (priorities[i] == priorities[voice] && order[i] < order[voice])
+				voice = i;
+		}
+
+		if (voice < 0)
+		{
+			stats.drops++;
+			return NULL;
+		}
+
+		voices[voice].stop();
+		stats.steals++;
+		busy--;
+	}
+
+	if (busy + 1 > stats.peak)
+		stats.peak = busy + 1;
+
+	stats.allocations++;
+	types[voice] = type;
+	priorities[voice] = priority;
+	order[voice] = ++counter;
+	voices[voice].setVolume(1.0f);
+	return &voices[voice];
+}
+
+bool PBSVoices::playing()
+{
+	for (uint32_t i = 0; i < PBS_FX_VOICES; i++)
+	{
+		if (voices[i].playing())
+			return true;
+	}
+
+	return false;
+}
+
+bool PBSVoices::playing(uint8_t type)
+{
+	for (uint32_t i = 0; i < PBS_FX_VOICES; i++)
+	{
+		if (types[i] == type && voices[i].playing())
+			return true;
+	}
+
+	return false;
+}
+
+void PBSVoices::stop()
+{
+	for (uint32_t i = 0; i < PBS_FX_VOICES; i++)
+		voices[i].stop();
+}
+
+void PBSVoices::stop(uint8_t type)
+{
+	for (uint32_t i = 0; i < PBS_FX_VOICES; i++)
+	{
+		if (types[i] == type)
+			voices[i].stop();
+	}
+}
+
+void PBSVoices::setStartCallback(playerStartCallback* callback, void* arg)
+{
+	for (uint32_t i = 0; i < PBS_FX_VOICES; i++)
+		voices[i].setStartCallback(callback, arg);
+}
@@ -0,0 +1,75 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PBSVoices.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __PBSVOICES_H__
+#define __PBSVOICES_H__
+
+#include <Arduino.h>
+#include "PBSMixer.h"
+
+// Players for the effect sounds of poly fonts
+#ifndef PBS_FX_VOICES
+#define PBS_FX_VOICES			4
+#endif
+
+typedef struct
+{
+	uint32_t allocations;
+	uint32_t steals;			// Voices taken from a sound still playing
+	uint32_t drops;				// Sounds not played, all voices had higher priority
+	uint32_t peak;				// Most voices playing at once
+} voiceStats;
+
+// A pool of players, so effects layer instead of cutting each other off. When all of them
+// are busy, the sound with the lowest priority is stopped to make room; among those, the
+// oldest one. Every voice plays at full volume, so the oldest is also the one closest to
+// its end. Sounds of higher priority than the new one are never stopped.
+class PBSVoices
+{
+public:
+	PBSVoices();
+	void begin(PBSMixer* mixer);
+
+	// Returns a free player for a sound of 'type', or NULL
+	PBSPlayer* allocate(uint8_t type, uint8_t priority);
+
+	bool playing();
+	bool playing(uint8_t type);
+	void stop();
+	void stop(uint8_t type);
+	void setStartCallback(playerStartCallback* callback, void* arg);
+
+	inline const voiceStats* getStats() { return &stats; }
+
+private:
+	PBSPlayer voices[PBS_FX_VOICES];
+	uint8_t types[PBS_FX_VOICES];
+	uint8_t priorities[PBS_FX_VOICES];
+	uint32_t order[PBS_FX_VOICES];		// Allocation order, to find the oldest
+	uint32_t counter;
+	voiceStats stats;
+};
+
+#endif /* __PBSVOICES_H__ */
@@ -24,6 +24,7 @@
 ***************************************************************************/
 
 #include "PBSaber.h"
+#include <math.h>
 
 static const float pulse_force_preset[5] = { 6, 4.5f, 4, 2.5f, 1 };
 static const uint32_t pulse_time_preset[5] = { 500, 100, 50, 40, 20 };
@@ -37,6 +38,84 @@ static const uint32_t transient_time_preset[5] = { 80, 70, 50, 20, 20 };
 
 #define STAB_REQUIRES (STAB_REQUIRES_CLASH)
 
+// Sounds kept in RAM, in order of preference. They are filled a file of each at a time, so
+// every type gets some of its files in when the cache is small.
+static const fontSoundType cached_sounds[] = { fontClash, fontBlaster, fontStab, fontSwing };
+#define CACHED_SOUNDS	(sizeof(cached_sounds) / sizeof(cached_sounds[0]))
+
+// Sounds picked and opened ahead of time, one per type. Index of armed_sounds.
+static const fontSoundType armed_types[PBS_ARMED_SOUNDS] =
+{
+	fontClash, fontSwing, fontBlaster, fontStab, fontSpin
+};
+
+// Priority of each fontSoundType on the effect voices. A sound only stops sounds of the
+// same or lower priority, when there isn't a free voice.
+static const uint8_t voice_priorities[fontMax] =
+{
+	5,	// fontBoot
+	6,	// fontIgnition
+	6,	// fontRetraction
+	6,	// fontLowPower
+	0,	// fontHum
+	3,	// fontBlaster
+	4,	// fontLock
+	1,	// fontSwing
+	3,	// fontClash
+	2,	// fontSpin
+	3,	// fontStab
+	4,	// fontForce
+	0,	// fontBackground
+	5,	// fontName
+	0,	// fontSwingLow
+	0,	// fontSwingHigh
+};
+
+// Utility sounds share the effect voices
+#define VOICE_UTILITY			fontMax
+#define VOICE_UTILITY_PRIORITY	5
+
+// Effects measured by the latency histograms. Index of PBSLatency types.
+static const saberStateId latency_states[PBS_LATENCY_TYPES] =
+{
+	stateIgnition, stateRetraction, stateBlaster, stateLockUp, stateClash, stateSwing,
+	stateSpin, stateStab, stateForce
+};
+
+static int32_t getLatencyType(saberStateId state)
+{
+	for (uint32_t i = 0; i < PBS_LATENCY_TYPES; i++)
+	{
+		if (latency_states[i] == state)
+			return i;
+	}
+
+	return -1;
+}
+
+static const uint32_t decimal_limits[9] =
+{
+	10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// Writes the number followed by ".wav" without going through printf. Returns the length.
+static uint32_t writeSoundNumber(char* dst, uint32_t value)
+{
+	uint32_t digits = 1;
+
+	for (uint32_t i = 0; i < 9; i++)
+		digits += (value >= decimal_limits[i]);
+
+	for (uint32_t i = digits; i > 0; i--)
+	{
+		dst[i - 1] = '0' + (value % 10);
+		value /= 10;
+	}
+
+	memcpy(dst + digits, ".wav", 5);
+	return digits + 4;
+}
+
 PBSaber::PBSaber()
 {
 	newStateCallback = NULL;
@@ -47,6 +126,48 @@ PBSaber::PBSaber()
 	spin_count = 0;
 	spinning = false;
 	possible_stab = false;
+	clash_time = swing_time = 0;
+	sound_path = "";
+	memset(utility_paths, 0, sizeof(utility_paths));
+
+	// Profile slots for the current, next and previous profiles
+	memset((void*) profile_slots, 0, sizeof(profile_slots));
+	current_profile = &profile_slots[0];
+	next_profile = &profile_slots[1];
+	prev_profile = &profile_slots[2];
+
+	// Font table, referenced by the profile slots
+	for (uint32_t i = 0; i < PBS_FONT_SLOTS; i++)
+		font_table[i].info.id = 0;
+
+	current_font = NULL;
+	prefetch_pending = false;
+	snapshot_pending = false;
+	boot_log_pending = false;
+	cache_pending = false;
+	cache_round = cache_type = 0;
+	arm_pending = false;
+	smooth_swing_on = swing_pair_on = false;
+	smooth_swing_time = smooth_swing_period = 0;
+
+	for (uint32_t i = 0; i < PBS_ARMED_SOUNDS; i++)
+	{
+		armed_sounds[i].font_id = 0;
+		armed_sounds[i].num = 0;
+		armed_sounds[i].picked = false;
+	}
+	boot_stage = bootFailed;
+	boot_phase = audio_phase = 0;
+	audio_init = 0;
+	config_file = NULL;
+
+	// Every player is mixed into the one source the sketch gives to the audio engine
+	PBSPlayer* players[] = { &hum1, &hum2, &monoFont1, &monoFont2, &music1, &music2,
+							 &swing_low, &swing_high };
+	for (uint32_t i = 0; i < sizeof(players) / sizeof(players[0]); i++)
+		mixer.add(players[i]);
+
+	voices.begin(&mixer);
 }
 
 bool PBSaber::begin(const char* config_file)
@@ -54,6 +175,11 @@ bool PBSaber::begin(const char* config_file)
 	if (initialized)
 		return true;
 
+	// Time every phase until the saber is ready
+	profileReset();
+	boot_phase = profileStart("boot");
+	PBS_PROFILE_SCOPE("begin");
+
 	// Initialize debug and print version
 	initDebug();
 	debugMsg(DebugInfo, "- PBSaber v%i.%i.%i -", PBSABER_VER_MAJOR,
@@ -81,61 +207,224 @@ bool PBSaber::begin(const char* config_file)
 		return false;
 	}
 
-	uint32_t audio_init = GetTickCount();
+	this->config_file = config_file;
+	audio_init = GetTickCount();
 
 	// Initialize audio
-	if (!Audio.begin(config.settings.audio_fs, 16, true))
+	uint32_t phase = profileStart("Audio.begin");
+	bool success = Audio.begin(config.settings.audio_fs, 16, true) && mixer.begin();
+	profileEnd(phase);
+
+	if (!success)
 	{
 		debugMsg(DebugError, "Audio initialization failed");
 		return false;
 	}
 
-	// Read the rest of the global configuration (hardware & settings)
-	if (!config.read())
-		return false;
+	// Run the stages that can fail while the audio codec settles. A failure stops the boot
+	// here, and begin() returns false.
+	for (boot_stage = bootSettings; boot_stage < bootAudio;
+		 boot_stage = (bootStage) (boot_stage + 1))
+	{
+		phase = profileStart(getBootStageName(boot_stage));
+		success = runBootStage(boot_stage);
+		profileEnd(phase);
 
-	// Get how many profiles there are in the configuration file. User can declare the quantity
-	// directly on the configuration file. If not, the mapping function of the configuration
-	// file will retrieve the (estimated) quantity.
-	first_profile = 1;
-	last_profile = config.settings.profile_count;
+		if (!success)
+		{
+			debugMsg(DebugError, "Boot failed at stage '%s'", getBootStageName(boot_stage));
+			boot_stage = bootFailed;
+			profileEnd(boot_phase);
+			profileStop();
+			profileDump();
+			return false;
+		}
 
-	save_initial_profile = false;
+		// The next and previous profiles are loaded once the blade is there, it's needed
+		// to update the strip while loading
+		if (boot_stage == bootBlade)
+			prefetch_pending = true;
+	}
 
-	// Check if the initial_profile is between the minimum and maximum profile number
-	if (config.settings.initial_profile < first_profile ||
-		config.settings.initial_profile > last_profile)
-	{
-		debugMsg(DebugWarning, "start_profile value (%i) is out of range (%i-%i). Using profile1",
-								config.settings.initial_profile, first_profile, last_profile);
+	// The rest of the wait for the audio codec is used from loop()
+	audio_phase = profileStart(getBootStageName(bootAudio));
+	return true;
+}
 
-		save_initial_profile = true;
-		config.settings.initial_profile = 1;
+const char* PBSaber::getBootStageName(bootStage stage)
+{
+	switch (stage)
+	{
+		case bootSettings:		return "settings";
+		case bootProfile:		return "profile";
+		case bootFont:			return "font";
+		case bootBlade:			return "blade";
+		case bootControls:		return "controls";
+		case bootAudio:			return "audio";
+		default: break;
 	}
 
-	// Try to load the profile
-	if (!config.loadProfile(config.settings.initial_profile, &current_profile))
+	return "";
+}
+
+bool PBSaber::runBootStage(bootStage stage)
+{
+	switch (stage)
 	{
-		debugMsg(DebugWarning, "Failed while reading profile%i", config.settings.initial_profile);
-		return false;
+		case bootSettings:
+			// Read the rest of the global configuration (hardware & settings)
+			if (!config.read())
+				return false;
+
+			// Restore the last used profile and volume. They are kept in a journal next
+			// to the configuration file, so the configuration file is never rewritten.
+			if (state.begin(config_file, config.settings.initial_profile,
+							config.settings.master_volume) && state.valid())
+			{
+				if (config.settings.update_initial_profile)
+					config.settings.initial_profile = state.getProfile();
+
+				config.settings.master_volume = state.getVolume();
+			}
+
+			// Get how many profiles there are in the configuration file. User can declare
+			// the quantity directly on the configuration file. If not, the mapping function
+			// of the configuration file will retrieve the (estimated) quantity.
+			first_profile = 1;
+			last_profile = config.settings.profile_count;
+
+			save_initial_profile = false;
+
+			// Check if the initial_profile is between the minimum and maximum profile number
+			if (config.settings.initial_profile < first_profile ||
+				config.settings.initial_profile > last_profile)
+			{
+				debugMsg(DebugWarning, "start_profile value (%i) is out of range (%i-%i). "
+									   "Using profile1", config.settings.initial_profile,
+									   first_profile, last_profile);
+
+				save_initial_profile = true;
+				config.settings.initial_profile = 1;
+			}
+
+			// The output is still muted, so the limiter can go in ahead of the first sound
+			if (config.settings.limiter)
+				mixer.beginLimiter(PBS_LIMITER_CEILING, PBS_LIMITER_LOOKAHEAD,
+								   PBS_LIMITER_RELEASE);
+
+			buildUtilityPaths();
+			return true;
+
+		case bootProfile:
+			// Try to load the profile
+			if (!config.loadProfile(config.settings.initial_profile, current_profile))
+			{
+				debugMsg(DebugWarning, "Failed while reading profile%i",
+						 config.settings.initial_profile);
+				return false;
+			}
+
+			return true;
+
+		case bootFont:
+			// Load its font into the font table, with the manifest of its sound files
+			current_font = loadFont(current_profile->font_num, current_profile);
+			if (!current_font)
+				return false;
+
+			startCache();
+			return true;
+
+		case bootBlade:
+			return initializeBlade();
+
+		case bootControls:
+			return initializeControls();
+
+		default: break;
 	}
 
-	// We can initialize the rest of the hardware
-	if (!initializeHardware())
+	return false;
+}
+
+void PBSaber::boot()
+{
+	if (boot_stage != bootAudio)
+		return;
+
+	// Use the time the audio codec takes to settle to load the neighbouring profiles
+	if (GetTickCount() - audio_init < PBS_AUDIO_SETTLE_TIME)
 	{
-		debugMsg(DebugError, "Failed while initializing hardware");
-		return false;
+		if (prefetch_pending)
+			prefetchProfiles();
+		else if (arm_pending)
+			armSounds();
+		else if (cache_pending)
+			fillCache();
+		return;
 	}
 
+	profileEnd(audio_phase);
+	boot_stage = bootReady;
+	bootDone();
+}
+
+void PBSaber::bootDone()
+{
+	// Set volume and unmute. The mixer applies the master volume, ahead of the limiter.
+	Audio.setVolume(0);
+	mixer.setVolume(config.settings.master_volume);
+	Audio.unmute();
+
+	debugMsg(DebugInfo, "Ready in %lu ms", GetTickCount() - audio_init);
+
+	// The boot profile keeps only the boot
+	profileEnd(boot_phase);
+	profileStop();
+
+	if (config.settings.dump_boot_info)
+		profileDump();
+
 	// Initiate audio objects pointers
 	hum = &hum1;
 	monoFont = &monoFont1;
 	music = &music1;
 
-	// Wait until audio initializes (it takes 900ms approximately).
-	uint32_t ticks = GetTickCount();
-	if (ticks - audio_init < 900)
-		delay(900 - (ticks - audio_init));
+	// Players report when they render their first samples, to measure the latency
+	PBSPlayer* players[] = { &hum1, &hum2, &music1, &music2 };
+	for (uint32_t i = 0; i < sizeof(players) / sizeof(players[0]); i++)
+		players[i]->setStartCallback(soundStartedStub, this);
+
+	voices.setStartCallback(soundStartedStub, this);
+
+	monoFont1.setStartCallback(soundStartedStub, this);
+	monoFont2.setStartCallback(soundStartedStub, this);
+
+	// SD reads go to the effects first, then to the hum, then to the music. Effect voices
+	// and the effects chained on mono fonts have the effect priority already.
+	PBSPlayer* hums[] = { &hum1, &hum2, &swing_low, &swing_high };
+	for (uint32_t i = 0; i < sizeof(hums) / sizeof(hums[0]); i++)
+		hums[i]->setPriority(streamHum);
+
+	monoFont1.setPriority(streamHum);
+	monoFont2.setPriority(streamHum);
+	music1.setPriority(streamMusic);
+	music2.setPriority(streamMusic);
+
+	// With hum_pitch the hum always goes through the resampler, so the pitch can move
+	// without a click
+	if (config.settings.hum_pitch)
+	{
+		hum1.setPitch(1.0f);
+		hum2.setPitch(1.0f);
+		monoFont1.setPitch(1.0f);
+		monoFont2.setPitch(1.0f);
+	}
+
+	// Write the configuration snapshot later, if outdated, so the next boot doesn't have
+	// to parse the configuration file. The boot profile is logged then too.
+	snapshot_pending = true;
+	boot_log_pending = strlen(config.settings.boot_log) != 0;
 
 	// Debug output timing
 	debug_ticks = GetTickCount();
@@ -145,18 +434,12 @@ bool PBSaber::begin(const char* config_file)
 	initialized = true;
 	play(fontBoot);
 	enterState(stateOff);
-	return true;
 }
 
-bool PBSaber::initializeHardware()
+bool PBSaber::initializeControls()
 {
-	debugMsg(DebugInfo, "Initializing hardware");
-
-	// Set volume
-	Audio.setVolume(config.settings.master_volume);
-
-	// Unmute
-	Audio.unmute();
+	debugMsg(DebugInfo, "Initializing accelerometer and buttons");
+	PBS_PROFILE_SCOPE("initializeControls");
 
 	// Initialize accelerometer
 	Motion.begin(8, 400, false);
@@ -222,6 +505,14 @@ bool PBSaber::initializeHardware()
 		config.hw.button_fx.button.setLongPressTime(config.settings.lock_time);
 	}
 
+	return true;
+}
+
+bool PBSaber::initializeBlade()
+{
+	debugMsg(DebugInfo, "Initializing blade");
+	PBS_PROFILE_SCOPE("initializeBlade");
+
 	// Initialize blade
 	bool success = false;
 	if (config.hw.blade_type == bladeHBLED)
@@ -246,15 +537,178 @@ bool PBSaber::initializeHardware()
 	return true;
 }
 
-void PBSaber::debugOutput()
+PBSPlayer* PBSaber::getVoice(uint8_t type)
+{
+	PBSPlayer* voice = voices.allocate(type, voice_priorities[type]);
+
+	if (!voice)
+		debugMsg(DebugInfo, "No voice for %s", current_font->info.files[type].filename);
+
+	return voice;
+}
+
+bool PBSaber::smoothSwingAvailable()
 {
+	// The pair plays along the hum player, so only poly fonts
+	return config.settings.dynamic_swing_depth && current_font->info.poly &&
+		   fontPresent(fontSwingLow) && fontPresent(fontSwingHigh);
+}
+
+bool PBSaber::smoothSwingState(saberStateId state)
+{
+	// The blade is on and the hum is at full volume
+	switch (state)
+	{
+		case stateIdleOn:
+		case stateBlaster:
+		case stateLockUp:
+		case stateClash:
+		case stateSwing:
+		case stateSpin:
+		case stateStab:
+		case stateForce:
+			return true;
+		default: break;
+	}
 
+	return false;
+}
+
+bool PBSaber::humFollowsMotion()
+{
+	// The pitch on any font. The filter is on the hum player of poly fonts only, as mono
+	// fonts play their effects on the same player.
+	return config.settings.hum_pitch || (config.settings.hum_filter && current_font->info.poly);
+}
+
+bool PBSaber::playSwingPair()
+{
+	swing_low.setVolume(0);
+	swing_high.setVolume(0);
+
+	if (!playSound(&swing_low, current_font, fontSwingLow, PlayModeLoop) ||
+		!playSound(&swing_high, current_font, fontSwingHigh, PlayModeLoop))
+	{
+		debugMsg(DebugError, "Error playing %s", sound_path);
+		swing_low.stop();
+		swing_high.stop();
+
+		// Don't try again with this font
+		current_font->info.files[fontSwingLow].present = false;
+		return false;
+	}
+
+	debugMsg(DebugInfo, "Smooth swing: %s, %s", current_font->paths[fontSwingLow].path,
+			 current_font->paths[fontSwingHigh].path);
+	return true;
+}
+
+void PBSaber::startSmoothSwing()
+{
+	// The pitch and the filter of the hum follow the motion even without the swing pair
+	swing_pair_on = smoothSwingAvailable() && playSwingPair();
+	if (!swing_pair_on && !humFollowsMotion())
+		return;
+
+	smooth_swing.begin(swing_pair_on ? config.settings.dynamic_swing_depth : 0,
+					   config.settings.hum_pitch);
+	smooth_swing_period = AUDIO_BLOCK_SAMPLES * 1000000UL / Audio.getSampleRate();
+	smooth_swing_time = micros();
+	smooth_swing_on = true;
+}
+
+void PBSaber::stopSmoothSwing()
+{
+	swing_low.stop();
+	swing_high.stop();
+
+	if (swing_pair_on)
+		hum->setVolume(1.0f);
+
+	hum->setPitch(1.0f);
+	monoFont->setPitch(1.0f);
+
+	if (config.settings.hum_filter && current_font->info.poly)
+		hum->setFilter(BiquadLowPass, config.settings.hum_filter, 0.707f,
+					   PBS_HUM_FILTER_CLOSE_MS);
+	smooth_swing_on = swing_pair_on = false;
+}
+
+void PBSaber::updateSmoothSwing()
+{
+	if (!smooth_swing_on)
+	{
+		if (smoothSwingState(curr_state) && (smoothSwingAvailable() || humFollowsMotion()))
+			startSmoothSwing();
+		return;
+	}
+
+	// Once per audio block, so the volumes change as often as the mixer can apply them
+	uint32_t elapsed = micros() - smooth_swing_time;
+	float x, y, z;
+
+	if (elapsed < smooth_swing_period)
+		return;
+
+	smooth_swing_time += elapsed;
+
+	if (!Motion.readAcceleration(&x, &y, &z))
+		return;
+
+	smooth_swing.update(x, y, z, elapsed);
+
+	if (swing_pair_on)
+	{
+		hum->setVolume(smooth_swing.getHumVolume());
+		swing_low.setVolume(smooth_swing.getLowVolume());
+		swing_high.setVolume(smooth_swing.getHighVolume());
+	}
+
+	// Mono fonts play the hum as the base track of their player
+	if (config.settings.hum_pitch)
+	{
+		if (current_font->info.poly)
+			hum->setPitch(smooth_swing.getHumPitch());
+		else
+			monoFont->setPitch(smooth_swing.getHumPitch());
+	}
+
+	// The filter opens up along this block
+	if (config.settings.hum_filter && current_font->info.poly)
+		hum->setFilter(BiquadLowPass, config.settings.hum_filter *
+					   smooth_swing.getFilterScale(), 0.707f, elapsed / 1000);
+}
+
+void PBSaber::debugOutput()
+{
+#if PBS_DEBUG
+	// Commands from the debug serial
+	while (PBS_DEBUG_SERIAL.available())
+	{
+		switch (PBS_DEBUG_SERIAL.read())
+		{
+			case 'b': dumpBootProfile();	break;
+			case 'l': dumpLatency();		break;
+			case 'v': dumpVoices();			break;
+			case 's': dumpStreams();		break;
+			case 'm': dumpLimiter();		break;
+			case 'r': latency.reset();		break;
+			default: break;
+		}
+	}
+#endif
 }
 
 void PBSaber::loop()
 {
+	// Read ahead for the sounds playing, before anything else takes the SD
+	mixer.service();
+
 	if (!initialized)
+	{
+		boot();
 		return;
+	}
 
 	// Update the blade
 	blade->update();
@@ -282,6 +736,46 @@ void PBSaber::loop()
 		default: break;
 	}
 
+	// Events that didn't start an effect are not measured
+	latency.drop();
+
+	updateSmoothSwing();
+
+	// Load the neighbouring profiles while the blade is off. Loading a font may have to
+	// build its manifest, which opens every sound file. Then write the configuration
+	// snapshot, if needed.
+	bool blade_off = curr_state == stateIdleOff || curr_state == stateOff;
+	if (curr_state == stateIdleOn || blade_off)
+	{
+		if (prefetch_pending && blade_off)
+		{
+			prefetchProfiles();
+		} else if (arm_pending)
+		{
+			armSounds();
+		} else if (cache_pending)
+		{
+			// Not while a cached sound may be playing
+			if (!voices.playing() && !monoFont1.playingChained() && !monoFont2.playingChained())
+				fillCache();
+		} else if (snapshot_pending && blade_off)
+		{
+			// A profile or a font per iteration
+			bool done;
+
+			if (!config.saveSnapshot(&done))
+				debugMsg(DebugWarning, "Configuration snapshot not available");
+
+			snapshot_pending = !done;
+		} else if (boot_log_pending)
+		{
+			if (!profileAppend(config.settings.boot_log))
+				debugMsg(DebugWarning, "Error writing boot log %s", config.settings.boot_log);
+
+			boot_log_pending = false;
+		}
+	}
+
 	if (GetTickCount() - debug_ticks >= debug_interval)
 	{
 		debug_ticks = GetTickCount();
@@ -292,6 +786,11 @@ void PBSaber::loop()
 void PBSaber::enterState(saberStateId state)
 {
 	debugMsg(DebugInfo, "Entering state: %s", getStateName(state));
+	latency.state(getLatencyType(state));
+
+	// Back to the hum alone, before the new state uses its volume
+	if (smooth_swing_on && !smoothSwingState(state))
+		stopSmoothSwing();
 
 	prev_state = curr_state;
 	curr_state = state;
@@ -331,60 +830,476 @@ bool PBSaber::loadProfile(uint32_t id, saberProfile* profile)
 	// interrupt. It has effect only if the blade type we are using is an LED strip.
 	blade->asyncUpdate();
 
-	bool ret = config.loadProfile(id, profile);
+	bool ret = config.loadProfile(id, profile) && loadFont(profile->font_num, profile);
 
 	blade->syncUpdate();
 	return ret;
 }
 
-bool PBSaber::loadNextProfile(saberProfile* profile)
+uint32_t PBSaber::getNextProfileId()
 {
-	// Load the next profile taking care of rolling back to the first profile
-	// if the maximum has been reached.
-	uint32_t id = current_profile.id + 1;
+	// Roll back to the first profile if the maximum has been reached
+	uint32_t id = current_profile->id + 1;
 
 	if (id > last_profile)
 		id = 1;
 
-	return loadProfile(id, profile);
+	return id;
 }
 
-bool PBSaber::loadPrevProfile(saberProfile* profile)
+uint32_t PBSaber::getPrevProfileId()
 {
-	// Load the previous profile taking care of loading the last profile in the list
-	// if the minimum has been reached.
-	uint32_t id = current_profile.id - 1;
+	// Go to the last profile in the list if the minimum has been reached
+	uint32_t id = current_profile->id - 1;
+
 	if (id == 0)
 		id = last_profile;
 
-	return loadProfile(id, profile);
+	return id;
 }
 
-void PBSaber::getSoundFileName(char* dst, fontInfo* font, fontSoundType type)
+bool PBSaber::loadProfileSlot(uint32_t id, saberProfile* slot)
 {
-	// Assemble the full path for the given fontSoundType
-	if (strlen(font->folder))
-		sprintf(dst, "%s\\%s", font->folder, font->files[type].filename);
+	// A slot is valid if it holds the profile with the requested ID
+	if (slot->id == id)
+		return true;
+
+	if (loadProfile(id, slot))
+		return true;
+
+	slot->id = 0;
+	return false;
+}
+
+saberFont* PBSaber::loadFont(uint32_t id, saberProfile* slot)
+{
+	saberFont* font = NULL;
+
+	// Profiles often share the font
+	for (uint32_t i = 0; i < PBS_FONT_SLOTS; i++)
+	{
+		if (font_table[i].info.id == id)
+			return &font_table[i];
+	}
+
+	// Take an entry that isn't used by the other profile slots
+	for (uint32_t i = 0; i < PBS_FONT_SLOTS && !font; i++)
+	{
+		bool used = false;
+
+		for (uint32_t j = 0; j < 3; j++)
+		{
+			saberProfile* profile = &profile_slots[j];
+			if (profile != slot && profile->id && profile->font_num == font_table[i].info.id)
+				used = true;
+		}
+
+		if (!used)
+			font = &font_table[i];
+	}
+
+	if (!font)
+		return NULL;
+
+	// Load it, with the manifest of its sound files
+	if (!config.loadFontInfo(id, &font->info) || !font->manifest.load(&font->info))
+	{
+		debugMsg(DebugError, "Error loading font%lu", id);
+		font->info.id = 0;
+		return NULL;
+	}
+
+	buildSoundPaths(font);
+
+	if (strlen(font->info.title))
+		debugMsg(DebugInfo, "Using font %s", font->info.title);
 	else
-		sprintf(dst, "%s", font->files[type].filename);
+		debugMsg(DebugInfo, "Using font %i", font->info.id);
+
+	return font;
+}
+
+saberFont* PBSaber::getFont(saberProfile* profile)
+{
+	// Fonts of loaded profiles are always in the table
+	for (uint32_t i = 0; i < PBS_FONT_SLOTS; i++)
+	{
+		if (font_table[i].info.id == profile->font_num)
+			return &font_table[i];
+	}
+
+	return NULL;
+}
+
+saberProfile* PBSaber::loadNextProfile()
+{
+	// Normally it has been prefetched, otherwise load it now
+	if (!loadProfileSlot(getNextProfileId(), next_profile))
+		return NULL;
+
+	return next_profile;
+}
 
-	// Random files do not need the extension. TODO support other extensions.
-	if (!font->files[type].random)
-		strcat(dst, ".wav");
+saberProfile* PBSaber::loadPrevProfile()
+{
+	if (!loadProfileSlot(getPrevProfileId(), prev_profile))
+		return NULL;
+
+	return prev_profile;
 }
 
-void PBSaber::getSpinFileName(char* dst, fontInfo* font, uint32_t num)
+void PBSaber::prefetchProfiles()
 {
-	char file_num[32];
-	getSoundFileName(dst, font, fontSpin);
+	// Load one profile per call, so the loop is not stalled for long
+	if (next_profile->id != getNextProfileId())
+	{
+		loadProfileSlot(getNextProfileId(), next_profile);
+		return;
+	}
+
+	if (prev_profile->id != getPrevProfileId())
+		loadProfileSlot(getPrevProfileId(), prev_profile);
+
+	// Both done (or failed). Don't retry until the next profile change.
+	prefetch_pending = false;
+}
 
-	if (font->files[fontSpin].random)
+void PBSaber::buildSoundPaths(saberFont* font)
+{
+	// Assemble the full path of every fontSoundType, so play() doesn't have to
+	for (uint32_t i = 0; i < fontMax; i++)
 	{
-		sprintf(file_num, "%lu", num);
-		strcat(dst, file_num);
+		fontSoundPath* dst = &font->paths[i];
+		fontSoundFile* file = &font->info.files[i];
+		uint32_t len;
+
+		if (strlen(font->info.folder))
+			len = snprintf(dst->path, sizeof(dst->path), "%s\\%s", font->info.folder,
+						   file->filename);
+		else
+			len = snprintf(dst->path, sizeof(dst->path), "%s", file->filename);
+
+		// Random files get the number and the extension when played. TODO support other
+		// extensions.
+		dst->suffix = (uint8_t) len;
+		if (!file->random)
+			strcat(dst->path, ".wav");
 	}
 
-	strcat(dst, ".wav");
+	// Sounds of packed fonts are all played from the pack, if the manifest was built from
+	// its index. The paths above are still built, they name the sounds in messages.
+	font->pack[0] = 0;
+	if (font->manifest.packed())
+		PBSConfig::getPackPath(&font->info, font->pack, sizeof(font->pack));
+}
+
+void PBSaber::buildUtilityPaths()
+{
+	memset(utility_paths, 0, sizeof(utility_paths));
+
+	if (!strlen(config.settings.sound_utils))
+	{
+		debugMsg(DebugWarning, "Utility sounds folder not configured");
+		return;
+	}
+
+	snprintf(utility_paths[sndutilBeep], PBS_SOUND_PATH_LEN, "%s\\beep.wav",
+			 config.settings.sound_utils);
+}
+
+const char* PBSaber::getSound(saberFont* font, fontSoundType type,
+							  const AudioTrackInfo** info, int32_t num)
+{
+	// Get the path of the sound file and where its audio data is, from the font manifest.
+	// For random sounds a number is picked among the files that exist, unless one is given.
+	PBSManifest* manifest = &font->manifest;
+	fontSoundFile* file = &font->info.files[type];
+	fontSoundPath* path = &font->paths[type];
+	const fontManifestEntry* entry;
+	uint32_t n = 0;
+
+	if (file->random)
+	{
+		n = (uint32_t) num;
+
+		if (num < 0 && !manifest->pickRandom(type, &n))
+			n = getRandom(file->min, file->max);
+
+		writeSoundNumber(path->path + path->suffix, n);
+	}
+
+	entry = manifest->getEntry(type, n);
+	sound_path = path->path;
+
+	const char* file_path = strlen(font->pack) ? font->pack : sound_path;
+
+	// Already in RAM
+	const AudioTrackInfo* cached = cache.find(font->info.id, type, n);
+	if (cached)
+	{
+		*info = cached;
+		return file_path;
+	}
+
+	// Sounds that didn't fit in the manifest are played parsing the file. Packed fonts
+	// have nothing to parse.
+	if (!entry && (manifest->indexed(type) || strlen(font->pack)))
+	{
+		debugMsg(DebugError, "Missing sound file %s", sound_path);
+		return NULL;
+	}
+
+	*info = entry ? &entry->track : NULL;
+	return file_path;
+}
+
+void PBSaber::soundFilesChanged(saberFont* font)
+{
+	font->manifest.invalidate();
+	cache.flush(font->info.id);
+
+	for (uint32_t i = 0; i < PBS_ARMED_SOUNDS; i++)
+	{
+		if (armed_sounds[i].font_id == font->info.id)
+			disarmSound(&armed_sounds[i]);
+	}
+}
+
+void PBSaber::disarmSound(saberArmedSound* armed)
+{
+	armed->track.release();
+	armed->picked = false;
+	arm_pending = true;
+}
+
+saberArmedSound* PBSaber::getArmedSound(fontSoundType type)
+{
+	for (uint32_t i = 0; i < PBS_ARMED_SOUNDS; i++)
+	{
+		if (armed_types[i] == type)
+			return &armed_sounds[i];
+	}
+
+	return NULL;
+}
+
+saberArmedSound* PBSaber::takeArmedSound(saberFont* font, fontSoundType type, int32_t* num)
+{
+	// Use the sound picked ahead of time, if it was picked for this font and it's the one
+	// asked for. Returns it if its file is open, otherwise the number is just used to get
+	// it from the cache.
+	saberArmedSound* armed = getArmedSound(type);
+	bool random = font->info.files[type].random;
+
+	if (!armed || !armed->picked || armed->font_id != font->info.id)
+		return NULL;
+
+	if (random && *num >= 0 && (uint32_t) *num != armed->num)
+		return NULL;
+
+	if (random)
+		*num = armed->num;
+
+	// Pick another one from the loop
+	armed->picked = false;
+	arm_pending = true;
+
+	if (!armed->track.ready())
+		return NULL;
+
+	// Files of packed fonts are all the same, use the name of the sound
+	fontSoundPath* path = &font->paths[type];
+	if (random)
+		writeSoundNumber(path->path + path->suffix, armed->num);
+
+	sound_path = path->path;
+	return armed;
+}
+
+bool PBSaber::peekArmedSound(fontSoundType type, uint32_t* num)
+{
+	saberArmedSound* armed = getArmedSound(type);
+
+	if (!armed || !armed->picked || armed->font_id != current_font->info.id)
+		return false;
+
+	*num = armed->num;
+	return true;
+}
+
+void PBSaber::armSounds()
+{
+	// Picks the next file of a sound type and opens it, unless it's in the cache. One file
+	// per call, from the loop.
+	for (uint32_t i = 0; i < PBS_ARMED_SOUNDS; i++)
+	{
+		saberArmedSound* armed = &armed_sounds[i];
+		fontSoundType type = armed_types[i];
+		fontSoundFile* file = &current_font->info.files[type];
+		const AudioTrackInfo* info;
+		uint32_t num = 0;
+
+		if (!file->present || (armed->picked && armed->font_id == current_font->info.id))
+			continue;
+
+		armed->track.release();
+
+		// The spin sound sticks to the same file while spinning
+		if (type == fontSpin && spinning)
+			num = spin_num;
+		else if (file->random && !current_font->manifest.pickRandom(type, &num))
+			num = getRandom(file->min, file->max);
+
+		const char* path = getSound(current_font, type, &info, num);
+		if (!path)
+			continue;
+
+		armed->font_id = current_font->info.id;
+		armed->num = num;
+		armed->picked = true;
+
+		// Sounds not in the manifest are parsed when played
+		if (info && !info->data && !armed->track.prepare(path, info))
+			debugMsg(DebugWarning, "Error opening %s", path);
+
+		return;
+	}
+
+	arm_pending = false;
+}
+
+void PBSaber::startCache()
+{
+	// The sounds picked for the previous font are not good anymore
+	for (uint32_t i = 0; i < PBS_ARMED_SOUNDS; i++)
+	{
+		if (armed_sounds[i].font_id != current_font->info.id)
+			disarmSound(&armed_sounds[i]);
+	}
+
+	arm_pending = true;
+	cache.pin(current_font->info.id);
+	cache_round = cache_type = 0;
+	cache_pending = true;
+}
+
+void PBSaber::fillCache()
+{
+	// Caches the next file of the current font. It reads a chunk of a file per call, from
+	// the loop.
+	uint32_t rounds = 0;
+
+	if (cache.loading())
+	{
+		cache.load();
+		return;
+	}
+
+	for (uint32_t i = 0; i < CACHED_SOUNDS; i++)
+	{
+		fontSoundFile* file = &current_font->info.files[cached_sounds[i]];
+		uint32_t count = file->random ? file->max - file->min + 1 : 1;
+
+		if (file->present && count > rounds)
+			rounds = count;
+	}
+
+	for (; cache_round < rounds; cache_round++, cache_type = 0)
+	{
+		for (; cache_type < CACHED_SOUNDS; cache_type++)
+		{
+			fontSoundType type = cached_sounds[cache_type];
+			fontSoundFile* file = &current_font->info.files[type];
+			const AudioTrackInfo* info;
+			uint32_t num = 0;
+
+			if (!file->present || cache_round >= (file->random ? file->max - file->min + 1 : 1))
+				continue;
+
+			if (file->random)
+				num = file->min + cache_round;
+
+			const char* path = getSound(current_font, type, &info, num);
+			if (!path || !info || info->data)
+				continue;
+
+			// Files that don't fit are left on the SD. One file per call either way.
+			cache_type++;
+			cache.add(current_font->info.id, type, num, path, info);
+			return;
+		}
+	}
+
+	debugMsg(DebugInfo, "Sample cache: %lu files, %lu bytes", cache.getCount(), cache.getUsed());
+	cache_pending = false;
+}
+
+bool PBSaber::playSound(PBSPlayer* player, saberFont* font, fontSoundType type,
+						PlayMode mode, int32_t num)
+{
+	const AudioTrackInfo* info;
+
+	saberArmedSound* armed = takeArmedSound(font, type, &num);
+	if (armed && player->play(&armed->track, mode))
+		return true;
+
+	const char* path = getSound(font, type, &info, num);
+
+	if (!path)
+		return false;
+
+	if (player->play(path, info, mode))
+		return true;
+
+	// The file has changed since the manifest was built, if it plays parsing its header.
+	// Running out of stream buffers is not a reason to drop the manifest.
+	if (!info || !player->play(path, mode))
+		return false;
+
+	soundFilesChanged(font);
+	return true;
+}
+
+bool PBSaber::chainSound(PBSChainPlayer* player, saberFont* font, fontSoundType type,
+						 PlayMode mode, int32_t num)
+{
+	const AudioTrackInfo* info;
+
+	saberArmedSound* armed = takeArmedSound(font, type, &num);
+	if (armed && player->chain(&armed->track, mode))
+		return true;
+
+	const char* path = getSound(font, type, &info, num);
+
+	if (!path)
+		return false;
+
+	if (player->chain(path, info, mode))
+		return true;
+
+	if (!info || !player->chain(path, mode))
+		return false;
+
+	soundFilesChanged(font);
+	return true;
+}
+
+bool PBSaber::beginSound(PBSChainPlayer* player, saberFont* font, fontSoundType type)
+{
+	const AudioTrackInfo* info;
+	const char* path = getSound(font, type, &info);
+
+	if (!path)
+		return false;
+
+	if (player->begin(path, info))
+		return true;
+
+	if (!info || !player->begin(path))
+		return false;
+
+	soundFilesChanged(font);
+	return true;
 }
 
 bool PBSaber::play(fontSoundType type, PlayMode mode)
@@ -395,41 +1310,34 @@ bool PBSaber::play(fontSoundType type, PlayMode mode)
 	bool ret = false;
 
 	// We already know whether the requested fontSoundType is present
-	if (!current_profile.font.files[type].present)
+	if (!current_font->info.files[type].present)
 	{
 		debugMsg(DebugError, "The requested font type is not present");
 		return false;
 	}
 
+	latency.play();
 	current_sound_start = 0;
 	current_sound_duration = 0;
 
-	// 'Name' and 'boot' sounds are played with the "fx" player in any "poly" or "mono" case
+	// 'Name' and 'boot' sounds are played with an effect voice in any "poly" or "mono" case
 	if (type == fontName || type == fontBoot)
 	{
-		// Get the full path
-		getSoundFileName(tmp, &current_profile.font, type);
+		PBSPlayer* voice = getVoice(type);
+		if (!voice)
+			return false;
 
-		// Random?
-		if (current_profile.font.files[type].random)
-		{
-			ret = fx.playRandom(tmp,
-								current_profile.font.files[type].min,
-								current_profile.font.files[type].max,
-								mode);
-		} else {
-			ret = fx.play(tmp, mode);
-		}
+		ret = playSound(voice, current_font, type, mode);
 
 		if (ret)
 		{
-			debugMsg(DebugInfo, "Playing %s", fx.getFileName());
+			debugMsg(DebugInfo, "Playing %s", sound_path);
 
 			// Remember start time and duration
 			current_sound_start = GetTickCount();
-			current_sound_duration = fx.duration();
+			current_sound_duration = voice->duration();
 		} else {
-			debugMsg(DebugError, "Error playing %s", fx.getFileName());
+			debugMsg(DebugError, "Error playing %s", sound_path);
 		}
 
 		return ret;
@@ -437,34 +1345,21 @@ bool PBSaber::play(fontSoundType type, PlayMode mode)
 
 	// Special case for ignition sound on mono fonts. We use a chained player, and we need
 	// to first initialize the main track (hum) and then chain the ignition sound.
-	if (type == fontIgnition && !current_profile.font.poly)
+	if (type == fontIgnition && !current_font->info.poly)
 	{
-		// Get the full path for the hum sound
-		getSoundFileName(tmp, &current_profile.font, fontHum);
-
 		// Prepare the main track
-		if (!monoFont->begin(tmp))
+		if (!beginSound(monoFont, current_font, fontHum))
 		{
-			debugMsg(DebugError, "Error playing %s", tmp);
+			debugMsg(DebugError, "Error playing %s", sound_path);
 			return false;
 		}
 
-		debugMsg(DebugInfo, "Mono font: main track = %s", tmp);
-
-		// Get the full path for the ignition sound
-		getSoundFileName(tmp, &current_profile.font, type);
+		debugMsg(DebugInfo, "Mono font: main track = %s", sound_path);
 
 		// Chain the ignition sound
-		if (current_profile.font.files[type].random)
-			ret = monoFont->chainRandom(tmp,
-										current_profile.font.files[type].min,
-										current_profile.font.files[type].max, mode);
-		else
-			ret = monoFont->chain(tmp, mode);
-
-		if (!ret)
+		if (!chainSound(monoFont, current_font, type, mode))
 		{
-			debugMsg(DebugError, "Error playing %s", monoFont->getChainedFileName());
+			debugMsg(DebugError, "Error playing %s", sound_path);
 			monoFont->stop();
 			return false;
 		}
@@ -485,58 +1380,50 @@ bool PBSaber::play(fontSoundType type, PlayMode mode)
 	}
 
 	// Special case for HUM sound on poly fonts, that is played on its dedicated player
-	if (type == fontHum && current_profile.font.poly)
+	if (type == fontHum && current_font->info.poly)
 	{
-		getSoundFileName(tmp, &current_profile.font, type);
-		ret = hum->play(tmp, PlayModeLoop);
+		ret = playSound(hum, current_font, type, PlayModeLoop);
 		if (ret)
 		{
-			debugMsg(DebugInfo, "Playing %s", tmp);
+			debugMsg(DebugInfo, "Playing %s", sound_path);
 			current_sound_start = GetTickCount();
 			current_sound_duration = hum->duration();
 		} else {
-			debugMsg(DebugError, "Error playing %s", tmp);
+			debugMsg(DebugError, "Error playing %s", sound_path);
 		}
 
 		return ret;
 	}
 
 	// Special case for ignition sound on poly fonts:
-	// Start playing ignition of the fx player, together with the hum on the hum player,
-	// but with volume = 0. Increase hum volume in pollStateIgnition().
-	if (type == fontIgnition && current_profile.font.poly)
+	// Start playing ignition on an effect voice, together with the hum on the hum player,
+	// but with volume = 0. The hum volume is ramped up in enterStateIgnition().
+	if (type == fontIgnition && current_font->info.poly)
 	{
-		// Get the full path for the hum sound
-		getSoundFileName(tmp, &current_profile.font, fontHum);
+		PBSPlayer* voice = getVoice(type);
+		if (!voice)
+			return false;
 
 		// Set the hum sound volume to zero
 		hum->setVolume(0);
 
 		// Start playing the hum
-		ret = hum->play(tmp, PlayModeLoop);
+		ret = playSound(hum, current_font, fontHum, PlayModeLoop);
 		if (!ret)
 			return ret;
 
-		debugMsg(DebugInfo, "Playing %s", tmp);
-
-		// Get the full path for the ignition sound
-		getSoundFileName(tmp, &current_profile.font, type);
+		debugMsg(DebugInfo, "Playing %s", sound_path);
 
 		// Play the ignition sound
-		if (current_profile.font.files[type].random)
-			ret = fx.playRandom(tmp, current_profile.font.files[type].min,
-									 current_profile.font.files[type].max);
-		else
-			ret = fx.play(tmp);
+		ret = playSound(voice, current_font, type);
 
 		if (ret)
 		{
-			debugMsg(DebugInfo, "Playing %s", fx.getFileName());
+			debugMsg(DebugInfo, "Playing %s", sound_path);
 			current_sound_start = GetTickCount();
-			current_sound_duration = fx.duration();
-			volumeCounter.startTimeoutCounter(40);
+			current_sound_duration = voice->duration();
 		} else {
-			debugMsg(DebugError, "Error playing %s", fx.getFileName());
+			debugMsg(DebugError, "Error playing %s", sound_path);
 			hum->stop();
 		}
 
@@ -544,42 +1431,36 @@ bool PBSaber::play(fontSoundType type, PlayMode mode)
 	}
 
 	// Special case for retraction sound on poly fonts:
-	// Hum is already playing, so we start to play the retraction sound on the fx player and
-	// volume for the hum sound get decreased until 0 in pollStateRetraction().
-	if (type == fontRetraction && current_profile.font.poly)
+	// Hum is already playing, so we start to play the retraction sound on an effect voice and
+	// the hum volume is ramped down to 0 in enterStateRetraction().
+	if (type == fontRetraction && current_font->info.poly)
 	{
-		// Get the full path for the retraction sound
-		getSoundFileName(tmp, &current_profile.font, type);
+		PBSPlayer* voice = getVoice(type);
+		if (!voice)
+			return false;
 
-		// Play the ignition sound
-		if (current_profile.font.files[type].random)
-			ret = fx.playRandom(tmp, current_profile.font.files[type].min,
-									 current_profile.font.files[type].max);
-		else
-			ret = fx.play(tmp);
+		// Play the retraction sound
+		ret = playSound(voice, current_font, type);
 
 		if (ret)
 		{
-			debugMsg(DebugInfo, "Playing %s", fx.getFileName());
-			volumeCounter.startTimeoutCounter(40);
+			debugMsg(DebugInfo, "Playing %s", sound_path);
 			current_sound_start = GetTickCount();
-			current_sound_duration = fx.duration();
+			current_sound_duration = voice->duration();
 		}
 
 		return ret;
 	} else if (type == fontBackground)
 	{
 		// Background is played with the music player
-		getSoundFileName(tmp, &current_profile.font, type);
-
-		ret = music->play(tmp, mode);
+		ret = playSound(music, current_font, type, mode);
 		if (ret)
 		{
-			debugMsg(DebugInfo, "Playing %s", tmp);
+			debugMsg(DebugInfo, "Playing %s", sound_path);
 			current_sound_start = GetTickCount();
-			current_sound_duration = fx.duration();
+			current_sound_duration = music->duration();
 		} else {
-			debugMsg(DebugError, "Error playing %s", tmp);
+			debugMsg(DebugError, "Error playing %s", sound_path);
 		}
 
 		return ret;
@@ -588,25 +1469,28 @@ bool PBSaber::play(fontSoundType type, PlayMode mode)
 	// Spin sound number gets selected at the moment of spin-lock detection
 	if (type == fontSpin)
 	{
-		getSpinFileName(tmp, &current_profile.font, spin_num);
-		if (current_profile.font.poly)
+		if (current_font->info.poly)
 		{
-			ret = monoFont->chain(tmp);
+			ret = chainSound(monoFont, current_font, type, PlayModeNormal, spin_num);
 			if (ret)
 			{
 				current_sound_duration = monoFont->getChainedDuration();
 				debugMsg(DebugInfo, "Mono font: chained track = %s", monoFont->getChainedFileName());
 			} else {
-				debugMsg(DebugError, "Error playing %s", monoFont->getChainedFileName());
+				debugMsg(DebugError, "Error playing %s", sound_path);
 			}
 		} else {
-			ret = fx.play(tmp);
+			PBSPlayer* voice = getVoice(type);
+			if (!voice)
+				return false;
+
+			ret = playSound(voice, current_font, type, PlayModeNormal, spin_num);
 			if (ret)
 			{
-				current_sound_duration = fx.duration();
-				debugMsg(DebugInfo, "Playing %s", fx.getFileName());
+				current_sound_duration = voice->duration();
+				debugMsg(DebugInfo, "Playing %s", sound_path);
 			} else {
-				debugMsg(DebugError, "Error playing %s", fx.getFileName());
+				debugMsg(DebugError, "Error playing %s", sound_path);
 			}
 		}
 
@@ -617,38 +1501,30 @@ bool PBSaber::play(fontSoundType type, PlayMode mode)
 	}
 
 	// Any other sound is played in their respective players
-	getSoundFileName(tmp, &current_profile.font, type);
-
-	if (current_profile.font.poly)
+	if (current_font->info.poly)
 	{
-		if (current_profile.font.files[type].random)
-			ret = fx.playRandom(tmp, current_profile.font.files[type].min,
-									 current_profile.font.files[type].max,
-									 mode);
-		else
-			ret = fx.play(tmp, mode);
+		PBSPlayer* voice = getVoice(type);
+		if (!voice)
+			return false;
+
+		ret = playSound(voice, current_font, type, mode);
 
 		if (ret)
 		{
-			debugMsg(DebugInfo, "Playing %s", fx.getFileName());
-			current_sound_duration = fx.duration();
+			debugMsg(DebugInfo, "Playing %s", sound_path);
+			current_sound_duration = voice->duration();
 		} else {
-			debugMsg(DebugError, "Error playing %s", fx.getFileName());
+			debugMsg(DebugError, "Error playing %s", sound_path);
 		}
 	} else {
-		if (current_profile.font.files[type].random)
-			ret = monoFont->chainRandom(tmp,
-										current_profile.font.files[type].min,
-										current_profile.font.files[type].max, mode);
-		else
-			ret = monoFont->chain(tmp, mode);
+		ret = chainSound(monoFont, current_font, type, mode);
 
 		if (ret)
 		{
 			debugMsg(DebugInfo, "Mono font: chained track = %s", monoFont->getChainedFileName());
 			current_sound_duration = monoFont->getChainedDuration();
 		} else {
-			debugMsg(DebugError, "Error playing %s", monoFont->getChainedFileName());
+			debugMsg(DebugError, "Error playing %s", sound_path);
 		}
 	}
 
@@ -691,10 +1567,10 @@ void PBSaber::enterStateOff()
 	{
 		if (config.settings.update_initial_profile)
 		{
-			if (config.saveInitialProfile(current_profile.id))
-				debugMsg(DebugInfo, "Updated initial_profile = %lu", current_profile.id);
+			if (state.save(current_profile->id, config.settings.master_volume))
+				debugMsg(DebugInfo, "Saved initial profile = %lu", current_profile->id);
 			else
-				debugMsg(DebugError, "Error updating initial_profile");
+				debugMsg(DebugError, "Error saving initial profile");
 		}
 
 		save_initial_profile = false;
@@ -726,13 +1602,13 @@ void PBSaber::pollStateIdleOff()
 	PropButton* onButton = getButton(buttonOnOff);
 	PropButton* fxButton = getButton(buttonFx);
 
-	ButtonEvent event = onButton->getEvent();
+	ButtonEvent event = getButtonEvent(onButton);
 
 	// Short press-and-release is common for both single or dual button configurations
 	if (event == ButtonShortPressAndRelease)
 	{
 		// Check if the profile has background music
-		if (current_profile.font.files[fontBackground].present)
+		if (current_font->info.files[fontBackground].present)
 			// Then jump to the Music state
 			enterState(stateMusic);
 		else
@@ -748,7 +1624,7 @@ void PBSaber::pollStateIdleOff()
 	if (fxButton)
 	{
 		// Saber has an FX button
-		event = fxButton->getEvent();
+		event = getButtonEvent(fxButton);
 
 		// Monitor Next Profile sequence
 		if (event == ButtonShortPressAndRelease)
@@ -806,20 +1682,30 @@ void PBSaber::enterStateIgnition()
 	}
 
 	// Update shimmer
-	blade->setShimmerMode(&current_profile.shimmer);
+	blade->setShimmerMode(&current_profile->shimmer);
 
 	// Start ignition LED effect
-	uint32_t duration = current_profile.ignition_duration;
+	uint32_t duration = current_profile->ignition_duration;
 	if (!duration)
 		duration = current_sound_duration;
-	blade->onIgnition(current_profile.ignition_mode, duration);
+	blade->onIgnition(current_profile->ignition_mode, duration);
 
 	// Remember the current profile
-	profile_at_ignition = current_profile.id;
+	profile_at_ignition = current_profile->id;
+
+	// If it is a poly font, bring the hum up to 1 along the ignition sound
+	if (current_font->info.poly)
+	{
+		hum->rampVolume(1.0f, current_sound_duration);
+
+		if (config.settings.hum_filter)
+			hum->setFilter(BiquadLowPass, config.settings.hum_filter);
+	}
 
-	// If it is a poly font, set a counter to increment the hum volume every 40ms up to 1
-	if (current_profile.font.poly)
-		volumeCounter.startTimeoutCounter(40);
+	// The background music goes muffled while the blade is on
+	if (config.settings.music_filter && music->playing())
+		music->setFilter(BiquadLowPass, config.settings.music_filter, 0.707f,
+						 current_sound_duration);
 }
 
 void PBSaber::pollStateIgnition()
@@ -831,28 +1717,9 @@ void PBSaber::pollStateIgnition()
 	ready = onButton->released();
 
 	// Wait for all "ignition" audio to end
-	if (current_profile.font.poly)
+	if (current_font->info.poly)
 	{
-		volatile float volume = hum->getVolume();
-		if (volume == 1)
-		{
-			ready &= true;
-		} else {
-			ready = false;
-
-			// Increment the hum volume up to 1, each 40ms
-			if (volumeCounter.timeout())
-			{
-				volumeCounter.startTimeoutCounter(40);
-				float step = 1.0f / (current_sound_duration / 40);
-				volume += step;
-				if (volume > 1)
-					volume = 1;
-				hum->setVolume(volume);
-			}
-		}
-
-		if (fx.playing())
+		if (hum->ramping() || voices.playing(fontIgnition))
 			ready = false;
 	} else {
 		if (monoFont->playingChained())
@@ -882,7 +1749,7 @@ void PBSaber::handleButtonsEvents()
 	PropButton* onButton = getButton(buttonOnOff);
 	PropButton* fxButton = getButton(buttonFx);
 	ButtonEvent event;
-	event = onButton->getEvent();
+	event = getButtonEvent(onButton);
 
 	// On/Off button long-pressed. This event is valid for both with and without FX button sabers
 	if (event == ButtonLongPressed)
@@ -904,7 +1771,7 @@ void PBSaber::handleButtonsEvents()
 		}
 
 		// Check events for the FX button
-		event = fxButton->getEvent();
+		event = getButtonEvent(fxButton);
 
 		// Blaster effect
 		if (event == ButtonShortPressAndRelease && fontPresent(fontBlaster))
@@ -957,6 +1824,7 @@ void PBSaber::handleMotionEvents()
 	if (event_clash)
 	{
 		event_clash = false;
+		latency.event(clash_time);
 
 		// If got here it means we aren't spinning anymore
 		spin_count = 0;
@@ -1027,6 +1895,7 @@ void PBSaber::handleMotionEvents()
 	if (event_swing)
 	{
 		event_swing = false;
+		latency.event(swing_time);
 
 		// If the event happened only on negative X axis, then it may be a stab
 		uint8_t transient_src = Motion.getTransientSource();
@@ -1092,10 +1961,12 @@ void PBSaber::handleMotionEvents()
 						spinning = true;
 						spin_count = 0;
 
-						// Pick a font file number and stick with it
-						if (current_profile.font.files[fontSpin].random)
-							spin_num = getRandom(current_profile.font.files[fontSpin].min,
-										 current_profile.font.files[fontSpin].max);
+						// Pick a font file number and stick with it. Take the one opened
+						// ahead of time, if any.
+						if (current_font->info.files[fontSpin].random &&
+							!peekArmedSound(fontSpin, &spin_num))
+							spin_num = getRandom(current_font->info.files[fontSpin].min,
+										 current_font->info.files[fontSpin].max);
 
 						spin = true;
 						debugMsg(DebugInfo, "Spinning");
@@ -1142,8 +2013,8 @@ void PBSaber::handleMotionEvents()
 				}
 			}
 
-			// Normal swings
-			if (fontPresent(fontSwing))
+			// Normal swings. With the smooth swing pair the swing sounds are always playing.
+			if (fontPresent(fontSwing) && !swing_pair_on)
 			{
 				swing_counter.startTimeoutCounter(config.settings.swing_limiter);
 				enterState(stateSwing);
@@ -1167,14 +2038,14 @@ void PBSaber::enterStateRetraction()
 	if (play(fontRetraction))
 	{
 		// Start blade retraction effect
-		uint32_t duration = current_profile.retraction_duration;
+		uint32_t duration = current_profile->retraction_duration;
 		if (!duration)
 			duration = current_sound_duration;
 
-		blade->onRetraction(current_profile.retraction_mode, duration);
+		blade->onRetraction(current_profile->retraction_mode, duration);
 
-		if (current_profile.font.poly)
-			volumeCounter.startTimeoutCounter(40);
+		if (current_font->info.poly)
+			hum->rampVolume(0, current_sound_duration);
 	} else {
 		enterState(stateOff);
 	}
@@ -1189,29 +2060,14 @@ void PBSaber::pollStateRetraction()
 	ready = onButton->released();
 
 	// Wait for all "ignition" audio to end
-	if (current_profile.font.poly)
+	if (current_font->info.poly)
 	{
-		float volume = hum->getVolume();
-		if (volume == 0)
-		{
-			ready &= true;
-			hum->stop();
-		} else {
+		if (hum->ramping())
 			ready = false;
+		else
+			hum->stop();
 
-			// Decrement the hum volume down to 0, each 40ms
-			if (volumeCounter.timeout())
-			{
-				volumeCounter.startTimeoutCounter(40);
-				float step = 1.0f / (current_sound_duration / 40);
-				volume -= step;
-				if (volume < 0)
-					volume = 0;
-				hum->setVolume(volume);
-			}
-		}
-
-		if (fx.playing())
+		if (voices.playing(fontRetraction))
 			ready = false;
 	} else {
 		if (monoFont->playingChained())
@@ -1231,11 +2087,11 @@ void PBSaber::enterStateLock()
 	{
 		if (onEffectCallback)
 		{
-			bladeEffect userEffect = current_profile.lockup;
+			bladeEffect userEffect = current_profile->lockup;
 			notifyEffectToUser(userEffect);
 			blade->startLockup(&userEffect);
 		} else {
-			blade->startLockup(&current_profile.lockup);
+			blade->startLockup(&current_profile->lockup);
 		}
 	} else {
 		enterState(stateIdleOn);
@@ -1250,8 +2106,8 @@ void PBSaber::pollStateLock()
 
 	if (button->released())
 	{
-		if (current_profile.font.poly)
-			fx.stop();
+		if (current_font->info.poly)
+			voices.stop(fontLock);
 		else
 			monoFont->restart();
 
@@ -1277,18 +2133,18 @@ void PBSaber::enterStateBlaster()
 	if (play(fontBlaster))
 	{
 		// Check if the blaster LED effect has to have the duration of the sound file
-		uint32_t duration = current_profile.blaster.duration;
+		uint32_t duration = current_profile->blaster.duration;
 		if (!duration)
 			// Modify the effect duration
 			duration = current_sound_duration;
 
 		if (onEffectCallback)
 		{
-			bladeEffect userEffect = current_profile.blaster;
+			bladeEffect userEffect = current_profile->blaster;
 			notifyEffectToUser(userEffect);
 			blade->onBlaster(&userEffect, duration);
 		} else {
-			blade->onBlaster(&current_profile.blaster, duration);
+			blade->onBlaster(&current_profile->blaster, duration);
 		}
 	} else {
 		enterState(stateIdleOn);
@@ -1302,9 +2158,9 @@ void PBSaber::pollStateBlaster()
 	ButtonEvent event;
 
 	if (fxButton)
-		event = fxButton->getEvent();
+		event = getButtonEvent(fxButton);
 	else
-		event = onButton->getEvent();
+		event = getButtonEvent(onButton);
 
 	if (event == ButtonShortPressAndRelease)
 	{
@@ -1314,9 +2170,9 @@ void PBSaber::pollStateBlaster()
 	}
 
 	// Blasters don't get interrupted, so poll here
-	if (current_profile.font.poly)
+	if (current_font->info.poly)
 	{
-		if (!fx.playing())
+		if (!voices.playing(fontBlaster))
 			enterState(stateIdleOn);
 	} else {
 		if (!monoFont->playingChained())
@@ -1329,18 +2185,18 @@ void PBSaber::enterStateClash()
 	if (play(fontClash))
 	{
 		// Check if the clash LED effect has to have the duration of the sound file
-		uint32_t duration = current_profile.clash.duration;
+		uint32_t duration = current_profile->clash.duration;
 		if (!duration)
 			// Modify the effect duration
 			duration = current_sound_duration;
 
 		if (onEffectCallback)
 		{
-			bladeEffect userEffect = current_profile.clash;
+			bladeEffect userEffect = current_profile->clash;
 			notifyEffectToUser(userEffect);
 			blade->onClash(&userEffect, duration);
 		} else {
-			blade->onClash(&current_profile.clash, duration);
+			blade->onClash(&current_profile->clash, duration);
 		}
 	} else {
 		enterState(stateIdleOn);
@@ -1368,18 +2224,18 @@ void PBSaber::enterStateStab()
 	if (play(fontStab))
 	{
 		// Check if the stab LED effect has to have the duration of the sound file
-		uint32_t duration = current_profile.stab.duration;
+		uint32_t duration = current_profile->stab.duration;
 		if (!duration)
 			// Modify the effect duration
 			duration = current_sound_duration;
 
 		if (onEffectCallback)
 		{
-			bladeEffect userEffect = current_profile.stab;
+			bladeEffect userEffect = current_profile->stab;
 			notifyEffectToUser(userEffect);
 			blade->onStab(&userEffect, duration);
 		} else {
-			blade->onStab(&current_profile.stab, duration);
+			blade->onStab(&current_profile->stab, duration);
 		}
 
 	} else {
@@ -1402,19 +2258,20 @@ void PBSaber::pollStateCycleProfiles()
 {
 	PropButton* onButton = getButton(buttonOnOff);
 
-	ButtonEvent event = onButton->getEvent();
+	ButtonEvent event = getButtonEvent(onButton);
 
 	if (event == ButtonShortPressAndRelease)
 	{
 		playUtility(sndutilBeep);
 
-		if (loadNextProfile(&tmp_profile))
-			changeProfile(&tmp_profile);
+		saberProfile* profile = loadNextProfile();
+		if (profile)
+			changeProfile(profile);
 	} else if (event == ButtonLongPressed)
 	{
 		// Set a flag indicating to update the initial profile (in the configuration file)
 		// at saber retraction.
-		save_initial_profile = profile_at_ignition != tmp_profile.id;
+		save_initial_profile = profile_at_ignition != current_profile->id;
 
 		// Play 'confirmation' sound
 		playUtility(sndutilBeep, PlayModeBlocking);
@@ -1424,6 +2281,9 @@ void PBSaber::pollStateCycleProfiles()
 
 void PBSaber::enterStateMusic()
 {
+	// Clear, until the ignition
+	music->setFilter(BiquadOff, 0);
+
 	if (!play(fontBackground, PlayModeLoop))
 		enterState(prev_state);
 }
@@ -1432,7 +2292,7 @@ void PBSaber::pollStateMusic()
 {
 	// Wait for a second On/Off button press to start ignition
 	PropButton* onButton = getButton(buttonOnOff);
-	ButtonEvent event = onButton->getEvent();
+	ButtonEvent event = getButtonEvent(onButton);
 
 	if (event == ButtonShortPressAndRelease)
 	{
@@ -1478,11 +2338,12 @@ void PBSaber::pollStateForce()
 void PBSaber::changeProfile(saberProfile* new_profile)
 {
 	bool font_changed = false;
+	saberFont* font = getFont(new_profile);
 
-	WavPlayer* new_poly_player = NULL;
-	WavChainPlayer* new_mono_player = NULL;
+	PBSPlayer* new_poly_player = NULL;
+	PBSChainPlayer* new_mono_player = NULL;
 
-	if (new_profile->font_num != current_profile.font_num)
+	if (new_profile->font_num != current_profile->font_num)
 		font_changed = true;
 
 	// If previous state was stateIdleOff, then we don't change anything,
@@ -1499,9 +2360,7 @@ void PBSaber::changeProfile(saberProfile* new_profile)
 		if (font_changed)
 		{
 			// Font has changed. Prepare the other player and start playing the hum
-			getSoundFileName(tmp, &new_profile->font, fontHum);
-
-			if (new_profile->font.poly)
+			if (font->info.poly)
 			{
 				if (hum == &hum1)
 					new_poly_player = &hum2;
@@ -1510,7 +2369,7 @@ void PBSaber::changeProfile(saberProfile* new_profile)
 
 				new_font_player = new_poly_player;
 				new_poly_player->setVolume(0);
-				font_changed = new_poly_player->play(tmp, PlayModeLoop);
+				font_changed = playSound(new_poly_player, font, fontHum, PlayModeLoop);
 			} else {
 				if (monoFont == &monoFont1)
 					new_mono_player = &monoFont2;
@@ -1520,22 +2379,21 @@ void PBSaber::changeProfile(saberProfile* new_profile)
 				new_font_player = new_mono_player;
 				new_mono_player->setVolume(0);
 				new_mono_player->stop();
-				new_mono_player->begin(tmp);
-				font_changed = new_mono_player->play();
+				font_changed = beginSound(new_mono_player, font, fontHum) &&
+							   new_mono_player->play();
 			}
 
-			if (current_profile.font.poly)
+			if (current_font->info.poly)
 				prev_font_player = hum;
 			else
 				prev_font_player = monoFont;
 
-			if (new_profile->font.files[fontBackground].present)
+			if (font->info.files[fontBackground].present)
 			{
 				// New font has background audio
 				new_bkg_player = (music == &music1) ? &music2 : &music1;
-				getSoundFileName(tmp, &new_profile->font, fontBackground);
 				new_bkg_player->setVolume(0);
-				if (new_bkg_player->play(tmp, PlayModeLoop))
+				if (playSound(new_bkg_player, font, fontBackground, PlayModeLoop))
 				{
 					background_changed = true;
 
@@ -1556,26 +2414,53 @@ void PBSaber::changeProfile(saberProfile* new_profile)
 				}
 			}
 
-			// Do the audio change in about 500ms, updating every 40ms.
+			// Crossfade the audio in about 500ms, along with the shimmer
 			if (font_changed)
 			{
 				new_font_target = prev_font_player->getVolume();
-				new_font_cycles =  BLADE_SHIMMER_SWITCH_DURATION / 40;
-				new_font_step = new_font_target / (float) new_font_cycles;
-				volumeCounter.startTimeoutCounter(40);
+				prev_font_player->rampVolume(0, BLADE_SHIMMER_SWITCH_DURATION, volumeEqualPower);
+				new_font_player->rampVolume(new_font_target, BLADE_SHIMMER_SWITCH_DURATION,
+											volumeEqualPower);
+
+				if (background_changed)
+				{
+					if (prev_bkg_player)
+						prev_bkg_player->rampVolume(0, BLADE_SHIMMER_SWITCH_DURATION,
+													volumeEqualPower);
+
+					if (new_bkg_player)
+						new_bkg_player->rampVolume(new_font_target,
+												   BLADE_SHIMMER_SWITCH_DURATION,
+												   volumeEqualPower);
+				}
 			}
 
 			new_font = font_changed;
 		}
 	}
 
-	// Update the current profile
-	memcpy(&current_profile, new_profile, sizeof(saberProfile));
+	// Update the current profile. The profile we leave is a neighbour of the new one, so
+	// only the slot on the other side has to be loaded again.
+	if (new_profile == next_profile)
+	{
+		next_profile = prev_profile;
+		prev_profile = current_profile;
+		current_profile = new_profile;
+	} else if (new_profile == prev_profile)
+	{
+		prev_profile = next_profile;
+		next_profile = current_profile;
+		current_profile = new_profile;
+	}
+
+	current_font = font;
+	prefetch_pending = true;
+	startCache();
 
 	if (prev_state == stateIdleOff)
 	{
 		// Make sure the volume of the players we want to use is set to 1
-		if (current_profile.font.poly)
+		if (current_font->info.poly)
 			hum->setVolume(1.0f);
 		else
 			monoFont->setVolume(1.0f);
@@ -1590,7 +2475,9 @@ void PBSaber::changeProfile(saberProfile* new_profile)
 
 void PBSaber::enterStateNextProfile()
 {
-	if (!loadNextProfile(&tmp_profile))
+	saberProfile* profile = loadNextProfile();
+
+	if (!profile)
 	{
 		enterState(prev_state);
 	} else {
@@ -1599,7 +2486,7 @@ void PBSaber::enterStateNextProfile()
 		else
 			playUtility(sndutilBeep);
 
-		changeProfile(&tmp_profile);
+		changeProfile(profile);
 	}
 }
 
@@ -1607,64 +2494,52 @@ void PBSaber::pollStateNextProfile()
 {
 	bool done = true;
 
-	// Wait for the audio switching to end (if any)
-	if (new_font && new_font_cycles)
+	// Wait for the audio crossfade to end (if any)
+	if (new_font)
 	{
-		if (!volumeCounter.timeout())
+		if (prev_font_player->ramping() || new_font_player->ramping())
 			return;
 
-		volumeCounter.startTimeoutCounter(40);
-		prev_font_player->setVolume(prev_font_player->getVolume() - new_font_step);
-		new_font_player->setVolume(new_font_player->getVolume() + new_font_step);
+		if (background_changed && ((prev_bkg_player && prev_bkg_player->ramping()) ||
+								   (new_bkg_player && new_bkg_player->ramping())))
+			return;
 
-		// Do the same for the background
-		if (background_changed)
-		{
-			if (prev_bkg_player)
-				prev_bkg_player->setVolume(prev_bkg_player->getVolume() - new_font_step);
+		// Stop old player
+		prev_font_player->stop();
 
-			if (new_bkg_player)
-				new_bkg_player->setVolume(new_bkg_player->getVolume() + new_font_step);
+		// Replace hum player
+		if (current_font->info.poly)
+		{
+			hum = (PBSPlayer*) new_font_player;
+			hum->setVolume(new_font_target);
+		} else {
+			monoFont = (PBSChainPlayer*) new_font_player;
+			monoFont->setVolume(new_font_target);
 		}
 
-		new_font_cycles--;
-		if (!new_font_cycles)
+		// Replace background player
+		if (background_changed)
 		{
-			// Stop old player
-			prev_font_player->stop();
-
-			// Replace hum player
-			if (current_profile.font.poly)
+			if (prev_bkg_player)
 			{
-				hum = (WavPlayer*) new_font_player;
-				hum->setVolume(new_font_target);
-			} else {
-				monoFont = (WavChainPlayer*) new_font_player;
-				monoFont->setVolume(new_font_target);
+				prev_bkg_player->setVolume(0);
+				prev_bkg_player->stop();
 			}
 
-			// Replace background player
-			if (background_changed)
+			if (new_bkg_player)
 			{
-				if (prev_bkg_player)
-				{
-					prev_bkg_player->setVolume(0);
-					prev_bkg_player->stop();
-				}
-
-				if (new_bkg_player)
-				{
-					new_bkg_player->setVolume(new_font_target);
-					music = new_bkg_player;
-				} else {
-					music = prev_bkg_player;
-				}
-				background_changed = false;
+				new_bkg_player->setVolume(new_font_target);
+				music = new_bkg_player;
+			} else {
+				music = prev_bkg_player;
 			}
+			background_changed = false;
+		}
 
-			// Play the font name (if any)
-			play(fontName);
-		} else done = false;
+		new_font = false;
+
+		// Play the font name (if any)
+		play(fontName);
 	}
 
 	// Wait for the blade to go idle
@@ -1686,7 +2561,7 @@ void PBSaber::pollStateNextProfile()
 		// Set a flag indicating to update the initial profile (in the configuration file)
 		// at saber retraction.
 		if (prev_state != stateIdleOff)
-			save_initial_profile = profile_at_ignition != tmp_profile.id;
+			save_initial_profile = profile_at_ignition != current_profile->id;
 
 		// Go back to the previous state
 		enterState(prev_state);
@@ -1695,7 +2570,9 @@ void PBSaber::pollStateNextProfile()
 
 void PBSaber::enterStatePrevProfile()
 {
-	if (!loadPrevProfile(&tmp_profile))
+	saberProfile* profile = loadPrevProfile();
+
+	if (!profile)
 	{
 		enterState(prev_state);
 	} else {
@@ -1704,7 +2581,7 @@ void PBSaber::enterStatePrevProfile()
 		else
 			playUtility(sndutilBeep);
 
-		changeProfile(&tmp_profile);
+		changeProfile(profile);
 	}
 }
 
@@ -1716,7 +2593,7 @@ void PBSaber::pollStatePrevProfile()
 
 bool PBSaber::ignitionOnStab()
 {
-	if (current_profile.ignition_on_stab)
+	if (current_profile->ignition_on_stab)
 	{
 		if (event_swing)
 		{
@@ -1736,27 +2613,21 @@ bool PBSaber::ignitionOnStab()
 
 void PBSaber::playUtility(saberUtilitySound snd, PlayMode mode)
 {
-	if (!strlen(config.settings.sound_utils))
-	{
-		debugMsg(DebugWarning, "Utility sounds folder not configured");
-		return;
-	}
+	const char* path = utility_paths[snd];
 
-	sprintf(tmp, "%s\\", config.settings.sound_utils);
+	// Not configured
+	if (!path[0])
+		return;
 
-	switch (snd)
-	{
-		case sndutilBeep:
-			strcat(tmp, "beep.wav");
-			break;
-	}
+	PBSPlayer* voice = voices.allocate(VOICE_UTILITY, VOICE_UTILITY_PRIORITY);
+	if (!voice)
+		return;
 
-	// Use FX player
-	if (fx.play(tmp, mode))
+	if (voice->play(path, mode))
 	{
-		debugMsg(DebugInfo, "Playing utility sound %s", tmp);
+		debugMsg(DebugInfo, "Playing utility sound %s", path);
 	} else {
-		debugMsg(DebugInfo, "Error playing %s", tmp);
+		debugMsg(DebugInfo, "Error playing %s", path);
 	}
 }
 
@@ -1788,14 +2659,110 @@ const char* PBSaber::getStateName(saberStateId state)
 
 void PBSaber::motionPulses()
 {
+	clash_time = micros();
 	event_clash = true;
 }
 
 void PBSaber::motionTransients()
 {
+	swing_time = micros();
 	event_swing = true;
 }
 
+ButtonEvent PBSaber::getButtonEvent(PropButton* button)
+{
+	ButtonEvent event = button->getEvent();
+
+	// The button driver doesn't tell when the event happened, so this is when the loop
+	// took it
+	if (event != ButtonNoEvent)
+		latency.event(micros());
+
+	return event;
+}
+
+void PBSaber::soundStarted()
+{
+	// The limiter holds the first sample back for its look-ahead
+	latency.firstSample(mixer.getDelayUs());
+}
+
+void PBSaber::dumpLatency()
+{
+	latencyStats stats;
+
+	debugMsg(DebugInfo, "Event to sound latency (us), budget %u", PBS_LATENCY_BUDGET);
+	debugMsg(DebugInfo, "%-12s %6s %7s %7s %7s %7s %6s  %7s %7s %7s", "effect", "count",
+			 "min", "avg", "p99", "max", "over", "state", "play", "sample");
+
+	for (uint32_t i = 0; i < PBS_LATENCY_TYPES; i++)
+	{
+		if (!latency.getStats(i, &stats))
+			continue;
+
+		debugMsg(DebugInfo, "%-12s %6lu %7lu %7lu %7lu %7lu %6lu  %7lu %7lu %7lu",
+				 getStateName(latency_states[i]), stats.count, stats.min, stats.avg, stats.p99,
+				 stats.max, stats.over_budget, stats.stage_avg[latencyState],
+				 stats.stage_avg[latencyPlay], stats.stage_avg[latencySample]);
+	}
+}
+
+void PBSaber::dumpVoices()
+{
+	const voiceStats* stats = voices.getStats();
+
+	debugMsg(DebugInfo, "Effect voices: %u, peak %lu, %lu sounds, %lu stolen, %lu dropped",
+			 PBS_FX_VOICES, stats->peak, stats->allocations, stats->steals, stats->drops);
+}
+
+void PBSaber::dumpStreams()
+{
+	static const char* names[streamPriorityMax] = { "effects", "hum", "music" };
+
+	for (uint32_t i = 0; i < streamPriorityMax; i++)
+	{
+		const streamStats* stats = mixer.getStreamStats((streamPriority) i);
+		debugMsg(DebugInfo, "SD stream %s: %lu reads, %lu KiB, %lu underruns, %lu sounds, "
+				 "first data in %lu us max, refills in %lu us max", names[i], stats->reads,
+				 (uint32_t) (stats->bytes / 1024), stats->underruns, stats->onsets,
+				 stats->max_onset_us, stats->max_wait_us);
+	}
+
+	debugMsg(DebugInfo, "Underruns: hum %lu/%lu, music %lu/%lu", hum1.getUnderruns(),
+			 hum2.getUnderruns(), music1.getUnderruns(), music2.getUnderruns());
+}
+
+void PBSaber::dumpLimiter()
+{
+	PBSLimiter* limiter = mixer.getLimiter();
+
+	if (!limiter)
+	{
+		debugMsg(DebugInfo, "Limiter off, %lu samples clipped", mixer.getStats()->clipped);
+		return;
+	}
+
+	const limiterStats* stats = limiter->getStats();
+
+	// Deepest reduction in tenths of dB
+	int32_t min_gain = stats->min_gain > 0 ? stats->min_gain : 1;
+	uint32_t reduction = (uint32_t) (-200.0f * log10f(min_gain / 32768.0f) + 0.5f);
+
+	debugMsg(DebugInfo, "Limiter: %lu/%lu blocks limited, %lu samples, deepest -%lu.%lu dB, "
+			 "%lu clipped", stats->limited_blocks, stats->blocks, stats->limited_samples,
+			 reduction / 10, reduction % 10, stats->clipped);
+}
+
+bool PBSaber::getLatency(saberStateId state, latencyStats* stats)
+{
+	int32_t type = getLatencyType(state);
+
+	if (type < 0)
+		return false;
+
+	return latency.getStats(type, stats);
+}
+
 #ifdef FROM_ECLIPSE
 PBSaber saber;
 
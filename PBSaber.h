@@ -28,8 +28,16 @@
 
 #include <Arduino.h>
 #include "PBSBlade.h"
+#include "PBSCache.h"
 #include "PBSConfig.h"
 #include "PBSDebug.h"
+#include "PBSLatency.h"
+#include "PBSManifest.h"
+#include "PBSMixer.h"
+#include "PBSProfile.h"
+#include "PBSState.h"
+#include "PBSSwing.h"
+#include "PBSVoices.h"
 #include "PBSStrip.h"
 #include "TimeCounter.h"
 #include <PropButton.h>
@@ -44,7 +52,20 @@
 
 #define PBSABER_CONFIG_FILE	"config.ini"
 
-#define fontPresent(x) (current_profile.font.files[x].present)
+// Time the audio codec takes to settle after Audio.begin(), in ms
+#define PBS_AUDIO_SETTLE_TIME	900
+
+// Time the hum filter takes to go back to its cutoff when the blade stops following the
+// motion, in ms
+#define PBS_HUM_FILTER_CLOSE_MS	100
+
+// Master limiter: ceiling in dBFS, look-ahead (also the delay it adds to
+// the output) in us and release in ms
+#define PBS_LIMITER_CEILING		-0.5f
+#define PBS_LIMITER_LOOKAHEAD	2000
+#define PBS_LIMITER_RELEASE		100
+
+#define fontPresent(x) (current_font->info.files[x].present)
 
 typedef enum
 {
@@ -69,9 +90,61 @@ typedef enum
 
 typedef enum
 {
-	sndutilBeep
+	sndutilBeep,
+	sndutilMax
 } saberUtilitySound;
 
+// Boot stages, run from begin() while the audio codec settles. The wait for the codec
+// runs from loop(), loading ahead what is used next.
+typedef enum
+{
+	bootSettings,
+	bootProfile,
+	bootFont,
+	bootBlade,
+	bootControls,
+	bootAudio,
+	bootReady,
+	bootFailed
+} bootStage;
+
+// Font table entries, one for each profile slot at most
+#define PBS_FONT_SLOTS			3
+
+// Longest sound path: folder, file name, number and extension
+#define PBS_SOUND_PATH_LEN		(MAX_FONT_NAME_LEN * 2 + 16)
+
+// Path of a sound of the font, assembled when the font is loaded. Random sounds get their
+// number and extension written at 'suffix' when played.
+typedef struct
+{
+	char path[PBS_SOUND_PATH_LEN];
+	uint8_t suffix;
+} fontSoundPath;
+
+// Sound types picked and opened ahead of time
+#define PBS_ARMED_SOUNDS		5
+
+// The next file of a sound type, picked ahead of time. Its file is open and its first
+// block of audio data read, unless the file is in the sample cache. Then only the number
+// is picked.
+typedef struct
+{
+	PBSPreparedTrack track;
+	uint32_t font_id;
+	uint32_t num;
+	bool picked;
+} saberArmedSound;
+
+// Entry of the font table. Profiles using the same font share it.
+typedef struct
+{
+	fontInfo info;
+	PBSManifest manifest;
+	fontSoundPath paths[fontMax];
+	char pack[PBS_PACK_PATH_LEN];	// Empty for fonts made of loose files
+} saberFont;
+
 #define DECLARE_STATE(X)		\
 void enterState##X();			\
 void pollState##X();
@@ -86,6 +159,41 @@ public:
 	bool begin(const char* config_file = NULL);
 	void loop();
 
+	// True once the boot has finished and the saber is responding to the user
+	bool ready() { return initialized; }
+
+	// Print the time taken by every phase of the boot
+	void dumpBootProfile() { profileDump(); }
+
+	// Print the time from button and motion events to the first sample of their sound. Also
+	// printed by sending 'l' through the debug serial ('r' resets it, 'b' prints the boot
+	// profile, 'v' the use of the effect voices, 's' the SD streams, 'm' the master
+	// limiter).
+	void dumpLatency();
+	bool getLatency(saberStateId state, latencyStats* stats);
+
+	// Print how the effect voices were used ('v' through the debug serial)
+	void dumpVoices();
+	const voiceStats* getVoiceStats() { return voices.getStats(); }
+	const mixerStats* getMixerStats() { return mixer.getStats(); }
+	void resetMixerStats() { mixer.resetStats(); }
+
+	// Print the SD reads and underruns of each stream priority ('s' through the debug
+	// serial)
+	void dumpStreams();
+	const streamStats* getStreamStats(streamPriority priority)
+	{
+		return mixer.getStreamStats(priority);
+	}
+
+	// Print the gain reduction of the master limiter and the samples clipped at the output
+	// ('m' through the debug serial)
+	void dumpLimiter();
+	const limiterStats* getLimiterStats()
+	{
+		return mixer.getLimiter() ? mixer.getLimiter()->getStats() : NULL;
+	}
+
 	void setNewStateCallback(onNewState* fnptr)
 	{
 		newStateCallback = fnptr;
@@ -99,24 +207,60 @@ public:
 
 private:
 
-	bool initializeHardware();
+	bool initializeBlade();
+	bool initializeControls();
+	bool runBootStage(bootStage stage);
+	const char* getBootStageName(bootStage stage);
+	void boot();
+	void bootDone();
 	void resetAllButtonsEvents();
 	void resetAllMotionEvents();
 	bool loadProfile(uint32_t id, saberProfile* profile);
-	bool loadNextProfile(saberProfile* profile);
-	bool loadPrevProfile(saberProfile* profile);
+	bool loadProfileSlot(uint32_t id, saberProfile* slot);
+	saberFont* loadFont(uint32_t id, saberProfile* slot);
+	saberFont* getFont(saberProfile* profile);
+	saberProfile* loadNextProfile();
+	saberProfile* loadPrevProfile();
+	uint32_t getNextProfileId();
+	uint32_t getPrevProfileId();
+	void prefetchProfiles();
 	void changeProfile(saberProfile* new_profile);
 	bool play(fontSoundType type, PlayMode mode = PlayModeNormal);
 	void setNextProfile();
 	void setPrevProfile();
 	bool switchProfile();
 	void enterState(saberStateId state);
-	void getSoundFileName(char* dst, fontInfo* font, fontSoundType type);
-	void getSpinFileName(char* dst, fontInfo* font, uint32_t num);
+	void buildSoundPaths(saberFont* font);
+	void buildUtilityPaths();
+	const char* getSound(saberFont* font, fontSoundType type, const AudioTrackInfo** info,
+						 int32_t num = -1);
+	bool playSound(PBSPlayer* player, saberFont* font, fontSoundType type,
+				   PlayMode mode = PlayModeNormal, int32_t num = -1);
+	bool chainSound(PBSChainPlayer* player, saberFont* font, fontSoundType type,
+					PlayMode mode = PlayModeNormal, int32_t num = -1);
+	bool beginSound(PBSChainPlayer* player, saberFont* font, fontSoundType type);
+	void startCache();
+	void fillCache();
+	void soundFilesChanged(saberFont* font);
+	saberArmedSound* getArmedSound(fontSoundType type);
+	saberArmedSound* takeArmedSound(saberFont* font, fontSoundType type, int32_t* num);
+	bool peekArmedSound(fontSoundType type, uint32_t* num);
+	void disarmSound(saberArmedSound* armed);
+	void armSounds();
+	PBSPlayer* getVoice(uint8_t type);
+	bool smoothSwingAvailable();
+	bool smoothSwingState(saberStateId state);
+	bool playSwingPair();
+	bool humFollowsMotion();
+	void startSmoothSwing();
+	void stopSmoothSwing();
+	void updateSmoothSwing();
 	void debugOutput();
 	void playUtility(saberUtilitySound snd, PlayMode mode = PlayModeNormal);
 	void motionPulses();
 	void motionTransients();
+	ButtonEvent getButtonEvent(PropButton* button);
+	void soundStarted();
 	const char* getStateName(saberStateId state);
 	bool ignitionOnStab();
 	void handleButtonsEvents();
@@ -125,7 +269,7 @@ private:
 
 	void notifyEffectToUser(bladeEffect& effect)
 	{
-		(onEffectCallback)(current_profile.id, curr_state, effect);
+		(onEffectCallback)(current_profile->id, curr_state, effect);
 	}
 
 	DECLARE_STATE(Off);
@@ -157,6 +301,12 @@ private:
 		ptr->motionTransients();
 	}
 
+	static void soundStartedStub(PBSPlayer*, void* param)
+	{
+		PBSaber* ptr = (PBSaber*) param;
+		ptr->soundStarted();
+	}
+
 	inline PropButton* getButton(saberButtonType type)
 	{
 		if (type == buttonOnOff)
@@ -167,34 +317,60 @@ private:
 	}
 
 	bool initialized;
+	bootStage boot_stage;
+	uint32_t boot_phase;
+	uint32_t audio_phase;
+	uint32_t audio_init;
+	const char* config_file;
 	PBSConfig config;
+	PBSState state;
 	PBSBladeBase* blade;
 
-	saberProfile current_profile;
-	saberProfile tmp_profile;
+	saberProfile profile_slots[3];
+	saberProfile* current_profile;
+	saberProfile* next_profile;
+	saberProfile* prev_profile;
+	saberFont font_table[PBS_FONT_SLOTS];
+	saberFont* current_font;
+	bool prefetch_pending;
+	bool snapshot_pending;
+	bool boot_log_pending;
+	PBSCache cache;
+	bool cache_pending;
+	uint32_t cache_round;
+	uint32_t cache_type;
+	saberArmedSound armed_sounds[PBS_ARMED_SOUNDS];
+	bool arm_pending;
 	saberStateId prev_state;
 	saberStateId curr_state;
 
-	WavPlayer hum1;
-	WavPlayer hum2;
-	WavPlayer* hum;
-	WavChainPlayer monoFont1;
-	WavChainPlayer monoFont2;
-	WavChainPlayer* monoFont;
-	WavPlayer fx;
-	WavPlayer music1;
-	WavPlayer music2;
-	WavPlayer* music;
+	PBSMixer mixer;
+	PBSPlayer hum1;
+	PBSPlayer hum2;
+	PBSPlayer* hum;
+	PBSChainPlayer monoFont1;
+	PBSChainPlayer monoFont2;
+	PBSChainPlayer* monoFont;
+	PBSVoices voices;				// Effects of poly fonts, boot and utility sounds
+	PBSPlayer music1;
+	PBSPlayer music2;
+	PBSPlayer* music;
+	PBSPlayer swing_low;			// Smooth swing pair, looping with the hum
+	PBSPlayer swing_high;
+
+	PBSSwing smooth_swing;			// Also moves the pitch of the hum, with or without the pair
+	bool smooth_swing_on;
+	bool swing_pair_on;
+	uint32_t smooth_swing_time;
+	uint32_t smooth_swing_period;	// One audio block, in us
 
 	bool new_font;
 	bool background_changed;
-	RawPlayer* new_font_player;
-	RawPlayer* prev_font_player;
-	WavPlayer* new_bkg_player;
-	WavPlayer* prev_bkg_player;
-	float new_font_step;
+	PBSPlayer* new_font_player;
+	PBSPlayer* prev_font_player;
+	PBSPlayer* new_bkg_player;
+	PBSPlayer* prev_bkg_player;
 	float new_font_target;
-	uint32_t new_font_cycles;
 
 	uint32_t off_start_time;
 	uint32_t current_sound_duration;
@@ -214,6 +390,10 @@ private:
 
 	volatile bool event_clash;
 	volatile bool event_swing;
+	volatile uint32_t clash_time;	// micros() of the last motion interrupts
+	volatile uint32_t swing_time;
+
+	PBSLatency latency;
 
 	uint32_t first_profile;
 	uint32_t last_profile;
@@ -224,12 +404,11 @@ private:
 	uint32_t debug_interval;
 	uint32_t debug_ticks;
 
-	TimeCounter volumeCounter;
-
 	onNewState* newStateCallback;
 	onEffect* onEffectCallback;
 
-	char tmp[255];
+	char utility_paths[sndutilMax][PBS_SOUND_PATH_LEN];
+	const char* sound_path;			// Last sound played by play()
 };
 
 #endif /* __PBSCLASS_H__ */
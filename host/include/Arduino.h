@@ -0,0 +1,91 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### Arduino.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard Arduino core. Only the subset used by PBSaber is
+ * provided. Time is virtual and only moves when the simulation advances it (see Sim.h).
+ */
+
+#ifndef __ARDUINO_H__
+#define __ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#define UNUSED(x)	(void)(x)
+
+#define RISING		1
+#define FALLING		2
+#define CHANGE		3
+
+uint32_t GetTickCount();
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void __disable_irq();
+void __enable_irq();
+
+uint32_t getRandom(uint32_t min, uint32_t max);
+void enterLowPowerMode(uint32_t pin, uint32_t mode, bool standby);
+
+class HardwareSerial
+{
+public:
+	HardwareSerial() : echo(false), rx_head(0), rx_tail(0) {}
+	void begin(uint32_t baud) { UNUSED(baud); }
+	void print(const char* str);
+	void println(const char* str);
+	int available();
+	int read();
+	void setEcho(bool value) { echo = value; }
+
+	// Simulation helper: queues bytes as if received
+	void receive(const char* str);
+
+private:
+	bool echo;
+	char rx[64];
+	uint32_t rx_head;
+	uint32_t rx_tail;
+};
+
+extern HardwareSerial Serial;
+
+void enableSdDebug(HardwareSerial* serial);
+
+#include "ff.h"
+#include "Color.h"
+#include "Audio.h"
+#include "Motion.h"
+#include "HBLED.h"
+
+#endif /* __ARDUINO_H__ */
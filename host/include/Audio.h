@@ -0,0 +1,168 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### Audio.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard audio engine and its players. Sources attached to the
+ * engine are rendered one block at a time from the simulated audio interrupt, so file
+ * streaming, volumes and durations behave as on the board, in virtual time.
+ */
+
+#ifndef __AUDIO_H__
+#define __AUDIO_H__
+
+#include <stdint.h>
+#include "ff.h"
+
+#define AUDIO_BLOCK_SAMPLES		256
+
+typedef enum
+{
+	PlayModeNormal,
+	PlayModeLoop,
+	PlayModeBlocking
+} PlayMode;
+
+class AudioSource
+{
+public:
+	AudioSource();
+	virtual ~AudioSource();
+
+	virtual void setVolume(float value) { volume = value; }
+	virtual float getVolume() { return volume; }
+	virtual bool playing() { return active; }
+	virtual void stop();
+
+protected:
+	// Called from the audio interrupt. Renders up to 'samples' mono samples and returns
+	// how many were produced. Returning less than requested ends the playback.
+	virtual uint32_t render(int16_t* buffer, uint32_t samples) = 0;
+
+	void start();
+
+	volatile bool active;
+	float volume;
+
+private:
+	friend class AudioClass;
+	AudioSource* next;
+	bool attached;
+};
+
+class AudioClass
+{
+public:
+	AudioClass();
+	bool begin(uint32_t fs, uint8_t bps, bool stereo);
+	void setVolume(float db);
+	float getVolume() { return master_db; }
+	void mute() { muted = true; }
+	void unmute() { muted = false; }
+	uint32_t getSampleRate() { return sample_rate; }
+	bool initialized() { return sample_rate != 0; }
+
+	// Simulation helpers
+	void tick();
+	uint32_t blockPeriodUs();
+
+private:
+	friend class AudioSource;
+	void attach(AudioSource* src);
+	void detach(AudioSource* src);
+
+	uint32_t sample_rate;
+	float master_db;
+	float master_gain;
+	bool muted;
+	AudioSource* sources;
+};
+
+extern AudioClass Audio;
+
+typedef struct
+{
+	bool open;
+	FIL file;
+	char filename[256];
+	uint32_t data_offset;
+	uint32_t data_size;
+	uint32_t position;
+	uint32_t fs;
+	uint8_t channels;
+	bool loop;
+} simTrack;
+
+class RawPlayer : public AudioSource
+{
+public:
+	RawPlayer();
+	virtual ~RawPlayer();
+	virtual void stop();
+	uint32_t duration();
+	const char* getFileName() { return track.filename; }
+
+protected:
+	bool openTrack(simTrack* trk, const char* filename, bool loop);
+	void closeTrack(simTrack* trk);
+	uint32_t renderTrack(simTrack* trk, int16_t* buffer, uint32_t samples);
+	uint32_t trackDuration(simTrack* trk);
+	uint32_t render(int16_t* buffer, uint32_t samples);
+	void waitBlocking();
+
+	simTrack track;
+};
+
+class WavPlayer : public RawPlayer
+{
+public:
+	bool play(const char* filename, PlayMode mode = PlayModeNormal);
+	bool playRandom(const char* prefix, uint32_t min, uint32_t max,
+					PlayMode mode = PlayModeNormal);
+};
+
+class WavChainPlayer : public RawPlayer
+{
+public:
+	WavChainPlayer();
+	bool begin(const char* filename);
+	bool chain(const char* filename, PlayMode mode = PlayModeNormal);
+	bool chainRandom(const char* prefix, uint32_t min, uint32_t max,
+					 PlayMode mode = PlayModeNormal);
+	bool play();
+	bool restart();
+	void stop();
+	bool playingChained() { return active && chained_active; }
+	uint32_t getChainedDuration();
+	const char* getChainedFileName() { return chained.filename; }
+
+protected:
+	uint32_t render(int16_t* buffer, uint32_t samples);
+
+private:
+	simTrack chained;
+	volatile bool chained_active;
+};
+
+#endif /* __AUDIO_H__ */
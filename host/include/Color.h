@@ -0,0 +1,102 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### Color.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard COLOR type.
+ */
+
+#ifndef __COLOR_H__
+#define __COLOR_H__
+
+#include <stdint.h>
+
+class COLOR
+{
+public:
+	COLOR() : r(0), g(0), b(0), w(0) {}
+	COLOR(uint8_t red, uint8_t green, uint8_t blue, uint8_t white = 0) :
+		r(red), g(green), b(blue), w(white) {}
+
+	COLOR(uint32_t value) :
+		r((value >> 24) & 0xFF), g((value >> 16) & 0xFF), b((value >> 8) & 0xFF), w(value & 0xFF) {}
+
+	bool operator==(const COLOR& other) const
+	{
+		return r == other.r && g == other.g && b == other.b && w == other.w;
+	}
+
+	bool operator!=(const COLOR& other) const { return !(*this == other); }
+	bool operator!() const { return !r && !g && !b && !w; }
+
+	COLOR operator*(float value) const
+	{
+		return COLOR(scale(r, value), scale(g, value), scale(b, value), scale(w, value));
+	}
+
+	COLOR& operator*=(float value)
+	{
+		*this = *this * value;
+		return *this;
+	}
+
+	void blend(const COLOR& other, float amount)
+	{
+		r = mix(r, other.r, amount);
+		g = mix(g, other.g, amount);
+		b = mix(b, other.b, amount);
+		w = mix(w, other.w, amount);
+	}
+
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	uint8_t w;
+
+private:
+	static uint8_t scale(uint8_t c, float value)
+	{
+		float v = c * value;
+		if (v < 0) return 0;
+		if (v > 255) return 255;
+		return (uint8_t) v;
+	}
+
+	static uint8_t mix(uint8_t a, uint8_t b, float amount)
+	{
+		float v = a + (b - a) * amount;
+		if (v < 0) return 0;
+		if (v > 255) return 255;
+		return (uint8_t) v;
+	}
+};
+
+inline COLOR RGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w)
+{
+	return COLOR(r, g, b, w);
+}
+
+COLOR randomColor();
+
+#endif /* __COLOR_H__ */
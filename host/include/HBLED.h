@@ -0,0 +1,52 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### HBLED.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard high-brightness LED driver.
+ */
+
+#ifndef __HBLED_H__
+#define __HBLED_H__
+
+#include <stdint.h>
+
+class HBLED
+{
+public:
+	HBLED(uint8_t num) : channel(num), current(0), value(0), multiplier(1.0f) {}
+	bool begin(uint16_t max_current);
+	void setValue(uint8_t val) { value = val; }
+	uint8_t getValue() { return value; }
+	void setMultiplier(float val) { multiplier = val; }
+	float getMultiplier() { return multiplier; }
+
+private:
+	uint8_t channel;
+	uint16_t current;
+	uint8_t value;
+	float multiplier;
+};
+
+#endif /* __HBLED_H__ */
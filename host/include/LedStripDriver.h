@@ -0,0 +1,103 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### LedStripDriver.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard LED strip driver. update() encodes the frame as the
+ * SPI/DMA driver would and keeps the driver busy for the wire transfer time.
+ */
+
+#ifndef __LEDSTRIPDRIVER_H__
+#define __LEDSTRIPDRIVER_H__
+
+#include <stdint.h>
+#include "Color.h"
+
+typedef enum
+{
+	APA102 = 1,
+	WS2812B,
+	SK6812RGBW
+} LedStripeType;
+
+class LedStripData
+{
+public:
+	LedStripData(uint32_t count);
+	~LedStripData();
+
+	// Indexes are 1-based
+	COLOR get(uint32_t index) { return (index && index <= count) ? leds[index-1] : COLOR(); }
+	void set(uint32_t index, const COLOR& color)
+	{
+		if (index && index <= count)
+			leds[index-1] = color;
+	}
+
+	uint32_t getCount() { return count; }
+
+private:
+	COLOR* leds;
+	uint32_t count;
+};
+
+class LedStripDriver
+{
+public:
+	LedStripDriver();
+	virtual ~LedStripDriver();
+
+	virtual bool begin(uint32_t count, LedStripeType type = WS2812B);
+	virtual bool update(uint32_t index = 0, bool async = false);
+	virtual void set(uint32_t index, const COLOR& color);
+	virtual void set(uint32_t index, uint8_t r, uint8_t g, uint8_t b, uint8_t w = 0);
+	virtual void setRange(uint32_t start, uint32_t end, const COLOR& color);
+	virtual void setRange(uint32_t start, uint32_t end, uint8_t r, uint8_t g, uint8_t b,
+						  uint8_t w = 0);
+
+	uint32_t getLedCount() { return led_count; }
+	void setBrightness(float value) { brightness = value; }
+	float getBrightness() { return brightness; }
+	bool busy();
+
+	// Simulation helpers
+	uint32_t getFrameCount() { return frames; }
+
+protected:
+	bool updateInternal(uint32_t index, LedStripData* data, bool async);
+
+	bool initialized;
+	LedStripData* led_data;
+
+private:
+	LedStripeType strip_type;
+	uint32_t led_count;
+	float brightness;
+	uint8_t* tx_buffer;
+	uint32_t tx_size;
+	uint64_t busy_until;
+	uint32_t frames;
+};
+
+#endif /* __LEDSTRIPDRIVER_H__ */
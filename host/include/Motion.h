@@ -0,0 +1,119 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### Motion.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard MMA8452 motion driver. Interrupts are raised by the
+ * simulation (see simMotionPulse() and simMotionTransient() in Sim.h).
+ */
+
+#ifndef __MOTION_H__
+#define __MOTION_H__
+
+#include <stdint.h>
+
+#define MMA8452_TRANSIENT_CFG	0x1D
+#define MMA8452_TRANSIENT_SRC	0x1E
+#define MMA8452_PULSE_CFG		0x21
+#define MMA8452_PULSE_SRC		0x22
+
+typedef enum
+{
+	AxisX = 0x01,
+	AxisY = 0x02,
+	AxisZ = 0x04,
+	AxisAll = 0x07
+} MotionAxis;
+
+typedef enum
+{
+	MotionInterrupt1 = 1,
+	MotionInterrupt2 = 2
+} MotionInterrupt;
+
+typedef enum
+{
+	MotionPulseNegativeX = 0x01,
+	MotionPulseNegativeY = 0x02,
+	MotionPulseNegativeZ = 0x04,
+	MotionPulseOnX = 0x10,
+	MotionPulseOnY = 0x20,
+	MotionPulseOnZ = 0x40
+} MotionPulseSource;
+
+typedef enum
+{
+	MotionTransientNegativeX = 0x01,
+	MotionTransientOnX = 0x02,
+	MotionTransientNegativeY = 0x04,
+	MotionTransientOnY = 0x08,
+	MotionTransientNegativeZ = 0x10,
+	MotionTransientOnZ = 0x20
+} MotionTransientSource;
+
+typedef enum
+{
+	MotionNegativeX = MotionTransientNegativeX,
+	MotionOnX = MotionTransientOnX,
+	MotionNegativeY = MotionTransientNegativeY,
+	MotionOnY = MotionTransientOnY,
+	MotionNegativeZ = MotionTransientNegativeZ,
+	MotionOnZ = MotionTransientOnZ
+} MotionEvents;
+
+typedef void (motionCallback)(void*);
+
+class MotionClass
+{
+public:
+	MotionClass();
+	bool begin(uint8_t range, uint32_t odr, bool low_noise);
+	bool configPulse(uint8_t axis, float force, uint32_t time, uint32_t latency,
+					 MotionInterrupt intr);
+	bool configTransient(uint8_t axis, float force, uint32_t time, MotionInterrupt intr);
+	void attachInterruptWithParam(MotionInterrupt intr, motionCallback* fn, void* param);
+	bool readRegister(uint8_t reg, uint8_t* value);
+	bool writeRegister(uint8_t reg, uint8_t value);
+	bool enable();
+	bool disable();
+	uint8_t getPulseSource();
+	uint8_t getTransientSource();
+	bool readAcceleration(float* x, float* y, float* z);
+
+	// Simulation helpers
+	void simPulse(uint8_t src);
+	void simTransient(uint8_t src);
+	void simSetAcceleration(float x, float y, float z);
+
+private:
+	uint8_t regs[0x32];
+	motionCallback* callbacks[2];
+	void* params[2];
+	bool enabled;
+	float accel[3];
+};
+
+extern MotionClass Motion;
+
+#endif /* __MOTION_H__ */
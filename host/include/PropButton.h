@@ -0,0 +1,75 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PropButton.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard button driver. Buttons are sampled every millisecond
+ * of virtual time from the service timer. Pin levels come from simSetButton().
+ */
+
+#ifndef __PROPBUTTON_H__
+#define __PROPBUTTON_H__
+
+#include <stdint.h>
+#include "ServiceTimer.h"
+
+typedef enum
+{
+	ButtonActiveLow,
+	ButtonActiveHigh
+} ButtonType;
+
+typedef enum
+{
+	ButtonNoEvent,
+	ButtonPressed,
+	ButtonReleased,
+	ButtonShortPressAndRelease,
+	ButtonLongPressed
+} ButtonEvent;
+
+class PropButton : public STObject
+{
+public:
+	PropButton();
+	bool begin(uint32_t pin, ButtonType type, uint32_t debounce = 25);
+	void setLongPressTime(uint32_t ms) { long_press_time = ms; }
+	ButtonEvent getEvent();
+	void resetEvents() { event = ButtonNoEvent; }
+	bool pressed() { return state; }
+	bool released() { return !state; }
+	void poll();
+
+private:
+	uint32_t pin;
+	uint32_t debounce;
+	uint32_t long_press_time;
+	uint32_t counter;
+	uint32_t press_time;
+	bool state;
+	bool long_fired;
+	volatile ButtonEvent event;
+};
+
+#endif /* __PROPBUTTON_H__ */
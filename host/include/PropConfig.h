@@ -0,0 +1,91 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### PropConfig.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard INI configuration file reader. It reads through the
+ * FatFs stand-in in 512-byte sectors, so every scan is charged to the SD timing model.
+ */
+
+#ifndef __PROPCONFIG_H__
+#define __PROPCONFIG_H__
+
+#include <stdint.h>
+#include "ff.h"
+
+typedef bool (mapSectionsCallback)(uint32_t section, uint32_t data, char* str, void* param);
+
+class PropConfig
+{
+public:
+	PropConfig();
+	~PropConfig();
+
+	bool begin(const char* file);
+	void end();
+
+	bool setFileRWPointer(uint32_t offset);
+	uint32_t getFileRWPointer() { return pos; }
+
+	bool mapSections(mapSectionsCallback* callback, void* param);
+	bool startSectionScan(const char* section);
+	bool getNextKey(uint32_t* token, char** key_name, uint32_t* key_len);
+	void endSectionScan();
+
+	bool readValue(uint32_t token, uint32_t* value);
+	bool readValue(uint32_t token, uint8_t* value);
+	bool readValue(uint32_t token, bool* value);
+	bool readValue(uint32_t token, float* value);
+	bool readValue(uint32_t token, char* value, uint32_t* len);
+	bool readArray(uint32_t token, uint8_t* values, uint8_t* count);
+	bool readArray(uint32_t token, uint16_t* values, uint8_t* count);
+
+	bool readValue(const char* section, const char* key, uint32_t* value);
+	bool readValue(const char* section, const char* key, bool* value);
+
+	bool writeValue(const char* section, const char* key, uint32_t value);
+
+private:
+	bool readLine(char* dst, uint32_t size, uint32_t* line_offset);
+	bool findSection(const char* section);
+	bool findKey(const char* section, const char* key, uint32_t* token);
+	const char* valueAt(uint32_t token);
+	bool parseSection(char* line, char** name);
+	bool parseKey(char* line, uint32_t line_offset, char** key, uint32_t* key_len,
+				  uint32_t* token);
+
+	FIL file;
+	bool opened;
+	char filename[256];
+	uint32_t pos;
+	uint8_t sector[512];
+	uint32_t sector_offset;
+	uint32_t sector_len;
+	char line[256];
+	char value[256];
+	uint32_t value_token;
+	bool in_section;
+};
+
+#endif /* __PROPCONFIG_H__ */
@@ -0,0 +1,54 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### ServiceTimer.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the PropBoard ServiceTimer. Objects added to the service timer are
+ * polled every millisecond of virtual time, as the 1 kHz timer interrupt would do.
+ */
+
+#ifndef __SERVICETIMER_H__
+#define __SERVICETIMER_H__
+
+#include <stdint.h>
+
+class STObject
+{
+public:
+	STObject() : next(0), added(false) {}
+	virtual ~STObject() { remove(); }
+	virtual void poll() = 0;
+
+	void add();
+	void remove();
+
+private:
+	friend void serviceTimerTick();
+	STObject* next;
+	bool added;
+};
+
+void serviceTimerTick();
+
+#endif /* __SERVICETIMER_H__ */
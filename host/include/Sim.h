@@ -0,0 +1,88 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### Sim.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Simulation control for the host build: virtual clock, SD timing model, buttons and
+ * motion events. Only the host tools include this header.
+ */
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdint.h>
+
+typedef struct
+{
+	uint32_t opens;
+	uint32_t reads;
+	uint32_t writes;
+	uint32_t seeks;
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+	uint64_t busy_us;
+	uint64_t stream_us;			// Card time of the accesses done from the audio interrupt
+} simSdStats;
+
+typedef struct
+{
+	uint64_t blocks;
+	uint64_t samples;
+	uint64_t clipped;
+	int16_t peak;
+	uint64_t source_blocks;		// Blocks rendered by each source, added up
+	uint32_t peak_sources;
+	uint64_t mix_ns;			// Host time spent rendering and mixing
+} simAudioStats;
+
+// Virtual clock. Advancing it runs the service timer objects (every millisecond) and the
+// audio interrupt (every audio block) that fall in the elapsed interval.
+void simReset();
+void simAdvance(uint32_t us);
+uint64_t simMicros();
+bool simInInterrupt();
+
+// SD card model
+void simSetSdRoot(const char* path);
+const char* simGetSdRoot();
+void simSetSdTiming(uint32_t open_us, uint32_t access_us, uint32_t ns_per_byte);
+void simGetSdStats(simSdStats* stats);
+void simResetSdStats();
+
+// Debug serial
+void simSetSerialEcho(bool echo);
+void simSerialInput(const char* str);
+
+// Inputs
+void simSetButton(uint32_t pin, bool pressed);
+bool simGetButton(uint32_t pin);
+void simMotionPulse(uint8_t src);
+void simMotionTransient(uint8_t src);
+void simSetAcceleration(float x, float y, float z);
+
+// Audio output
+void simGetAudioStats(simAudioStats* stats);
+void simResetAudioStats();
+
+#endif /* __SIM_H__ */
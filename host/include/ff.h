@@ -0,0 +1,123 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### ff.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host stand-in for the FatFs API. Paths are resolved against the simulated SD root
+ * (see simSetSdRoot()), with '\' accepted as separator. Every access is charged to the
+ * virtual clock according to the configured SD timing model.
+ */
+
+#ifndef __FF_H__
+#define __FF_H__
+
+#include <stdint.h>
+
+typedef char TCHAR;
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t FSIZE_t;
+
+typedef enum
+{
+	FR_OK = 0,
+	FR_DISK_ERR,
+	FR_INT_ERR,
+	FR_NOT_READY,
+	FR_NO_FILE,
+	FR_NO_PATH,
+	FR_INVALID_NAME,
+	FR_DENIED,
+	FR_EXIST,
+	FR_INVALID_OBJECT,
+	FR_WRITE_PROTECTED,
+	FR_INVALID_DRIVE,
+	FR_NOT_ENABLED,
+	FR_NO_FILESYSTEM,
+	FR_MKFS_ABORTED,
+	FR_TIMEOUT,
+	FR_LOCKED,
+	FR_NOT_ENOUGH_CORE,
+	FR_TOO_MANY_OPEN_FILES,
+	FR_INVALID_PARAMETER
+} FRESULT;
+
+#define FA_READ				0x01
+#define FA_WRITE			0x02
+#define FA_OPEN_EXISTING	0x00
+#define FA_CREATE_NEW		0x04
+#define FA_CREATE_ALWAYS	0x08
+#define FA_OPEN_ALWAYS		0x10
+#define FA_OPEN_APPEND		0x30
+
+#define AM_RDO	0x01
+#define AM_HID	0x02
+#define AM_SYS	0x04
+#define AM_DIR	0x10
+#define AM_ARC	0x20
+
+typedef struct
+{
+	void* handle;
+	FSIZE_t fptr;
+	FSIZE_t fsize;
+	BYTE flag;
+} FIL;
+
+typedef struct
+{
+	void* handle;
+} DIR;
+
+typedef struct
+{
+	FSIZE_t fsize;
+	WORD fdate;
+	WORD ftime;
+	BYTE fattrib;
+	TCHAR fname[256];
+} FILINFO;
+
+#define f_size(fp)	((fp)->fsize)
+#define f_tell(fp)	((fp)->fptr)
+#define f_eof(fp)	((int)((fp)->fptr == (fp)->fsize))
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode);
+FRESULT f_close(FIL* fp);
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br);
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw);
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+FRESULT f_truncate(FIL* fp);
+FRESULT f_sync(FIL* fp);
+FRESULT f_opendir(DIR* dp, const TCHAR* path);
+FRESULT f_closedir(DIR* dp);
+FRESULT f_readdir(DIR* dp, FILINFO* fno);
+FRESULT f_stat(const TCHAR* path, FILINFO* fno);
+FRESULT f_unlink(const TCHAR* path);
+FRESULT f_rename(const TCHAR* path_old, const TCHAR* path_new);
+FRESULT f_mkdir(const TCHAR* path);
+
+#endif /* __FF_H__ */
@@ -0,0 +1,1587 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### pbsbench.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * pbsbench: host-side benchmark for PBSaber.
+ *
+ * Runs PBSaber against the host stand-ins with a virtual clock and reports:
+ *  - config: PBSConfig::loadProfile() cost over every profile of the configuration.
+ *  - strip:  PBSStrip::poll() cost for a running set of animations.
+ *  - boot:   PBSaber::begin() cost, and the time loop() takes to finish the boot.
+ *  - loop:   PBSaber::loop() iterations per second and per-state cost over a scripted
+ *            session (ignition, swings, clashes, blaster, lock-up, profile changes,
+ *            retraction).
+ *  - adpcm:  IMA-ADPCM decoding cost in the players, against the SD time it saves
+ *            compared to 16-bit PCM.
+ *  - resample: cost and quality of the polyphase resampler between the supported rates,
+ *            and its cost in a player.
+ *  - filter: cost and accuracy of the biquad filter of the players, still and moving.
+ *
+ * Host times are wall-clock times of the code under test. Virtual times include the SD
+ * card model, and are what the board would spend waiting on the card.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()		__rdtsc()
+#endif
+#include "PBSaber.h"
+#include "PBSAdpcm.h"
+#include "PBSResampler.h"
+#include "PBSBiquad.h"
+#include "Sim.h"
+
+#define BENCH_ONOFF_PIN		2
+#define BENCH_FX_PIN		3
+
+typedef struct
+{
+	const char* sd_root;
+	const char* config;
+	uint32_t profiles;
+	uint32_t fonts;
+	uint32_t leds;
+	uint32_t rounds;
+	uint32_t step_us;
+	uint32_t swing_depth;
+	uint32_t hum_pitch;
+	uint32_t hum_filter;
+	uint32_t music_filter;
+	float master_volume;
+	bool limiter;
+	bool verbose;
+} benchOptions;
+
+typedef struct
+{
+	uint64_t iterations;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t virtual_us;
+} stateStats;
+
+static benchOptions opt;
+static char work_dir[256];
+static saberStateId bench_state = stateOff;
+static stateStats state_stats[stateMAX];
+
+static uint64_t hostNanos()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static const char* stateName(saberStateId state)
+{
+	static const char* names[stateMAX] =
+	{
+		"OFF", "IDLE OFF", "MUSIC", "CYCLE PROFILES", "IGNITION", "IDLE ON", "RETRACTION",
+		"BLASTER", "LOCKUP", "CLASH", "SWING", "SPIN", "STAB", "FORCE", "NEXT PROFILE",
+		"PREV PROFILE"
+	};
+
+	return state < stateMAX ? names[state] : "UNKNOWN";
+}
+
+static void printSdStats(const char* label, uint32_t count)
+{
+	simSdStats sd;
+	simGetSdStats(&sd);
+
+	if (!count)
+		count = 1;
+
+	printf("  %-24s opens %.1f, reads %.1f, %.1f KiB, SD busy %.2f ms (per op)\n", label,
+		   (double) sd.opens / count, (double) sd.reads / count,
+		   (double) sd.bytes_read / 1024.0 / count, (double) sd.busy_us / 1000.0 / count);
+}
+
+static bool writeFile(const char* path, const char* content)
+{
+	FILE* f = fopen(path, "w");
+	if (!f)
+		return false;
+
+	fputs(content, f);
+	fclose(f);
+	return true;
+}
+
+// Mirrors a folder with real directories and symbolic links to the files, so files the
+// code under test writes (snapshots, manifests) stay in the work folder.
+extern void* hostOpenDir(const char* path);
+extern bool hostReadDir(void* handle, char* name, size_t size, bool* is_dir);
+extern void hostCloseDir(void* handle);
+
+static bool linkTree(const char* src, const char* dst)
+{
+	char name[256];
+	char src_path[512];
+	char dst_path[512];
+	bool is_dir;
+
+	if (mkdir(dst, 0755) != 0)
+		return false;
+
+	void* dir = hostOpenDir(src);
+	if (!dir)
+		return false;
+
+	bool ret = true;
+	while (ret && hostReadDir(dir, name, sizeof(name), &is_dir))
+	{
+		snprintf(src_path, sizeof(src_path), "%s/%s", src, name);
+		snprintf(dst_path, sizeof(dst_path), "%s/%s", dst, name);
+
+		if (is_dir)
+			ret = linkTree(src_path, dst_path);
+		else
+			ret = symlink(src_path, dst_path) == 0;
+	}
+
+	hostCloseDir(dir);
+	return ret;
+}
+
+// Generates a configuration with 'profiles' profiles and 'fonts' fonts, all based on the
+// Barlow font shipped in sd/fonts. Every 16th profile is complete and the following
+// ones inherit from it with as_profile, like real-world configurations do.
+static bool generateConfig()
+{
+	char path[512];
+	char src[512];
+
+	snprintf(work_dir, sizeof(work_dir), "/tmp/pbsbench.XXXXXX");
+	if (!mkdtemp(work_dir))
+		return false;
+
+	const char* links[] = { "fonts", "sndutil" };
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (opt.sd_root[0] == '/')
+			snprintf(src, sizeof(src), "%s/%s", opt.sd_root, links[i]);
+		else
+		{
+			char cwd[256];
+			if (!getcwd(cwd, sizeof(cwd)))
+				return false;
+			snprintf(src, sizeof(src), "%s/%s/%s", cwd, opt.sd_root, links[i]);
+		}
+
+		snprintf(path, sizeof(path), "%s/%s", work_dir, links[i]);
+		if (!linkTree(src, path))
+			return false;
+	}
+
+	size_t size = 16384 + opt.profiles * 1024 + opt.fonts * 1024;
+	char* ini = (char*) malloc(size);
+	char* p = ini;
+	char* end = ini + size;
+
+	p += snprintf(p, end - p,
+		"# Generated by pbsbench\n\n"
+		"[hardware]\n"
+		"blade_type = pixel\n"
+		"hbled_current =\n"
+		"pixel_type = ws2812\n"
+		"pixel_count = %u\n"
+		"onoff_button_pad = %u\n"
+		"onoff_button_pol = low\n"
+		"fx_button_pad = %u\n"
+		"fx_button_pol = low\n\n"
+		"[settings]\n"
+		"initial_profile = 1\n"
+		"update_initial_profile = yes\n"
+		"profile_count = 0\n"
+		"master_volume = %g\n"
+		"low_power = 0\n"
+		"audio_fs = 22050\n"
+		"swing_sensitivity = 3\n"
+		"clash_sensitivity = 3\n"
+		"swing_limiter = 300\n"
+		"clash_limiter = 300\n"
+		"spin_limiter = 300\n"
+		"button_debounce = 20\n"
+		"off_button_time = 1000\n"
+		"lock_button_time = 500\n"
+		"sound_utils = sndutil\n"
+		"dump_profile_info = no\n"
+		"dump_font_info = no\n"
+		"dump_boot_info = yes\n"
+		"boot_log = boot.log\n"
+		"dynamic_swing_depth = %u\n"
+		"hum_pitch = %u\n"
+		"hum_filter = %u\n"
+		"music_filter = %u\n"
+		"limiter = %s\n\n",
+		opt.leds, BENCH_ONOFF_PIN, BENCH_FX_PIN, opt.master_volume, opt.swing_depth,
+		opt.hum_pitch, opt.hum_filter, opt.music_filter, opt.limiter ? "yes" : "no");
+
+	for (uint32_t i = 1; i <= opt.fonts; i++)
+	{
+		if (i == 1)
+		{
+			p += snprintf(p, end - p,
+				"[font1]\n"
+				"title = Barlow\n"
+				"folder = fonts\\barlow\n"
+				"poly = yes\n"
+				"# Boot\nboot =\nboot_min_max =\n"
+				"# Hum\nhum = idle\nhum_min_max =\n"
+				"# Ignition\nignition = on\nignition_min_max =\n"
+				"# Retraction\nretraction = off\nretraction_min_max =\n"
+				"# Blaster\nblaster = hit\nblaster_min_max = 0,4\n"
+				"# Lock-up\nlock = idle\nlock_min_max =\n"
+				"# Swing\nswing = swing\nswing_min_max = 0,7\n"
+				"swingl = swing0\nswingl_min_max =\nswingh = swing4\nswingh_min_max =\n"
+				"# Clash\nclash = strike\nclash_min_max = 0,2\n"
+				"# Spin\nspin =\nspin_min_max =\n"
+				"# Stab\nstab = hit\nstab_min_max = 0,4\n"
+				"# Force\nforce =\nforce_min_max =\n"
+				"# Background music\nbackground =\nbackground_min_max =\n"
+				"# Font name\nname =\n\n");
+		} else {
+			p += snprintf(p, end - p,
+				"[font%u]\n"
+				"title = Barlow variant %u\n"
+				"folder = fonts\\barlow\n"
+				"poly = yes\n"
+				"as_font = 1\n"
+				"swing_min_max = 0,%u\n"
+				"clash_min_max = 0,%u\n\n",
+				i, i, 3 + (i % 5), i % 3);
+		}
+	}
+
+	for (uint32_t i = 1; i <= opt.profiles; i++)
+	{
+		if (i == 1 || (i % 16) == 1)
+		{
+			p += snprintf(p, end - p,
+				"[profile%u]\n\n"
+				"## Font\nfont = %u\n\n"
+				"## Ignition\nignition_mode = scroll\nignition_duration = 300\n\n"
+				"## Retraction\nretraction_mode = scroll\nretraction_duration = 0\n\n"
+				"## Shimmer\nshimmer_color = %u,%u,%u\nshimmer_mode = random\n"
+				"shimmer_depth = 20\nshimmer_freq = 20\n\n"
+				"## Clash\nclash_mode = flash_flicker\nclash_color = 255,100,0\n"
+				"clash_duration = 150\nclash_freq = 20\nclash_blend = 90\nclash_random = true\n\n"
+				"## Blaster\nblaster_mode = spark\nblaster_color = 255,0,0\n"
+				"blaster_duration = 750\nblaster_depth = 0\nblaster_blend = 100\n\n"
+				"## Stab\nstab_mode = tip_spark\nstab_color = 240,0,0\n"
+				"stab_duration = 1000\nstab_depth = 40\nstab_blend = 100\n\n"
+				"## Lock-up\nlockup_mode = flash_flicker\nlockup_color = 223,108,32\n"
+				"lockup_freq = 20\nlockup_blend = 100\nlockup_random = true\n\n",
+				i, 1 + (i / 16) % opt.fonts, (i * 37) % 256, (i * 91) % 256, (i * 53) % 256);
+		} else {
+			p += snprintf(p, end - p,
+				"[profile%u]\n"
+				"as_profile = %u\n"
+				"font = %u\n"
+				"shimmer_color = %u,%u,%u\n"
+				"clash_color = %u,%u,%u\n"
+				"blaster_color = 255,%u,0\n\n",
+				i, i - (i - 1) % 16, 1 + i % opt.fonts, (i * 37) % 256, (i * 91) % 256, (i * 53) % 256,
+				(i * 13) % 256, (i * 17) % 256, (i * 19) % 256, (i * 7) % 256);
+		}
+	}
+
+	snprintf(path, sizeof(path), "%s/config.ini", work_dir);
+	bool ret = writeFile(path, ini);
+	free(ini);
+
+	opt.sd_root = work_dir;
+	opt.config = "config.ini";
+	return ret;
+}
+
+static void cleanup()
+{
+	if (work_dir[0])
+	{
+		char cmd[300];
+		snprintf(cmd, sizeof(cmd), "rm -rf '%s'", work_dir);
+		if (system(cmd) != 0)
+			fprintf(stderr, "Could not remove %s\n", work_dir);
+	}
+}
+
+// Loads a profile and its font, as PBSaber does when switching profiles
+static bool loadProfile(PBSConfig* config, uint32_t id, saberProfile* profile, fontInfo* font)
+{
+	return config->loadProfile(id, profile) && config->loadFontInfo(profile->font_num, font);
+}
+
+static void benchConfig()
+{
+	PBSConfig config;
+
+	printf("config: PBSConfig::loadProfile() and loadFontInfo()\n");
+
+	simResetSdStats();
+	uint64_t virt = simMicros();
+	uint64_t host = hostNanos();
+
+	if (!config.open(opt.config) || !config.readAudioSettings() || !config.read())
+	{
+		printf("  cannot read %s\n", opt.config);
+		return;
+	}
+
+	printf("  open+read                %.3f ms host, %.2f ms virtual\n",
+		   (hostNanos() - host) / 1e6, (simMicros() - virt) / 1e3);
+	printSdStats("", 1);
+
+	uint32_t count = config.settings.profile_count;
+	saberProfile* profile = new saberProfile;
+	fontInfo* font = new fontInfo;
+	uint32_t loaded = 0;
+
+	simResetSdStats();
+	virt = simMicros();
+	host = hostNanos();
+
+	for (uint32_t r = 0; r < opt.rounds; r++)
+	{
+		for (uint32_t id = 1; id <= count; id++)
+		{
+			if (loadProfile(&config, id, profile, font))
+				loaded++;
+		}
+	}
+
+	uint64_t host_ns = hostNanos() - host;
+	uint64_t virt_us = simMicros() - virt;
+	uint32_t total = opt.rounds * count;
+
+	printf("  %u profiles x %u rounds   %u loaded, %.1f us host, %.2f ms virtual (per profile)\n",
+		   count, opt.rounds, loaded, host_ns / 1e3 / total, virt_us / 1e3 / total);
+	printSdStats("", total);
+
+	// First and last profile show how the cost depends on the position in the file
+	uint32_t ids[2] = { 1, count };
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		simResetSdStats();
+		virt = simMicros();
+		loadProfile(&config, ids[i], profile, font);
+		printf("  profile%-4u              %.2f ms virtual\n", ids[i],
+			   (simMicros() - virt) / 1e3);
+	}
+
+	// Same again, with the configuration snapshot. It's written a step per loop() pass.
+	uint32_t steps = 0;
+	uint64_t longest = 0;
+	bool done = false;
+
+	while (!done)
+	{
+		virt = simMicros();
+
+		if (!config.saveSnapshot(&done))
+		{
+			printf("  cannot write the configuration snapshot\n");
+			delete profile;
+			delete font;
+			return;
+		}
+
+		if (simMicros() - virt > longest)
+			longest = simMicros() - virt;
+
+		steps++;
+	}
+
+	printf("  write snapshot           %u steps, longest %.2f ms virtual\n", steps,
+		   longest / 1e3);
+
+	PBSConfig* cached = new PBSConfig;
+
+	simResetSdStats();
+	virt = simMicros();
+	host = hostNanos();
+
+	if (!cached->open(opt.config) || !cached->readAudioSettings() || !cached->read())
+	{
+		printf("  cannot read %s with snapshot\n", opt.config);
+		delete cached;
+		delete profile;
+		delete font;
+		return;
+	}
+
+	printf("  open+read (snapshot)     %.3f ms host, %.2f ms virtual\n",
+		   (hostNanos() - host) / 1e6, (simMicros() - virt) / 1e3);
+	printSdStats("", 1);
+
+	loaded = 0;
+	simResetSdStats();
+	virt = simMicros();
+	host = hostNanos();
+
+	for (uint32_t r = 0; r < opt.rounds; r++)
+	{
+		for (uint32_t id = 1; id <= count; id++)
+		{
+			if (loadProfile(cached, id, profile, font))
+				loaded++;
+		}
+	}
+
+	host_ns = hostNanos() - host;
+	virt_us = simMicros() - virt;
+
+	printf("  loadProfile (snapshot)   %u loaded, %.1f us host, %.2f ms virtual (per profile)\n",
+		   loaded, host_ns / 1e3 / total, virt_us / 1e3 / total);
+	printSdStats("", total);
+
+	delete cached;
+	delete profile;
+	delete font;
+}
+
+static void benchStrip()
+{
+	PBSStrip strip;
+	bladeEffect shimmer;
+	bladeEffect spark;
+
+	printf("strip: PBSStrip::poll() with %u LEDs\n", opt.leds);
+
+	if (!strip.begin(opt.leds, WS2812B))
+	{
+		printf("  cannot initialize strip\n");
+		return;
+	}
+
+	memset((void*) &shimmer, 0, sizeof(shimmer));
+	shimmer.type = effectTypeShimmer;
+	shimmer.base_color = COLOR(160, 220, 244);
+	shimmer.freq = 20;
+	shimmer.depth = 20;
+	shimmer.randomize = true;
+
+	spark = shimmer;
+	spark.type = effectTypeSpark;
+	spark.base_color = COLOR(255, 0, 0);
+
+	strip.setSection(0, 1, opt.leds);
+	strip.baseShimmer(&shimmer, 0);
+	strip.playAnimations();
+
+	uint64_t polls = 0;
+	uint64_t total = 0;
+	uint64_t max = 0;
+	uint32_t frames = strip.getFrameCount();
+
+	for (uint32_t r = 0; r < opt.rounds * 100; r++)
+	{
+		if ((r % 50) == 0)
+			strip.spark(&spark, 500, 1 + getRandom(0, opt.leds / 2), 10, 100, 0);
+
+		uint64_t start = hostNanos();
+		strip.poll();
+		uint64_t elapsed = hostNanos() - start;
+
+		total += elapsed;
+		if (elapsed > max)
+			max = elapsed;
+		polls++;
+
+		simAdvance(strip.getUpdateRate() * 1000);
+	}
+
+	printf("  %llu polls, %u frames     avg %.2f us, max %.2f us host\n",
+		   (unsigned long long) polls, strip.getFrameCount() - frames,
+		   total / 1e3 / polls, max / 1e3);
+}
+
+static void onNewStateCallback(saberStateId state)
+{
+	bench_state = state;
+}
+
+static PBSaber* saber;
+
+static void run(uint32_t ms)
+{
+	uint64_t end = simMicros() + (uint64_t) ms * 1000;
+
+	while (simMicros() < end)
+	{
+		saberStateId state = bench_state;
+		uint64_t virt = simMicros();
+
+		uint64_t start = hostNanos();
+		saber->loop();
+		uint64_t elapsed = hostNanos() - start;
+		simAdvance(opt.step_us);
+
+		state_stats[state].iterations++;
+		state_stats[state].total_ns += elapsed;
+		if (elapsed > state_stats[state].max_ns)
+			state_stats[state].max_ns = elapsed;
+		state_stats[state].virtual_us += simMicros() - virt;
+	}
+}
+
+static void press(uint32_t pin, uint32_t ms)
+{
+	simSetButton(pin, true);
+	run(ms);
+	simSetButton(pin, false);
+}
+
+// Swings the blade back and forth, updating the accelerometer every millisecond
+static void swingMotion(uint32_t ms, uint32_t period_ms)
+{
+	for (uint32_t i = 0; i < ms; i++)
+	{
+		float phase = 2.0f * (float) M_PI * (i % period_ms) / period_ms;
+		simSetAcceleration(0, 1.5f * sinf(phase), 1.0f);
+		run(1);
+	}
+
+	simSetAcceleration(0, 0, 1.0f);
+}
+
+static void benchBoot()
+{
+	printf("boot: PBSaber::begin()\n");
+
+	saber = new PBSaber();
+	saber->setNewStateCallback(onNewStateCallback);
+
+	simResetSdStats();
+	uint64_t virt = simMicros();
+	uint64_t host = hostNanos();
+
+	if (!saber->begin(opt.config))
+	{
+		printf("  begin() failed\n");
+		delete saber;
+		saber = NULL;
+		return;
+	}
+
+	printf("  begin()                  %.3f ms host, %.2f ms virtual\n",
+		   (hostNanos() - host) / 1e6, (simMicros() - virt) / 1e3);
+
+	// The rest of the boot runs from loop()
+	uint64_t loop_host = 0;
+	uint64_t limit = simMicros() + 10000000;
+
+	while (!saber->ready() && simMicros() < limit)
+	{
+		uint64_t start = hostNanos();
+		saber->loop();
+		loop_host += hostNanos() - start;
+		simAdvance(opt.step_us);
+	}
+
+	if (!saber->ready())
+	{
+		printf("  boot didn't finish\n");
+		delete saber;
+		saber = NULL;
+		return;
+	}
+
+	printf("  ready                    %.3f ms host, %.2f ms virtual\n",
+		   (hostNanos() - host) / 1e6, (simMicros() - virt) / 1e3);
+	printf("  loop() while booting     %.3f ms host\n", loop_host / 1e6);
+	printSdStats("", 1);
+}
+
+static void benchLoop()
+{
+	if (!saber)
+		return;
+
+	printf("loop: PBSaber::loop(), %u us virtual per iteration\n", opt.step_us);
+
+	memset(state_stats, 0, sizeof(state_stats));
+	simResetSdStats();
+	simResetAudioStats();
+	saber->resetMixerStats();
+	uint64_t virt = simMicros();
+
+	// Off, then ignition
+	run(500);
+	press(BENCH_ONOFF_PIN, 150);
+	run(1500);
+	run(2000);
+
+	// Swings, clash and stab
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		simMotionTransient(MotionTransientOnY);
+		run(350);
+	}
+
+	// Continuous motion, for smooth swing (-w)
+	swingMotion(1000, 400);
+	run(500);
+
+	simMotionPulse(MotionPulseOnY);
+	run(500);
+	simMotionPulse(MotionPulseOnX | MotionPulseNegativeX);
+	run(500);
+
+	// Fast combat: clashes and swings on top of each other
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		simMotionPulse(MotionPulseOnY);
+		run(320);
+		simMotionTransient(MotionTransientOnZ);
+		run(20);
+	}
+
+	run(1000);
+
+	// Blaster and lock-up
+	press(BENCH_FX_PIN, 100);
+	run(800);
+	press(BENCH_FX_PIN, 1200);
+	run(300);
+
+	// Next profile (FX held, On/Off pressed), then previous (On/Off held, FX pressed)
+	simSetButton(BENCH_FX_PIN, true);
+	run(100);
+	press(BENCH_ONOFF_PIN, 100);
+	simSetButton(BENCH_FX_PIN, false);
+	run(1000);
+
+	simSetButton(BENCH_ONOFF_PIN, true);
+	run(100);
+	press(BENCH_FX_PIN, 100);
+	simSetButton(BENCH_ONOFF_PIN, false);
+	run(1000);
+
+	// Next profile again, saved as the initial profile when going off
+	simSetButton(BENCH_FX_PIN, true);
+	run(100);
+	press(BENCH_ONOFF_PIN, 100);
+	simSetButton(BENCH_FX_PIN, false);
+	run(1000);
+
+	// Retraction
+	press(BENCH_ONOFF_PIN, 1200);
+	run(1500);
+
+	// Profile change while off
+	press(BENCH_FX_PIN, 100);
+	run(1000);
+
+	uint64_t iterations = 0;
+	uint64_t total_ns = 0;
+
+	printf("  %-16s %10s %12s %12s %14s %12s\n", "state", "iters", "avg (us)", "max (us)",
+		   "loops/s (host)", "virtual (ms)");
+
+	for (uint32_t i = 0; i < stateMAX; i++)
+	{
+		stateStats* s = &state_stats[i];
+		if (!s->iterations)
+			continue;
+
+		iterations += s->iterations;
+		total_ns += s->total_ns;
+
+		double avg = (double) s->total_ns / s->iterations;
+		printf("  %-16s %10llu %12.2f %12.2f %14.0f %12.1f\n", stateName((saberStateId) i),
+			   (unsigned long long) s->iterations, avg / 1e3, s->max_ns / 1e3,
+			   avg > 0 ? 1e9 / avg : 0, s->virtual_us / 1e3);
+	}
+
+	double avg = iterations ? (double) total_ns / iterations : 0;
+	printf("  %-16s %10llu %12.2f %12s %14.0f\n", "total", (unsigned long long) iterations,
+		   avg / 1e3, "", avg > 0 ? 1e9 / avg : 0);
+	printf("  session                  %.2f s virtual\n", (simMicros() - virt) / 1e6);
+	printSdStats("", 1);
+
+	// Event to first sample, as measured by the saber itself
+	printf("  %-16s %10s %10s %10s %10s %10s\n", "latency", "count", "min (us)", "avg (us)",
+		   "p99 (us)", "max (us)");
+
+	for (uint32_t i = 0; i < stateMAX; i++)
+	{
+		latencyStats stats;
+		if (!saber->getLatency((saberStateId) i, &stats))
+			continue;
+
+		printf("  %-16s %10u %10u %10u %10u %10u\n", stateName((saberStateId) i), stats.count,
+			   stats.min, stats.avg, stats.p99, stats.max);
+	}
+
+	// Effect voices, and what each playing source costs to the mixer
+	const voiceStats* voices = saber->getVoiceStats();
+	simAudioStats audio;
+	simGetAudioStats(&audio);
+
+	printf("  voices                   %u, peak %u, %u sounds, %u stolen, %u dropped\n",
+		   PBS_FX_VOICES, voices->peak, voices->allocations, voices->steals, voices->drops);
+
+	// SD streaming of each priority
+	static const char* stream_names[streamPriorityMax] = { "effects", "hum", "music" };
+	printf("  %-16s %10s %10s %10s %10s %12s %12s\n", "streams", "reads", "KiB", "underruns",
+		   "sounds", "onset (us)", "refill (us)");
+
+	for (uint32_t i = 0; i < streamPriorityMax; i++)
+	{
+		const streamStats* stream = saber->getStreamStats((streamPriority) i);
+
+		printf("  %-16s %10u %10.1f %10u %10u %12u %12u\n", stream_names[i], stream->reads,
+			   stream->bytes / 1024.0, stream->underruns, stream->onsets, stream->max_onset_us,
+			   stream->max_wait_us);
+	}
+
+	// What the players cost to the mixer of the saber
+	const mixerStats* mixed = saber->getMixerStats();
+
+	printf("  mixing                   %.2f players per block, peak %u, %.2f us host per "
+		   "block\n", mixed->blocks ? (double) mixed->player_blocks / mixed->blocks : 0,
+		   mixed->peak_players, audio.blocks ? audio.mix_ns / 1e3 / audio.blocks : 0);
+
+	// Master output: what the limiter took off, and what was still clipped
+	const limiterStats* limiter = saber->getLimiterStats();
+	limiterStats off;
+
+	if (!limiter)
+	{
+		memset(&off, 0, sizeof(off));
+		off.min_gain = 32768;
+		limiter = &off;
+	}
+
+	printf("  master                   peak %d, %llu samples clipped, %u/%u blocks limited, "
+		   "deepest %.1f dB\n", audio.peak,
+		   (unsigned long long) (mixed->clipped + limiter->clipped), limiter->limited_blocks,
+		   limiter->blocks, 20 * log10(limiter->min_gain > 0 ? limiter->min_gain / 32768.0 :
+		   1 / 32768.0));
+}
+
+// Writes a mono WAV file, 16-bit PCM or IMA-ADPCM. With loop_end, a smpl chunk before the
+// data gives the loop region (loop_end is past its last frame).
+static bool writeWav(const char* path, uint32_t fs, bool adpcm, uint16_t block_align,
+					 const void* data, uint32_t size, uint32_t loop_start = 0,
+					 uint32_t loop_end = 0)
+{
+	uint8_t fmt[20];
+	uint32_t smpl[15];
+	uint32_t smpl_size = sizeof(smpl);
+	uint32_t fmt_size = adpcm ? 20 : 16;
+	uint32_t riff_size = 4 + 8 + fmt_size + 8 + size + (size & 1) +
+						 (loop_end ? 8 + smpl_size : 0);
+	uint16_t bits = adpcm ? 4 : 16;
+	uint16_t align = adpcm ? block_align : 2;
+	uint32_t rate = adpcm ? (uint32_t) ((uint64_t) fs * block_align /
+										PBSAdpcm::blockFrames(block_align, 1)) : fs * 2;
+	uint16_t tag = adpcm ? PBS_ADPCM_FORMAT : 1;
+	uint16_t channels = 1;
+	uint16_t extra = 2;
+	uint16_t frames = (uint16_t) PBSAdpcm::blockFrames(block_align, 1);
+
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+
+	memcpy(fmt, &tag, 2);
+	memcpy(fmt + 2, &channels, 2);
+	memcpy(fmt + 4, &fs, 4);
+	memcpy(fmt + 8, &rate, 4);
+	memcpy(fmt + 12, &align, 2);
+	memcpy(fmt + 14, &bits, 2);
+	memcpy(fmt + 16, &extra, 2);
+	memcpy(fmt + 18, &frames, 2);
+
+	bool ret = fwrite("RIFF", 1, 4, f) == 4 && fwrite(&riff_size, 4, 1, f) == 1 &&
+			   fwrite("WAVEfmt ", 1, 8, f) == 8 && fwrite(&fmt_size, 4, 1, f) == 1 &&
+			   fwrite(fmt, 1, fmt_size, f) == fmt_size;
+
+	if (loop_end)
+	{
+		// One forward loop, no sampler data
+		memset(smpl, 0, sizeof(smpl));
+		smpl[2] = 1000000000 / fs;
+		smpl[3] = 60;
+		smpl[7] = 1;
+		smpl[11] = loop_start;
+		smpl[12] = loop_end - 1;
+
+		ret = ret && fwrite("smpl", 1, 4, f) == 4 && fwrite(&smpl_size, 4, 1, f) == 1 &&
+			  fwrite(smpl, 1, smpl_size, f) == smpl_size;
+	}
+
+	ret = ret && fwrite("data", 1, 4, f) == 4 && fwrite(&size, 4, 1, f) == 1 &&
+		  fwrite(data, 1, size, f) == size;
+
+	if (size & 1)
+		fputc(0, f);
+
+	return fclose(f) == 0 && ret;
+}
+
+static bool playWav(const char* label, const char* path, double* sd_ms, double* mix_ms)
+{
+	// Streams the whole file through a player, in virtual time, refilling it every audio
+	// block. Returns the SD card time and the host time of the mixing per second of audio.
+	PBSMixer mixer;
+	PBSPlayer player;
+	simSdStats sd;
+	simAudioStats audio;
+
+	mixer.add(&player);
+	mixer.begin();
+	simResetSdStats();
+	simResetAudioStats();
+	uint64_t virt = simMicros();
+
+	if (!player.play(path))
+	{
+		printf("  %-24s cannot play %s\n", label, path);
+		return false;
+	}
+
+	while (player.playing())
+	{
+		mixer.service();
+		simAdvance(Audio.blockPeriodUs());
+	}
+
+	double seconds = (simMicros() - virt) / 1e6;
+	uint32_t blocks = mixer.getStats()->blocks;
+	simGetSdStats(&sd);
+	simGetAudioStats(&audio);
+
+	printf("  %-24s %10.1f %10u %12.2f %12.2f %12.2f\n", label, sd.bytes_read / 1024.0,
+		   sd.reads, sd.busy_us / 1e3, sd.busy_us / 1e3 / seconds,
+		   blocks ? audio.mix_ns / 1e3 / blocks : 0);
+
+	*sd_ms = sd.busy_us / 1e3 / seconds;
+	*mix_ms = audio.mix_ns / 1e6 / seconds;
+	return true;
+}
+
+static void benchAdpcm()
+{
+	const uint32_t seconds = 10;
+	const uint16_t block_align = 512;
+	char dir[64];
+	char pcm_path[128];
+	char adpcm_path[128];
+
+	if (!Audio.initialized())
+		Audio.begin(22050, 16, false);
+
+	uint32_t fs = Audio.getSampleRate();
+	uint32_t block_frames = PBSAdpcm::blockFrames(block_align, 1);
+	uint32_t blocks = (fs * seconds) / block_frames;
+	uint32_t frames = blocks * block_frames;
+
+	printf("adpcm: IMA-ADPCM against 16-bit PCM, %u s mono at %u Hz, %u-byte blocks\n",
+		   seconds, fs, block_align);
+
+	// A hum-like test signal: a buzzing tone with harmonics, a slow sweep and some noise
+	int16_t* pcm = (int16_t*) malloc(frames * sizeof(int16_t));
+	int16_t* decoded = (int16_t*) malloc(frames * sizeof(int16_t));
+	uint8_t* adpcm = (uint8_t*) malloc(blocks * block_align);
+	float phase = 0;
+	float sweep = 0;
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		float t = (float) i / fs;
+		phase += 2.0f * (float) M_PI * 90.0f / fs;
+		sweep += 2.0f * (float) M_PI * (200.0f + 800.0f * (0.5f + 0.5f * sinf(t))) / fs;
+
+		float v = 0.35f * sinf(phase) + 0.15f * sinf(phase * 2) + 0.08f * sinf(phase * 5) +
+				  0.15f * sinf(sweep) + 0.02f * ((float) getRandom(0, 2000) / 1000.0f - 1.0f);
+		pcm[i] = (int16_t) (v * 32767);
+	}
+
+	uint8_t index = 0;
+	for (uint32_t b = 0; b < blocks; b++)
+		PBSAdpcm::encodeBlock(pcm + b * block_frames, block_frames, 1, &index,
+							  adpcm + b * block_align);
+
+	// Decoding alone, and the quality it gives
+	uint64_t start = hostNanos();
+	for (uint32_t r = 0; r < opt.rounds; r++)
+	{
+		for (uint32_t b = 0; b < blocks; b++)
+			PBSAdpcm::decodeBlock(adpcm + b * block_align, block_align, 1,
+								  decoded + b * block_frames);
+	}
+
+	uint64_t decode_ns = hostNanos() - start;
+	double signal = 0, noise = 0;
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		double err = (double) pcm[i] - decoded[i];
+		signal += (double) pcm[i] * pcm[i];
+		noise += err * err;
+	}
+
+	printf("  decode                   %.2f ns host per sample, %.1f dB SNR, %.1f:1\n",
+		   (double) decode_ns / ((uint64_t) frames * opt.rounds),
+		   noise > 0 ? 10.0 * log10(signal / noise) : 0, (double) frames * 2 / (blocks * block_align));
+
+	// Streaming through a player, from the simulated SD card
+	snprintf(dir, sizeof(dir), "/tmp/pbsbench.XXXXXX");
+	if (!mkdtemp(dir))
+	{
+		printf("  cannot create a temporary folder\n");
+		free(pcm);
+		free(decoded);
+		free(adpcm);
+		return;
+	}
+
+	snprintf(pcm_path, sizeof(pcm_path), "%s/pcm.wav", dir);
+	snprintf(adpcm_path, sizeof(adpcm_path), "%s/adpcm.wav", dir);
+
+	if (writeWav(pcm_path, fs, false, 0, pcm, frames * sizeof(int16_t)) &&
+		writeWav(adpcm_path, fs, true, block_align, adpcm, blocks * block_align))
+	{
+		printf("  %-24s %10s %10s %12s %12s %12s\n", "format", "KiB", "reads", "SD busy (ms)",
+			   "ms per s", "mix us/block");
+
+		double pcm_sd, pcm_mix, adpcm_sd, adpcm_mix;
+
+		simSetSdRoot(dir);
+		if (playWav("PCM 16-bit", "pcm.wav", &pcm_sd, &pcm_mix) &&
+			playWav("IMA-ADPCM", "adpcm.wav", &adpcm_sd, &adpcm_mix))
+		{
+			printf("  per second of audio      %.2f ms of SD saved, for %.3f ms host of "
+				   "decoding\n", pcm_sd - adpcm_sd, adpcm_mix - pcm_mix);
+		}
+
+		simSetSdRoot(opt.sd_root);
+	} else {
+		printf("  cannot write the test files\n");
+	}
+
+	unlink(pcm_path);
+	unlink(adpcm_path);
+	rmdir(dir);
+	free(pcm);
+	free(decoded);
+	free(adpcm);
+}
+
+static double resampleRun(uint32_t in_fs, uint32_t out_fs, double* ns, double* cycles)
+{
+	// Resamples 1 s of a 1 kHz tone and returns the SNR of the output against the ideal
+	// tone at the output rate. The first samples are the filter filling up, and are left out.
+	const double freq = 1000.0;
+	const uint32_t skip = PBS_RESAMPLER_TAPS * 4;
+	uint32_t in_count = in_fs;
+	uint32_t out_count = (uint32_t) ((uint64_t) in_fs * out_fs / in_fs) - skip;
+	int16_t* in = (int16_t*) malloc(in_count * sizeof(int16_t));
+	int16_t* out = (int16_t*) malloc(out_count * sizeof(int16_t));
+	uint64_t elapsed = 0;
+	uint64_t ticks = 0;
+	uint32_t produced = 0;
+	PBSResampler resampler;
+
+	for (uint32_t i = 0; i < in_count; i++)
+		in[i] = (int16_t) lrint(16000.0 * sin(2 * M_PI * freq * i / in_fs));
+
+	resampler.begin(in_fs, out_fs);
+
+	for (uint32_t r = 0; r < opt.rounds; r++)
+	{
+		uint32_t taken = 0;
+
+		resampler.reset();
+		produced = 0;
+
+		// Blocks of output at a time, as the mixer asks for them
+		while (produced < out_count)
+		{
+			uint32_t count = out_count - produced < AUDIO_BLOCK_SAMPLES ?
+							 out_count - produced : AUDIO_BLOCK_SAMPLES;
+			uint32_t done = 0;
+			uint64_t start = hostNanos();
+#ifdef BENCH_CYCLES
+			uint64_t tsc = BENCH_CYCLES();
+#endif
+
+			while (done < count)
+			{
+				uint32_t space = resampler.getSpace();
+				if (space > in_count - taken)
+					space = in_count - taken;
+
+				memcpy(resampler.getInput(), in + taken, space * sizeof(int16_t));
+				resampler.commit(space);
+				taken += space;
+
+				uint32_t n = resampler.read(out + produced + done, count - done);
+				done += n;
+
+				if (!n && !space)
+					break;
+			}
+
+#ifdef BENCH_CYCLES
+			ticks += BENCH_CYCLES() - tsc;
+#endif
+			elapsed += hostNanos() - start;
+
+			if (!done)
+				break;
+
+			produced += done;
+		}
+	}
+
+	double signal = 0, noise = 0;
+	for (uint32_t i = skip; i < produced; i++)
+	{
+		double ideal = 16000.0 * sin(2 * M_PI * freq * ((double) i * in_fs / out_fs) / in_fs);
+		double err = out[i] - ideal;
+		signal += ideal * ideal;
+		noise += err * err;
+	}
+
+	*ns = (double) elapsed / ((uint64_t) produced * opt.rounds);
+	*cycles = (double) ticks / ((uint64_t) produced * opt.rounds);
+	free(in);
+	free(out);
+	return noise > 0 ? 10.0 * log10(signal / noise) : 0;
+}
+
+static void benchResample()
+{
+	static const uint32_t rates[] = { 22050, 32000, 44100, 48000 };
+	const uint32_t count = sizeof(rates) / sizeof(rates[0]);
+	char dir[64];
+	char path[128];
+
+	printf("resample: %u-tap polyphase filter, %u phases, 1 kHz tone\n", PBS_RESAMPLER_TAPS,
+		   PBS_RESAMPLER_PHASES);
+	printf("  %-24s %14s %14s %10s\n", "rates", "ns/sample", "cycles/sample", "SNR (dB)");
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		for (uint32_t o = 0; o < count; o++)
+		{
+			char label[32];
+			double ns, cycles;
+
+			if (i == o)
+				continue;
+
+			double snr = resampleRun(rates[i], rates[o], &ns, &cycles);
+			snprintf(label, sizeof(label), "%u -> %u", rates[i], rates[o]);
+
+#ifdef BENCH_CYCLES
+			printf("  %-24s %14.2f %14.1f %10.1f\n", label, ns, cycles, snr);
+#else
+			printf("  %-24s %14.2f %14s %10.1f\n", label, ns, "-", snr);
+#endif
+		}
+	}
+
+#ifdef BENCH_CYCLES
+	printf("  cycles are host time stamp counter cycles per output sample\n");
+#endif
+
+	// The same tone played by a player at the output rate and at the others
+	if (!Audio.initialized())
+		Audio.begin(22050, 16, false);
+
+	snprintf(dir, sizeof(dir), "/tmp/pbsbench.XXXXXX");
+	if (!mkdtemp(dir))
+	{
+		printf("  cannot create a temporary folder\n");
+		return;
+	}
+
+	printf("  %-24s %10s %10s %12s %12s %12s\n", "played at", "KiB", "reads", "SD busy (ms)",
+		   "ms per s", "mix us/block");
+
+	simSetSdRoot(dir);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint32_t seconds = 5;
+		uint32_t frames = rates[i] * seconds;
+		int16_t* pcm = (int16_t*) malloc(frames * sizeof(int16_t));
+		char label[32];
+		double sd, mix;
+
+		for (uint32_t n = 0; n < frames; n++)
+			pcm[n] = (int16_t) lrint(16000.0 * sin(2 * M_PI * 1000.0 * n / rates[i]));
+
+		snprintf(path, sizeof(path), "%s/tone.wav", dir);
+		snprintf(label, sizeof(label), "%u Hz%s", rates[i],
+				 rates[i] == Audio.getSampleRate() ? " (output)" : "");
+
+		if (writeWav(path, rates[i], false, 0, pcm, frames * sizeof(int16_t)))
+			playWav(label, "tone.wav", &sd, &mix);
+		else
+			printf("  cannot write the test files\n");
+
+		unlink(path);
+		free(pcm);
+	}
+
+	simSetSdRoot(opt.sd_root);
+	rmdir(dir);
+}
+
+// Direct form I in double precision, to compare against
+static void referenceBiquad(PBSBiquadType type, double freq, double q, uint32_t fs,
+							const int16_t* in, double* out, uint32_t count)
+{
+	double w0 = 2 * M_PI * freq / fs;
+	double cosw = cos(w0);
+	double alpha = sin(w0) / (2 * q);
+	double b0, b1, b2;
+
+	if (type == BiquadLowPass)
+	{
+		b0 = b2 = (1 - cosw) / 2;
+		b1 = 1 - cosw;
+	} else if (type == BiquadHighPass)
+	{
+		b0 = b2 = (1 + cosw) / 2;
+		b1 = -(1 + cosw);
+	} else {
+		b0 = alpha;
+		b1 = 0;
+		b2 = -alpha;
+	}
+
+	double a0 = 1 + alpha, a1 = -2 * cosw, a2 = 1 - alpha;
+	double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		double y = (b0 * in[i] + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2) / a0;
+		x2 = x1;
+		x1 = in[i];
+		y2 = y1;
+		y1 = y;
+		out[i] = y;
+	}
+}
+
+static void benchFilter()
+{
+	typedef struct
+	{
+		const char* name;
+		PBSBiquadType type;
+		float freq;
+		bool moving;					// Cutoff swept every block, up to 8 times 'freq'
+	} filterCase;
+
+	static const filterCase cases[] =
+	{
+		{ "low-pass 300 Hz",		BiquadLowPass,	300,	false },
+		{ "low-pass 3000 Hz",		BiquadLowPass,	3000,	false },
+		{ "high-pass 1000 Hz",		BiquadHighPass,	1000,	false },
+		{ "band-pass 2000 Hz",		BiquadBandPass,	2000,	false },
+		{ "high-pass 4000 Hz",		BiquadHighPass,	4000,	false },
+		{ "low-pass 300 Hz, moving",	BiquadLowPass,	300,	true },
+		{ "low-pass 1000 Hz, moving",	BiquadLowPass,	1000,	true },
+	};
+
+	const uint32_t seconds = 2;
+	uint32_t fs = Audio.initialized() ? Audio.getSampleRate() : 22050;
+	uint32_t count = fs * seconds;
+	int16_t* in = (int16_t*) malloc(count * sizeof(int16_t));
+	int16_t* out = (int16_t*) malloc(count * sizeof(int16_t));
+	double* ref = (double*) malloc(count * sizeof(double));
+
+	// Hum-like signal: harmonics of 90 Hz and some noise
+	for (uint32_t i = 0; i < count; i++)
+	{
+		double t = (double) i / fs;
+		double v = 0.3 * sin(2 * M_PI * 90 * t) + 0.15 * sin(2 * M_PI * 270 * t) +
+				   0.1 * sin(2 * M_PI * 1130 * t) + 0.05 * sin(2 * M_PI * 4410 * t) +
+				   0.05 * ((double) getRandom(0, 2000) / 1000.0 - 1.0);
+		in[i] = (int16_t) lrint(v * 32767);
+	}
+
+	printf("filter: biquad, %u Hz, %u-sample segments while moving\n", fs, PBS_BIQUAD_SEGMENT);
+	printf("  %-28s %8s %12s %14s %10s\n", "filter", "kernel", "ns/sample", "cycles/sample",
+		   "SNR (dB)");
+
+	for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		const filterCase* fc = &cases[c];
+		PBSBiquad filter;
+		uint64_t elapsed = 0;
+		uint64_t ticks = 0;
+		bool precise = false;
+
+		for (uint32_t r = 0; r < opt.rounds; r++)
+		{
+			memcpy(out, in, count * sizeof(int16_t));
+			filter.reset();
+			filter.set(fc->type, fc->freq, 0.707f, fs, 0);
+			precise = filter.precise();
+
+			for (uint32_t pos = 0; pos < count; pos += AUDIO_BLOCK_SAMPLES)
+			{
+				uint32_t n = count - pos < AUDIO_BLOCK_SAMPLES ? count - pos :
+							 AUDIO_BLOCK_SAMPLES;
+
+				if (fc->moving)
+				{
+					float level = 0.5f + 0.5f * sinf(2.0f * (float) M_PI * pos / fs);
+					filter.set(fc->type, fc->freq * exp2f(3.0f * level), 0.707f, fs, n);
+				}
+
+				uint64_t start = hostNanos();
+#ifdef BENCH_CYCLES
+				uint64_t tsc = BENCH_CYCLES();
+#endif
+				filter.process(out + pos, n);
+#ifdef BENCH_CYCLES
+				ticks += BENCH_CYCLES() - tsc;
+#endif
+				elapsed += hostNanos() - start;
+			}
+		}
+
+		char snr[16] = "-";
+		if (!fc->moving)
+		{
+			double signal = 0, noise = 0;
+
+			referenceBiquad(fc->type, fc->freq, 0.707, fs, in, ref, count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				signal += ref[i] * ref[i];
+				noise += (out[i] - ref[i]) * (out[i] - ref[i]);
+			}
+
+			snprintf(snr, sizeof(snr), "%.1f", noise > 0 ? 10.0 * log10(signal / noise) : 0);
+		}
+
+#ifdef BENCH_CYCLES
+		char cycles[16];
+		snprintf(cycles, sizeof(cycles), "%.1f", (double) ticks / ((uint64_t) count * opt.rounds));
+#else
+		const char* cycles = "-";
+#endif
+
+		printf("  %-28s %8s %12.2f %14s %10s\n", fc->name, precise ? "Q31" : "Q15",
+			   (double) elapsed / ((uint64_t) count * opt.rounds), cycles, snr);
+	}
+
+	free(in);
+	free(out);
+	free(ref);
+}
+
+// Plays a sound in a loop, in a mixer that is not attached to the audio engine, to look at
+// what it renders
+class SeamPlayer : public PBSPlayer
+{
+public:
+	bool open(const char* path) { return play(path, PlayModeLoop); }
+	uint32_t take(int16_t* buffer, uint32_t samples) { return render(buffer, samples); }
+};
+
+static uint32_t maxStep(const int16_t* samples, uint32_t count)
+{
+	uint32_t step = 0;
+
+	for (uint32_t i = 1; i < count; i++)
+	{
+		uint32_t d = (uint32_t) abs(samples[i] - samples[i - 1]);
+		if (d > step)
+			step = d;
+	}
+
+	return step;
+}
+
+static void seamRun(const char* label, const char* path, uint32_t loops, uint32_t frames,
+					uint32_t sound_step)
+{
+	// The largest step between two samples after the sound has started, seams included,
+	// against the largest one inside the sound
+	PBSMixer mixer;
+	SeamPlayer player;
+	simSdStats sd;
+	uint32_t count = frames * loops;
+	uint32_t skip = Audio.getSampleRate() / 2;
+	int16_t* out = (int16_t*) malloc(count * sizeof(int16_t));
+
+	mixer.add(&player);
+	simResetSdStats();
+
+	if (!player.open(path))
+	{
+		printf("  %-24s cannot play %s\n", label, path);
+		free(out);
+		return;
+	}
+
+	for (uint32_t pos = 0; pos < count; pos += AUDIO_BLOCK_SAMPLES)
+	{
+		uint32_t n = count - pos < AUDIO_BLOCK_SAMPLES ? count - pos : AUDIO_BLOCK_SAMPLES;
+
+		mixer.service();
+		simAdvance(Audio.blockPeriodUs());
+		player.take(out + pos, n);
+	}
+
+	player.stop();
+	simGetSdStats(&sd);
+
+	printf("  %-24s %10u %10u %10u %10u %10u\n", label, maxStep(out + skip, count - skip),
+		   sound_step, sd.reads, sd.seeks, player.getUnderruns());
+
+	free(out);
+}
+
+static void benchSeam()
+{
+	const uint32_t loops = 6;
+	const uint16_t block_align = 512;
+	char dir[64];
+	char path[128];
+
+	if (!Audio.initialized())
+		Audio.begin(22050, 16, false);
+
+	uint32_t fs = Audio.getSampleRate();
+	uint32_t block_frames = PBSAdpcm::blockFrames(block_align, 1);
+	uint32_t blocks = (fs * 3) / block_frames;
+	uint32_t frames = blocks * block_frames;
+
+	// Loop points that don't fall on matching parts of the wave
+	uint32_t loop_start = fs * 2 / 5 + 17;
+	uint32_t loop_end = frames - fs / 3 - 5;
+
+	printf("seam: hum-like sound of %.2f s looped %u times, loop region %u-%u, %u Hz\n",
+		   (double) frames / fs, loops, loop_start, loop_end, fs);
+
+	int16_t* pcm = (int16_t*) malloc(frames * sizeof(int16_t));
+	int16_t* decoded = (int16_t*) malloc(frames * sizeof(int16_t));
+	uint8_t* adpcm = (uint8_t*) malloc(blocks * block_align);
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		double t = (double) i / fs;
+		double v = (0.7 + 0.3 * sin(2 * M_PI * 0.7 * t)) *
+				   (0.3 * sin(2 * M_PI * 90 * t) + 0.15 * sin(2 * M_PI * 183 * t) +
+					0.05 * sin(2 * M_PI * 455 * t));
+		pcm[i] = (int16_t) lrint(v * 32767);
+	}
+
+	uint8_t index = 0;
+	for (uint32_t b = 0; b < blocks; b++)
+	{
+		PBSAdpcm::encodeBlock(pcm + b * block_frames, block_frames, 1, &index,
+							  adpcm + b * block_align);
+		PBSAdpcm::decodeBlock(adpcm + b * block_align, block_align, 1,
+							  decoded + b * block_frames);
+	}
+
+	snprintf(dir, sizeof(dir), "/tmp/pbsbench.XXXXXX");
+	if (!mkdtemp(dir))
+	{
+		printf("  cannot create a temporary folder\n");
+		free(pcm);
+		free(decoded);
+		free(adpcm);
+		return;
+	}
+
+	static const char* files[] = { "whole.wav", "region.wav", "region_adpcm.wav" };
+
+	snprintf(path, sizeof(path), "%s/%s", dir, files[0]);
+	bool ret = writeWav(path, fs, false, 0, pcm, frames * sizeof(int16_t));
+	snprintf(path, sizeof(path), "%s/%s", dir, files[1]);
+	ret = ret && writeWav(path, fs, false, 0, pcm, frames * sizeof(int16_t), loop_start,
+						  loop_end);
+	snprintf(path, sizeof(path), "%s/%s", dir, files[2]);
+	ret = ret && writeWav(path, fs, true, block_align, adpcm, blocks * block_align,
+						  loop_start, loop_end);
+
+	if (ret)
+	{
+		printf("  %-24s %10s %10s %10s %10s %10s\n", "loop", "max step", "in sound", "reads",
+			   "seeks", "underruns");
+
+		simSetSdRoot(dir);
+		seamRun("whole file", files[0], loops, frames, maxStep(pcm, frames));
+		seamRun("smpl region", files[1], loops, loop_end - loop_start,
+				maxStep(pcm, frames));
+		seamRun("smpl region, IMA-ADPCM", files[2], loops, loop_end - loop_start,
+				maxStep(decoded, frames));
+		simSetSdRoot(opt.sd_root);
+	} else {
+		printf("  cannot write the test files\n");
+	}
+
+	for (uint32_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+		unlink(path);
+	}
+
+	rmdir(dir);
+	free(pcm);
+	free(decoded);
+	free(adpcm);
+}
+
+static void usage(const char* name)
+{
+	printf("Usage: %s [options] [config|strip|boot|loop|adpcm|resample|filter|seam|all]\n"
+		   "  -r DIR     SD root with fonts and sndutil folders (default ../sd)\n"
+		   "  -c FILE    configuration file inside the SD root (default: generated)\n"
+		   "  -p N       profiles in the generated configuration (default 64)\n"
+		   "  -f N       fonts in the generated configuration (default 4)\n"
+		   "  -l N       LEDs in the strip (default 144)\n"
+		   "  -n N       rounds for the config, strip, adpcm, resample and filter benchmarks (default 10)\n"
+		   "  -s US      virtual time per loop() iteration (default 100)\n"
+		   "  -t O,A,B   SD timing: open us, access us, ns per byte (default 1500,250,500)\n"
+		   "  -w N       smooth swing depth in the generated configuration (default 0)\n"
+		   "  -k CENTS   hum pitch at full swing in the generated configuration (default 0)\n"
+		   "  -u HZ      hum filter cutoff in the generated configuration (default 0)\n"
+		   "  -m HZ      music filter cutoff in the generated configuration (default 0)\n"
+		   "  -g DB      master volume in the generated configuration (default -5)\n"
+		   "  -a         master limiter on in the generated configuration\n"
+		   "  -v         echo PBSaber debug output\n", name);
+}
+
+int main(int argc, char** argv)
+{
+	int c;
+	uint32_t t_open = 1500, t_access = 250, t_byte = 500;
+
+	opt.sd_root = "../sd";
+	opt.config = NULL;
+	opt.profiles = 64;
+	opt.fonts = 4;
+	opt.leds = 144;
+	opt.rounds = 10;
+	opt.step_us = 100;
+	opt.swing_depth = 0;
+	opt.hum_pitch = 0;
+	opt.hum_filter = 0;
+	opt.music_filter = 0;
+	opt.master_volume = -5;
+	opt.limiter = false;
+	opt.verbose = false;
+
+	while ((c = getopt(argc, argv, "r:c:p:f:l:n:s:t:w:k:u:m:g:avh")) != -1)
+	{
+		switch (c)
+		{
+			case 'r': opt.sd_root = optarg; break;
+			case 'c': opt.config = optarg; break;
+			case 'p': opt.profiles = strtoul(optarg, NULL, 0); break;
+			case 'f': opt.fonts = strtoul(optarg, NULL, 0); break;
+			case 'l': opt.leds = strtoul(optarg, NULL, 0); break;
+			case 'n': opt.rounds = strtoul(optarg, NULL, 0); break;
+			case 's': opt.step_us = strtoul(optarg, NULL, 0); break;
+			case 'w': opt.swing_depth = strtoul(optarg, NULL, 0); break;
+			case 'k': opt.hum_pitch = strtoul(optarg, NULL, 0); break;
+			case 'u': opt.hum_filter = strtoul(optarg, NULL, 0); break;
+			case 'm': opt.music_filter = strtoul(optarg, NULL, 0); break;
+			case 'g': opt.master_volume = strtof(optarg, NULL); break;
+			case 'a': opt.limiter = true; break;
+			case 't':
+				if (sscanf(optarg, "%u,%u,%u", &t_open, &t_access, &t_byte) != 3)
+				{
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'v': opt.verbose = true; break;
+			default: usage(argv[0]); return c == 'h' ? 0 : 1;
+		}
+	}
+
+	const char* what = optind < argc ? argv[optind] : "all";
+	bool all = strcmp(what, "all") == 0;
+
+	if (!opt.profiles || !opt.fonts || !opt.rounds || !opt.step_us || opt.leds < 30)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!opt.config && !generateConfig())
+	{
+		fprintf(stderr, "Cannot generate configuration\n");
+		cleanup();
+		return 1;
+	}
+
+	simReset();
+	simSetSdRoot(opt.sd_root);
+	simSetSdTiming(t_open, t_access, t_byte);
+	simSetSerialEcho(opt.verbose);
+
+	if (all || strcmp(what, "config") == 0)
+		benchConfig();
+
+	if (all || strcmp(what, "strip") == 0)
+		benchStrip();
+
+	if (all || strcmp(what, "boot") == 0 || strcmp(what, "loop") == 0)
+	{
+		benchBoot();
+
+		if (all || strcmp(what, "loop") == 0)
+			benchLoop();
+	}
+
+	if (all || strcmp(what, "adpcm") == 0)
+		benchAdpcm();
+
+	if (all || strcmp(what, "resample") == 0)
+		benchResample();
+
+	if (all || strcmp(what, "filter") == 0)
+		benchFilter();
+
+	if (all || strcmp(what, "seam") == 0)
+		benchSeam();
+
+	cleanup();
+	return 0;
+}
@@ -0,0 +1,409 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### pbspack.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * pbspack: builds a font pack from a font folder.
+ *
+ *	pbspack <font folder> [pack file]
+ *
+ * Every .wav file of the folder and its subfolders goes into the pack, named after its
+ * path inside the folder without the extension. The pack is written into the folder as
+ * font.pbf unless another file is given; set 'pack = font.pbf' in the [font] section of
+ * the configuration to play the font from it. 16-bit PCM and IMA-ADPCM files are packed,
+ * with the loop region of their smpl chunk if they have one.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// The pack layout is shared with the firmware
+#define PBS_PACK_MAGIC			0x46534250		// "PBSF"
+#define PBS_PACK_VERSION		3
+#define PBS_PACK_EXT			".pbf"
+#define PBS_PACK_ALIGN			512
+#define PBS_PACK_NAME_LEN		44
+#define PBS_PACK_PCM16			1
+#define PBS_PACK_IMA_ADPCM		2
+
+#define ADPCM_FORMAT			0x11
+#define ADPCM_MAX_BLOCK			1024
+
+#define PACK_MAX_FILES			256
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t index_crc;
+} fontPackHeader;
+
+typedef struct
+{
+	char name[PBS_PACK_NAME_LEN];
+	uint32_t data_offset;
+	uint32_t data_size;
+	uint32_t sample_rate;
+	uint16_t channels;
+	uint16_t format;
+	uint16_t block_align;
+	uint16_t reserved;
+	uint32_t loop_start;
+	uint32_t loop_end;
+} fontPackEntry;
+
+typedef struct
+{
+	char path[512];
+	uint32_t file_offset;		// Of the audio data in the WAV file
+} packSource;
+
+static fontPackEntry entries[PACK_MAX_FILES];
+static packSource sources[PACK_MAX_FILES];
+static uint32_t entry_count = 0;
+
+static uint32_t crc32(uint32_t crc, const void* data, uint32_t len)
+{
+	const uint8_t* ptr = (const uint8_t*) data;
+
+	crc = ~crc;
+
+	while (len--)
+	{
+		crc ^= *ptr++;
+		for (uint32_t i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+
+	return ~crc;
+}
+
+static uint32_t readLE32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t readLE16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static bool readWav(const char* path, fontPackEntry* entry, packSource* src)
+{
+	// Same checks the firmware does on loose files: a 16-bit PCM or IMA-ADPCM fmt chunk
+	// followed somewhere by the data chunk. The first loop of the smpl chunk, if it's a
+	// forward one, is kept as the loop region.
+	FILE* f = fopen(path, "rb");
+	uint8_t buffer[36];
+	bool fmt_found = false;
+	bool ret = false;
+
+	if (!f)
+		return false;
+
+	if (fread(buffer, 1, 12, f) != 12 || memcmp(buffer, "RIFF", 4) != 0 ||
+		memcmp(buffer + 8, "WAVE", 4) != 0)
+	{
+		fclose(f);
+		return false;
+	}
+
+	while (fread(buffer, 1, 8, f) == 8)
+	{
+		uint32_t size = readLE32(buffer + 4);
+
+		if (memcmp(buffer, "fmt ", 4) == 0)
+		{
+			if (size < 16 || fread(buffer, 1, 16, f) != 16)
+				break;
+
+			entry->channels = readLE16(buffer + 2);
+			entry->sample_rate = readLE32(buffer + 4);
+			entry->block_align = readLE16(buffer + 12);
+
+			if (readLE16(buffer) == 1 && readLE16(buffer + 14) == 16)
+				entry->format = PBS_PACK_PCM16;
+			else if (readLE16(buffer) == ADPCM_FORMAT && readLE16(buffer + 14) == 4 &&
+					 entry->block_align <= ADPCM_MAX_BLOCK)
+				entry->format = PBS_PACK_IMA_ADPCM;
+			else
+				break;
+
+			if (entry->format == PBS_PACK_PCM16)
+				entry->block_align = 0;
+
+			fmt_found = entry->channels == 1 || entry->channels == 2;
+			size -= 16;
+		} else if (memcmp(buffer, "data", 4) == 0)
+		{
+			if (!fmt_found)
+				break;
+
+			src->file_offset = (uint32_t) ftell(f);
+			entry->data_size = size;
+			ret = true;
+		} else if (memcmp(buffer, "smpl", 4) == 0 && size >= 36 + 24)
+		{
+			if (fread(buffer, 1, 36, f) != 36)
+				break;
+
+			size -= 36;
+
+			if (readLE32(buffer + 28))
+			{
+				if (fread(buffer + 8, 1, 24, f) != 24)
+					break;
+
+				if (readLE32(buffer + 12) == 0)
+				{
+					entry->loop_start = readLE32(buffer + 16);
+					entry->loop_end = readLE32(buffer + 20) + 1;
+				}
+
+				size -= 24;
+			}
+		}
+
+		if (fseek(f, size + (size & 1), SEEK_CUR) != 0)
+			break;
+	}
+
+	fclose(f);
+	return ret;
+}
+
+static bool isWav(const char* name)
+{
+	size_t len = strlen(name);
+	return len > 4 && strcasecmp(name + len - 4, ".wav") == 0;
+}
+
+static int compareEntries(const void* a, const void* b)
+{
+	return strcasecmp(((const fontPackEntry*) a)->name, ((const fontPackEntry*) b)->name);
+}
+
+static bool scanFolder(const char* folder, const char* prefix)
+{
+	// Names use '\' as separator, like the paths of the firmware
+	DIR* dir = opendir(folder);
+	struct dirent* ent;
+	bool ret = true;
+
+	if (!dir)
+	{
+		fprintf(stderr, "Cannot open %s\n", folder);
+		return false;
+	}
+
+	while (ret && (ent = readdir(dir)) != NULL)
+	{
+		char path[512];
+		char name[PBS_PACK_NAME_LEN * 2];
+		struct stat st;
+
+		if (ent->d_name[0] == '.')
+			continue;
+
+		if (snprintf(path, sizeof(path), "%s/%s", folder, ent->d_name) >= (int) sizeof(path) ||
+			snprintf(name, sizeof(name), "%s%s", prefix, ent->d_name) >= (int) sizeof(name))
+		{
+			fprintf(stderr, "Skipping %s/%s: name too long\n", folder, ent->d_name);
+			continue;
+		}
+
+		if (stat(path, &st) != 0)
+			continue;
+
+		if (S_ISDIR(st.st_mode))
+		{
+			strncat(name, "\\", sizeof(name) - strlen(name) - 1);
+			ret = scanFolder(path, name);
+			continue;
+		}
+
+		if (!isWav(ent->d_name))
+			continue;
+
+		name[strlen(name) - 4] = 0;
+		if (strlen(name) >= PBS_PACK_NAME_LEN)
+		{
+			fprintf(stderr, "Skipping %s: name too long\n", path);
+			continue;
+		}
+
+		if (entry_count == PACK_MAX_FILES)
+		{
+			fprintf(stderr, "Too many files in %s\n", folder);
+			ret = false;
+			break;
+		}
+
+		fontPackEntry* entry = &entries[entry_count];
+		packSource* src = &sources[entry_count];
+
+		memset(entry, 0, sizeof(fontPackEntry));
+		if (!readWav(path, entry, src))
+		{
+			fprintf(stderr, "Skipping %s: not a 16-bit PCM or IMA-ADPCM WAV file\n", path);
+			continue;
+		}
+
+		snprintf(entry->name, PBS_PACK_NAME_LEN, "%s", name);
+		snprintf(src->path, sizeof(src->path), "%s", path);
+		entry_count++;
+	}
+
+	closedir(dir);
+	return ret;
+}
+
+static bool writePadding(FILE* f, uint32_t* offset)
+{
+	static const uint8_t zeros[PBS_PACK_ALIGN] = { 0 };
+	uint32_t pad = (PBS_PACK_ALIGN - (*offset % PBS_PACK_ALIGN)) % PBS_PACK_ALIGN;
+
+	*offset += pad;
+	return fwrite(zeros, 1, pad, f) == pad;
+}
+
+static bool copyData(FILE* out, fontPackEntry* entry, packSource* src)
+{
+	uint8_t buffer[8192];
+	uint32_t left = entry->data_size;
+	FILE* in = fopen(src->path, "rb");
+	bool ret;
+
+	if (!in)
+		return false;
+
+	ret = fseek(in, src->file_offset, SEEK_SET) == 0;
+
+	while (ret && left)
+	{
+		size_t size = left > sizeof(buffer) ? sizeof(buffer) : left;
+
+		ret = fread(buffer, 1, size, in) == size && fwrite(buffer, 1, size, out) == size;
+		left -= size;
+	}
+
+	fclose(in);
+	return ret;
+}
+
+static bool writePack(const char* path)
+{
+	// Sorted by name, so sounds of the same type sit next to each other on the card
+	fontPackHeader header;
+	uint32_t offset;
+	FILE* f;
+	bool ret;
+
+	// The sources go along with the entries
+	packSource sorted[PACK_MAX_FILES];
+	for (uint32_t i = 0; i < entry_count; i++)
+		entries[i].data_offset = i;
+
+	qsort(entries, entry_count, sizeof(fontPackEntry), compareEntries);
+
+	for (uint32_t i = 0; i < entry_count; i++)
+		sorted[i] = sources[entries[i].data_offset];
+
+	offset = sizeof(fontPackHeader) + entry_count * sizeof(fontPackEntry);
+	for (uint32_t i = 0; i < entry_count; i++)
+	{
+		offset = (offset + PBS_PACK_ALIGN - 1) & ~(PBS_PACK_ALIGN - 1);
+		entries[i].data_offset = offset;
+		offset += entries[i].data_size;
+	}
+
+	header.magic = PBS_PACK_MAGIC;
+	header.version = PBS_PACK_VERSION;
+	header.entry_count = entry_count;
+	header.index_crc = crc32(0, entries, entry_count * sizeof(fontPackEntry));
+
+	f = fopen(path, "wb");
+	if (!f)
+	{
+		fprintf(stderr, "Cannot create %s\n", path);
+		return false;
+	}
+
+	offset = sizeof(fontPackHeader) + entry_count * sizeof(fontPackEntry);
+	ret = fwrite(&header, sizeof(fontPackHeader), 1, f) == 1 &&
+		  fwrite(entries, sizeof(fontPackEntry), entry_count, f) == entry_count;
+
+	for (uint32_t i = 0; ret && i < entry_count; i++)
+	{
+		ret = writePadding(f, &offset) && copyData(f, &entries[i], &sorted[i]);
+		offset += entries[i].data_size;
+	}
+
+	ret = fclose(f) == 0 && ret;
+
+	if (!ret)
+	{
+		fprintf(stderr, "Error writing %s\n", path);
+		remove(path);
+	}
+
+	return ret;
+}
+
+int main(int argc, char** argv)
+{
+	char pack_path[512];
+
+	if (argc < 2 || argc > 3)
+	{
+		fprintf(stderr, "usage: %s <font folder> [pack file]\n", argv[0]);
+		return 1;
+	}
+
+	if (argc == 3)
+		snprintf(pack_path, sizeof(pack_path), "%s", argv[2]);
+	else
+		snprintf(pack_path, sizeof(pack_path), "%s/font%s", argv[1], PBS_PACK_EXT);
+
+	if (!scanFolder(argv[1], ""))
+		return 1;
+
+	if (!entry_count)
+	{
+		fprintf(stderr, "No sound files in %s\n", argv[1]);
+		return 1;
+	}
+
+	if (!writePack(pack_path))
+		return 1;
+
+	printf("%s: %u sound files\n", pack_path, entry_count);
+	return 0;
+}
@@ -0,0 +1,282 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### Sim.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Virtual clock, service timer, audio interrupt scheduling and miscellaneous core
+ * functions for the host build.
+ */
+
+#include <Arduino.h>
+#include <ServiceTimer.h>
+#include "Sim.h"
+
+HardwareSerial Serial;
+
+static uint64_t now_us = 0;
+static uint64_t next_ms_us = 1000;
+static uint32_t audio_fs = 0;
+static uint64_t audio_epoch = 0;
+static uint64_t audio_blocks = 0;
+static int irq_depth = 0;
+static uint32_t rnd_state = 0x2545F491;
+static bool serial_echo = false;
+
+static STObject* st_list = NULL;
+
+static uint64_t nextAudioTick()
+{
+	return audio_epoch + ((audio_blocks + 1) * AUDIO_BLOCK_SAMPLES * 1000000ULL) / audio_fs;
+}
+
+void simAudioStarted(uint32_t fs)
+{
+	audio_fs = fs;
+	audio_epoch = now_us;
+	audio_blocks = 0;
+}
+
+void simReset()
+{
+	now_us = 0;
+	next_ms_us = 1000;
+	audio_fs = 0;
+	audio_blocks = 0;
+	rnd_state = 0x2545F491;
+}
+
+void simAdvance(uint32_t us)
+{
+	// Time does not move from inside an interrupt
+	if (irq_depth)
+		return;
+
+	uint64_t end = now_us + us;
+
+	for (;;)
+	{
+		uint64_t next = next_ms_us;
+		uint64_t audio_next = audio_fs ? nextAudioTick() : UINT64_MAX;
+
+		if (audio_next < next)
+			next = audio_next;
+
+		if (next > end)
+			break;
+
+		now_us = next;
+		irq_depth++;
+
+		if (now_us >= next_ms_us)
+		{
+			next_ms_us += 1000;
+			serviceTimerTick();
+		}
+
+		if (audio_fs && now_us >= audio_next)
+		{
+			audio_blocks++;
+			Audio.tick();
+		}
+
+		irq_depth--;
+	}
+
+	now_us = end;
+}
+
+uint64_t simMicros()
+{
+	return now_us;
+}
+
+bool simInInterrupt()
+{
+	return irq_depth != 0;
+}
+
+uint32_t GetTickCount()
+{
+	return (uint32_t) (now_us / 1000);
+}
+
+uint32_t millis()
+{
+	return GetTickCount();
+}
+
+uint32_t micros()
+{
+	return (uint32_t) now_us;
+}
+
+void delay(uint32_t ms)
+{
+	simAdvance(ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+	simAdvance(us);
+}
+
+void __disable_irq()
+{
+}
+
+void __enable_irq()
+{
+}
+
+uint32_t getRandom(uint32_t min, uint32_t max)
+{
+	// xorshift32, deterministic so that runs are reproducible
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+
+	if (max <= min)
+		return min;
+
+	return min + rnd_state % (max - min + 1);
+}
+
+void enterLowPowerMode(uint32_t pin, uint32_t mode, bool standby)
+{
+	UNUSED(pin);
+	UNUSED(mode);
+	UNUSED(standby);
+
+	if (serial_echo)
+		printf("[sim] low power mode requested\n");
+}
+
+void HardwareSerial::print(const char* str)
+{
+	if (echo)
+		fputs(str, stdout);
+}
+
+void HardwareSerial::println(const char* str)
+{
+	if (echo)
+	{
+		fputs(str, stdout);
+		fputc('\n', stdout);
+	}
+}
+
+int HardwareSerial::available()
+{
+	return (int) (rx_head - rx_tail);
+}
+
+int HardwareSerial::read()
+{
+	if (rx_head == rx_tail)
+		return -1;
+
+	return (uint8_t) rx[rx_tail++ % sizeof(rx)];
+}
+
+void HardwareSerial::receive(const char* str)
+{
+	// Drop what doesn't fit, like a full UART buffer
+	while (*str && rx_head - rx_tail < sizeof(rx))
+		rx[rx_head++ % sizeof(rx)] = *str++;
+}
+
+void simSerialInput(const char* str)
+{
+	Serial.receive(str);
+}
+
+void simSetSerialEcho(bool echo)
+{
+	serial_echo = echo;
+	Serial.setEcho(echo);
+}
+
+void enableSdDebug(HardwareSerial* serial)
+{
+	UNUSED(serial);
+}
+
+void STObject::add()
+{
+	if (added)
+		return;
+
+	next = st_list;
+	st_list = this;
+	added = true;
+}
+
+void STObject::remove()
+{
+	if (!added)
+		return;
+
+	STObject** ptr = &st_list;
+	while (*ptr)
+	{
+		if (*ptr == this)
+		{
+			*ptr = next;
+			break;
+		}
+
+		ptr = &(*ptr)->next;
+	}
+
+	next = NULL;
+	added = false;
+}
+
+void serviceTimerTick()
+{
+	STObject* obj = st_list;
+	while (obj)
+	{
+		// Objects may remove themselves while being polled
+		STObject* next = obj->next;
+		obj->poll();
+		obj = next;
+	}
+}
+
+void simMotionPulse(uint8_t src)
+{
+	Motion.simPulse(src);
+}
+
+void simMotionTransient(uint8_t src)
+{
+	Motion.simTransient(src);
+}
+
+void simSetAcceleration(float x, float y, float z)
+{
+	Motion.simSetAcceleration(x, y, z);
+}
@@ -0,0 +1,475 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### SimAudio.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Audio engine and players for the host build. Sources are mixed one block at a time
+ * from the simulated audio interrupt; WAV data is streamed through the FatFs stand-in.
+ */
+
+#include <Arduino.h>
+#include <time.h>
+#include "Sim.h"
+
+extern void simAudioStarted(uint32_t fs);
+
+AudioClass Audio;
+
+static simAudioStats audio_stats;
+
+void simGetAudioStats(simAudioStats* stats)
+{
+	*stats = audio_stats;
+}
+
+void simResetAudioStats()
+{
+	memset(&audio_stats, 0, sizeof(audio_stats));
+}
+
+AudioSource::AudioSource() : active(false), volume(1.0f), next(NULL), attached(false)
+{
+}
+
+AudioSource::~AudioSource()
+{
+	Audio.detach(this);
+}
+
+void AudioSource::start()
+{
+	active = true;
+	Audio.attach(this);
+}
+
+void AudioSource::stop()
+{
+	active = false;
+	Audio.detach(this);
+}
+
+AudioClass::AudioClass() :
+	sample_rate(0), master_db(0), master_gain(1.0f), muted(true), sources(NULL)
+{
+}
+
+bool AudioClass::begin(uint32_t fs, uint8_t bps, bool stereo)
+{
+	UNUSED(stereo);
+
+	if (bps != 16 || !fs)
+		return false;
+
+	sample_rate = fs;
+	simAudioStarted(fs);
+	return true;
+}
+
+void AudioClass::setVolume(float db)
+{
+	master_db = db;
+	master_gain = powf(10.0f, db / 20.0f);
+}
+
+uint32_t AudioClass::blockPeriodUs()
+{
+	return sample_rate ? (AUDIO_BLOCK_SAMPLES * 1000000UL) / sample_rate : 0;
+}
+
+void AudioClass::attach(AudioSource* src)
+{
+	if (src->attached)
+		return;
+
+	src->next = sources;
+	sources = src;
+	src->attached = true;
+}
+
+void AudioClass::detach(AudioSource* src)
+{
+	if (!src->attached)
+		return;
+
+	AudioSource** ptr = &sources;
+	while (*ptr)
+	{
+		if (*ptr == src)
+		{
+			*ptr = src->next;
+			break;
+		}
+
+		ptr = &(*ptr)->next;
+	}
+
+	src->next = NULL;
+	src->attached = false;
+}
+
+static uint64_t hostNanos()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void AudioClass::tick()
+{
+	int32_t mix[AUDIO_BLOCK_SAMPLES];
+	int16_t block[AUDIO_BLOCK_SAMPLES];
+	uint64_t start = hostNanos();
+	uint32_t rendered = 0;
+
+	memset(mix, 0, sizeof(mix));
+
+	AudioSource* src = sources;
+	while (src)
+	{
+		AudioSource* next = src->next;
+
+		if (src->active)
+		{
+			uint32_t count = src->render(block, AUDIO_BLOCK_SAMPLES);
+			float gain = src->volume;
+
+			rendered++;
+
+			for (uint32_t i = 0; i < count; i++)
+				mix[i] += (int32_t) (block[i] * gain);
+
+			if (count < AUDIO_BLOCK_SAMPLES)
+			{
+				src->active = false;
+				detach(src);
+			}
+		} else {
+			detach(src);
+		}
+
+		src = next;
+	}
+
+	for (uint32_t i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+	{
+		int32_t sample = muted ? 0 : (int32_t) (mix[i] * master_gain);
+
+		if (sample > 32767 || sample < -32768)
+		{
+			audio_stats.clipped++;
+			sample = sample > 0 ? 32767 : -32768;
+		}
+
+		int16_t peak = (int16_t) (sample < 0 ? (sample == -32768 ? 32767 : -sample) : sample);
+		if (peak > audio_stats.peak)
+			audio_stats.peak = peak;
+	}
+
+	audio_stats.blocks++;
+	audio_stats.samples += AUDIO_BLOCK_SAMPLES;
+	audio_stats.source_blocks += rendered;
+	audio_stats.mix_ns += hostNanos() - start;
+
+	if (rendered > audio_stats.peak_sources)
+		audio_stats.peak_sources = rendered;
+}
+
+RawPlayer::RawPlayer()
+{
+	memset(&track, 0, sizeof(track));
+}
+
+RawPlayer::~RawPlayer()
+{
+	closeTrack(&track);
+}
+
+static uint32_t readLE32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t readLE16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+bool RawPlayer::openTrack(simTrack* trk, const char* filename, bool loop)
+{
+	uint8_t hdr[24];
+	UINT br;
+	bool fmt_found = false;
+
+	closeTrack(trk);
+	snprintf(trk->filename, sizeof(trk->filename), "%s", filename);
+
+	if (f_open(&trk->file, filename, FA_READ) != FR_OK)
+		return false;
+
+	trk->open = true;
+
+	if (f_read(&trk->file, hdr, 12, &br) != FR_OK || br != 12 ||
+		memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0)
+	{
+		closeTrack(trk);
+		return false;
+	}
+
+	uint32_t offset = 12;
+	for (;;)
+	{
+		if (f_read(&trk->file, hdr, 8, &br) != FR_OK || br != 8)
+		{
+			closeTrack(trk);
+			return false;
+		}
+
+		uint32_t chunk_size = readLE32(hdr + 4);
+		offset += 8;
+
+		if (memcmp(hdr, "fmt ", 4) == 0)
+		{
+			if (f_read(&trk->file, hdr, 16, &br) != FR_OK || br != 16 ||
+				readLE16(hdr) != 1 || readLE16(hdr + 14) != 16)
+			{
+				closeTrack(trk);
+				return false;
+			}
+
+			trk->channels = (uint8_t) readLE16(hdr + 2);
+			trk->fs = readLE32(hdr + 4);
+			fmt_found = true;
+		} else if (memcmp(hdr, "data", 4) == 0)
+		{
+			if (!fmt_found)
+			{
+				closeTrack(trk);
+				return false;
+			}
+
+			trk->data_offset = offset;
+			trk->data_size = chunk_size;
+			break;
+		}
+
+		offset += chunk_size + (chunk_size & 1);
+		f_lseek(&trk->file, offset);
+	}
+
+	trk->position = 0;
+	trk->loop = loop;
+	return true;
+}
+
+void RawPlayer::closeTrack(simTrack* trk)
+{
+	if (trk->open)
+		f_close(&trk->file);
+
+	trk->open = false;
+}
+
+uint32_t RawPlayer::renderTrack(simTrack* trk, int16_t* buffer, uint32_t samples)
+{
+	uint32_t produced = 0;
+	int16_t frames[AUDIO_BLOCK_SAMPLES * 2];
+
+	if (!trk->open || !trk->channels)
+		return 0;
+
+	while (produced < samples)
+	{
+		uint32_t frame_size = trk->channels * 2;
+		uint32_t left = (trk->data_size - trk->position) / frame_size;
+
+		if (!left)
+		{
+			if (!trk->loop)
+				break;
+
+			trk->position = 0;
+			continue;
+		}
+
+		uint32_t count = samples - produced;
+		if (count > left)
+			count = left;
+
+		UINT br;
+		f_lseek(&trk->file, trk->data_offset + trk->position);
+		f_read(&trk->file, frames, count * frame_size, &br);
+		count = br / frame_size;
+		if (!count)
+			break;
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (trk->channels == 2)
+				buffer[produced + i] = (int16_t) ((frames[i*2] + frames[i*2+1]) / 2);
+			else
+				buffer[produced + i] = frames[i];
+		}
+
+		trk->position += count * frame_size;
+		produced += count;
+	}
+
+	return produced;
+}
+
+uint32_t RawPlayer::trackDuration(simTrack* trk)
+{
+	if (!trk->open || !trk->fs || !trk->channels)
+		return 0;
+
+	return (uint32_t) (((uint64_t) trk->data_size / (trk->channels * 2)) * 1000 / trk->fs);
+}
+
+uint32_t RawPlayer::duration()
+{
+	return trackDuration(&track);
+}
+
+uint32_t RawPlayer::render(int16_t* buffer, uint32_t samples)
+{
+	return renderTrack(&track, buffer, samples);
+}
+
+void RawPlayer::stop()
+{
+	AudioSource::stop();
+	closeTrack(&track);
+}
+
+void RawPlayer::waitBlocking()
+{
+	while (active)
+		simAdvance(1000);
+}
+
+bool WavPlayer::play(const char* filename, PlayMode mode)
+{
+	AudioSource::stop();
+
+	if (!openTrack(&track, filename, mode == PlayModeLoop))
+		return false;
+
+	start();
+
+	if (mode == PlayModeBlocking)
+		waitBlocking();
+
+	return true;
+}
+
+bool WavPlayer::playRandom(const char* prefix, uint32_t min, uint32_t max, PlayMode mode)
+{
+	char filename[256];
+	snprintf(filename, sizeof(filename), "%s%u.wav", prefix, getRandom(min, max));
+	return play(filename, mode);
+}
+
+WavChainPlayer::WavChainPlayer() : chained_active(false)
+{
+	memset(&chained, 0, sizeof(chained));
+}
+
+bool WavChainPlayer::begin(const char* filename)
+{
+	stop();
+	return openTrack(&track, filename, true);
+}
+
+bool WavChainPlayer::chain(const char* filename, PlayMode mode)
+{
+	chained_active = false;
+
+	if (!openTrack(&chained, filename, mode == PlayModeLoop))
+		return false;
+
+	chained_active = true;
+
+	if (mode == PlayModeBlocking && active)
+	{
+		while (chained_active)
+			simAdvance(1000);
+	}
+
+	return true;
+}
+
+bool WavChainPlayer::chainRandom(const char* prefix, uint32_t min, uint32_t max, PlayMode mode)
+{
+	char filename[256];
+	snprintf(filename, sizeof(filename), "%s%u.wav", prefix, getRandom(min, max));
+	return chain(filename, mode);
+}
+
+bool WavChainPlayer::play()
+{
+	if (!track.open)
+		return false;
+
+	start();
+	return true;
+}
+
+bool WavChainPlayer::restart()
+{
+	chained_active = false;
+	closeTrack(&chained);
+	return true;
+}
+
+void WavChainPlayer::stop()
+{
+	chained_active = false;
+	closeTrack(&chained);
+	RawPlayer::stop();
+}
+
+uint32_t WavChainPlayer::getChainedDuration()
+{
+	return trackDuration(&chained);
+}
+
+uint32_t WavChainPlayer::render(int16_t* buffer, uint32_t samples)
+{
+	uint32_t produced = 0;
+
+	if (chained_active)
+	{
+		produced = renderTrack(&chained, buffer, samples);
+		if (produced < samples)
+		{
+			chained_active = false;
+			closeTrack(&chained);
+		}
+	}
+
+	if (produced < samples)
+		produced += renderTrack(&track, buffer + produced, samples - produced);
+
+	return produced;
+}
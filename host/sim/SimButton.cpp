@@ -0,0 +1,107 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### SimButton.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Button driver for the host build. Buttons are debounced and decoded every
+ * millisecond from the service timer.
+ */
+
+#include <Arduino.h>
+#include <PropButton.h>
+#include "Sim.h"
+
+#define SIM_MAX_PINS	32
+
+static bool pin_pressed[SIM_MAX_PINS];
+
+void simSetButton(uint32_t pin, bool pressed)
+{
+	if (pin < SIM_MAX_PINS)
+		pin_pressed[pin] = pressed;
+}
+
+bool simGetButton(uint32_t pin)
+{
+	return pin < SIM_MAX_PINS && pin_pressed[pin];
+}
+
+PropButton::PropButton() :
+	pin(0), debounce(25), long_press_time(1000), counter(0), press_time(0), state(false),
+	long_fired(false), event(ButtonNoEvent)
+{
+}
+
+bool PropButton::begin(uint32_t pin, ButtonType type, uint32_t debounce)
+{
+	UNUSED(type);
+
+	this->pin = pin;
+	this->debounce = debounce;
+	counter = 0;
+	state = false;
+	event = ButtonNoEvent;
+	add();
+	return pin < SIM_MAX_PINS;
+}
+
+ButtonEvent PropButton::getEvent()
+{
+	ButtonEvent ret = event;
+	event = ButtonNoEvent;
+	return ret;
+}
+
+void PropButton::poll()
+{
+	bool level = simGetButton(pin);
+
+	if (level != state)
+	{
+		if (++counter < debounce)
+			return;
+
+		counter = 0;
+		state = level;
+
+		if (state)
+		{
+			press_time = GetTickCount();
+			long_fired = false;
+			event = ButtonPressed;
+		} else {
+			event = long_fired ? ButtonReleased : ButtonShortPressAndRelease;
+		}
+
+		return;
+	}
+
+	counter = 0;
+
+	if (state && !long_fired && GetTickCount() - press_time >= long_press_time)
+	{
+		long_fired = true;
+		event = ButtonLongPressed;
+	}
+}
@@ -0,0 +1,470 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### SimConfig.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * INI reader with the PropConfig interface. The file is read through the FatFs stand-in
+ * in 512-byte sectors, the same way the board reads it from the SD card.
+ */
+
+#include <Arduino.h>
+#include <ctype.h>
+#include <PropConfig.h>
+
+PropConfig::PropConfig() : opened(false), pos(0), sector_offset(0), sector_len(0),
+	value_token(UINT32_MAX), in_section(false)
+{
+	filename[0] = 0;
+}
+
+PropConfig::~PropConfig()
+{
+	end();
+}
+
+bool PropConfig::begin(const char* file)
+{
+	end();
+
+	if (f_open(&this->file, file, FA_READ | FA_WRITE) != FR_OK)
+		return false;
+
+	snprintf(filename, sizeof(filename), "%s", file);
+	opened = true;
+	pos = 0;
+	sector_len = 0;
+	value_token = UINT32_MAX;
+	return true;
+}
+
+void PropConfig::end()
+{
+	if (opened)
+		f_close(&file);
+
+	opened = false;
+}
+
+bool PropConfig::setFileRWPointer(uint32_t offset)
+{
+	if (!opened || offset > f_size(&file))
+		return false;
+
+	pos = offset;
+	return true;
+}
+
+bool PropConfig::readLine(char* dst, uint32_t size, uint32_t* line_offset)
+{
+	uint32_t len = 0;
+	bool got = false;
+
+	*line_offset = pos;
+
+	for (;;)
+	{
+		if (pos < sector_offset || pos >= sector_offset + sector_len)
+		{
+			// Load the sector containing 'pos'
+			UINT br;
+			sector_offset = pos & ~511UL;
+			f_lseek(&file, sector_offset);
+			if (f_read(&file, sector, sizeof(sector), &br) != FR_OK)
+				return false;
+
+			sector_len = br;
+			if (pos >= sector_offset + sector_len)
+				break;
+		}
+
+		char c = (char) sector[pos - sector_offset];
+		pos++;
+		got = true;
+
+		if (c == '\n')
+			break;
+
+		if (c != '\r' && len < size - 1)
+			dst[len++] = c;
+	}
+
+	dst[len] = 0;
+	return got;
+}
+
+static char* trim(char* str)
+{
+	while (*str && isspace((unsigned char) *str))
+		str++;
+
+	char* end = str + strlen(str);
+	while (end > str && isspace((unsigned char) end[-1]))
+		*--end = 0;
+
+	return str;
+}
+
+bool PropConfig::parseSection(char* str, char** name)
+{
+	str = trim(str);
+	if (*str != '[')
+		return false;
+
+	char* end = strchr(str, ']');
+	if (!end)
+		return false;
+
+	*end = 0;
+	*name = trim(str + 1);
+	return true;
+}
+
+bool PropConfig::parseKey(char* str, uint32_t line_offset, char** key, uint32_t* key_len,
+						  uint32_t* token)
+{
+	char* start = str;
+	while (*start && isspace((unsigned char) *start))
+		start++;
+
+	if (!*start || *start == '#' || *start == ';' || *start == '[')
+		return false;
+
+	char* eq = strchr(start, '=');
+	if (!eq)
+		return false;
+
+	char* key_end = eq;
+	while (key_end > start && isspace((unsigned char) key_end[-1]))
+		key_end--;
+
+	char* val = eq + 1;
+	while (*val && isspace((unsigned char) *val))
+		val++;
+
+	*token = line_offset + (uint32_t) (val - str);
+	snprintf(value, sizeof(value), "%s", val);
+	trim(value);
+	value_token = *token;
+
+	*key_end = 0;
+	*key = start;
+	*key_len = (uint32_t) (key_end - start);
+	return true;
+}
+
+bool PropConfig::mapSections(mapSectionsCallback* callback, void* param)
+{
+	uint32_t line_offset;
+	char* name;
+
+	if (!opened)
+		return false;
+
+	pos = 0;
+	while (readLine(line, sizeof(line), &line_offset))
+	{
+		if (parseSection(line, &name))
+		{
+			if (!callback(line_offset, pos, name, param))
+				break;
+		}
+	}
+
+	return true;
+}
+
+bool PropConfig::findSection(const char* section)
+{
+	uint32_t line_offset;
+	char* name;
+
+	while (readLine(line, sizeof(line), &line_offset))
+	{
+		if (parseSection(line, &name) && strcasecmp(name, section) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool PropConfig::startSectionScan(const char* section)
+{
+	in_section = opened && findSection(section);
+	return in_section;
+}
+
+bool PropConfig::getNextKey(uint32_t* token, char** key_name, uint32_t* key_len)
+{
+	uint32_t line_offset;
+
+	if (!in_section)
+		return false;
+
+	while (readLine(line, sizeof(line), &line_offset))
+	{
+		char* name;
+		char copy[sizeof(line)];
+
+		memcpy(copy, line, sizeof(copy));
+		if (parseSection(copy, &name))
+		{
+			// Leave the pointer at the start of the next section
+			pos = line_offset;
+			in_section = false;
+			return false;
+		}
+
+		if (parseKey(line, line_offset, key_name, key_len, token))
+			return true;
+	}
+
+	in_section = false;
+	return false;
+}
+
+void PropConfig::endSectionScan()
+{
+	in_section = false;
+}
+
+bool PropConfig::findKey(const char* section, const char* key, uint32_t* token)
+{
+	char* key_name;
+	uint32_t key_len;
+	uint32_t saved = pos;
+	bool found = false;
+
+	// Section/key lookups search from the current pointer and leave it untouched
+	if (startSectionScan(section))
+	{
+		while (getNextKey(token, &key_name, &key_len))
+		{
+			if (strlen(key) == key_len && strncasecmp(key, key_name, key_len) == 0)
+			{
+				found = true;
+				break;
+			}
+		}
+	}
+
+	endSectionScan();
+	pos = saved;
+	return found;
+}
+
+const char* PropConfig::valueAt(uint32_t token)
+{
+	if (token == value_token)
+		return value;
+
+	uint32_t line_offset;
+	uint32_t saved = pos;
+
+	pos = token;
+	readLine(value, sizeof(value), &line_offset);
+	trim(value);
+	pos = saved;
+
+	value_token = token;
+	return value;
+}
+
+bool PropConfig::readValue(uint32_t token, uint32_t* dst)
+{
+	const char* str = valueAt(token);
+	char* end;
+
+	if (!*str)
+		return false;
+
+	unsigned long val = strtoul(str, &end, 0);
+	if (end == str)
+		return false;
+
+	*dst = (uint32_t) val;
+	return true;
+}
+
+bool PropConfig::readValue(uint32_t token, uint8_t* dst)
+{
+	uint32_t val;
+	if (!readValue(token, &val))
+		return false;
+
+	*dst = (uint8_t) val;
+	return true;
+}
+
+bool PropConfig::readValue(uint32_t token, bool* dst)
+{
+	const char* str = valueAt(token);
+
+	if (strcasecmp(str, "yes") == 0 || strcasecmp(str, "true") == 0 ||
+		strcasecmp(str, "high") == 0 || strcasecmp(str, "on") == 0 || strcmp(str, "1") == 0)
+	{
+		*dst = true;
+		return true;
+	}
+
+	if (strcasecmp(str, "no") == 0 || strcasecmp(str, "false") == 0 ||
+		strcasecmp(str, "low") == 0 || strcasecmp(str, "off") == 0 || strcmp(str, "0") == 0)
+	{
+		*dst = false;
+		return true;
+	}
+
+	return false;
+}
+
+bool PropConfig::readValue(uint32_t token, float* dst)
+{
+	const char* str = valueAt(token);
+	char* end;
+
+	if (!*str)
+		return false;
+
+	float val = strtof(str, &end);
+	if (end == str)
+		return false;
+
+	*dst = val;
+	return true;
+}
+
+bool PropConfig::readValue(uint32_t token, char* dst, uint32_t* len)
+{
+	const char* str = valueAt(token);
+	uint32_t size = *len;
+
+	if (!size)
+		return false;
+
+	uint32_t count = (uint32_t) strlen(str);
+	if (count > size - 1)
+		count = size - 1;
+
+	memcpy(dst, str, count);
+	dst[count] = 0;
+	*len = count;
+	return true;
+}
+
+template <typename T>
+static bool parseArray(const char* str, T* values, uint8_t* count)
+{
+	uint8_t max = *count;
+	uint8_t n = 0;
+
+	while (*str && n < max)
+	{
+		char* end;
+		unsigned long val = strtoul(str, &end, 0);
+		if (end == str)
+			break;
+
+		values[n++] = (T) val;
+		str = end;
+
+		while (*str && (isspace((unsigned char) *str) || *str == ','))
+			str++;
+	}
+
+	*count = n;
+	return n != 0;
+}
+
+bool PropConfig::readArray(uint32_t token, uint8_t* values, uint8_t* count)
+{
+	return parseArray(valueAt(token), values, count);
+}
+
+bool PropConfig::readArray(uint32_t token, uint16_t* values, uint8_t* count)
+{
+	return parseArray(valueAt(token), values, count);
+}
+
+bool PropConfig::readValue(const char* section, const char* key, uint32_t* dst)
+{
+	uint32_t token;
+	if (!findKey(section, key, &token))
+		return false;
+
+	return readValue(token, dst);
+}
+
+bool PropConfig::readValue(const char* section, const char* key, bool* dst)
+{
+	uint32_t token;
+	if (!findKey(section, key, &token))
+		return false;
+
+	return readValue(token, dst);
+}
+
+bool PropConfig::writeValue(const char* section, const char* key, uint32_t val)
+{
+	uint32_t token;
+	uint32_t line_offset;
+
+	if (!findKey(section, key, &token))
+		return false;
+
+	// Find where the value ends
+	pos = token;
+	readLine(line, sizeof(line), &line_offset);
+	uint32_t value_end = pos;
+
+	// Rewrite the whole file with the new value, as the board has to do
+	uint32_t size = f_size(&file);
+	char* data = (char*) malloc(size + 32);
+	if (!data)
+		return false;
+
+	UINT br, bw;
+	f_lseek(&file, 0);
+	f_read(&file, data, size, &br);
+
+	char number[16];
+	int len = snprintf(number, sizeof(number), "%u\n", val);
+
+	f_close(&file);
+	opened = false;
+
+	if (f_open(&file, filename, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+	{
+		free(data);
+		return false;
+	}
+
+	f_write(&file, data, token, &bw);
+	f_write(&file, number, len, &bw);
+	f_write(&file, data + value_end, size - value_end, &bw);
+	f_close(&file);
+	free(data);
+
+	sector_len = 0;
+	value_token = UINT32_MAX;
+	return begin(filename);
+}
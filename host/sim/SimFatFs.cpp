@@ -0,0 +1,384 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### SimFatFs.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * FatFs API on top of the host file system, with a simple SD card timing model:
+ * opening a file costs 'open_us', every read or write costs 'access_us' plus
+ * 'ns_per_byte' for each transferred byte. The cost is charged to the virtual clock,
+ * unless the access is done from a simulated interrupt; then it's only counted.
+ */
+
+#include <Arduino.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "Sim.h"
+
+// Directory helpers live in SimHostDir.cpp, since the host DIR type clashes with FatFs'
+extern void* hostOpenDir(const char* path);
+extern bool hostReadDir(void* handle, char* name, size_t size, bool* is_dir);
+extern bool hostStatDir(void* handle, const char* name, long long* size, time_t* mtime);
+extern void hostCloseDir(void* handle);
+
+static char sd_root[256] = ".";
+static uint32_t sd_open_us = 1500;
+static uint32_t sd_access_us = 250;
+static uint32_t sd_ns_per_byte = 500;
+static simSdStats sd_stats;
+
+void simSetSdRoot(const char* path)
+{
+	snprintf(sd_root, sizeof(sd_root), "%s", path);
+}
+
+const char* simGetSdRoot()
+{
+	return sd_root;
+}
+
+void simSetSdTiming(uint32_t open_us, uint32_t access_us, uint32_t ns_per_byte)
+{
+	sd_open_us = open_us;
+	sd_access_us = access_us;
+	sd_ns_per_byte = ns_per_byte;
+}
+
+void simGetSdStats(simSdStats* stats)
+{
+	*stats = sd_stats;
+}
+
+void simResetSdStats()
+{
+	memset(&sd_stats, 0, sizeof(sd_stats));
+}
+
+static void charge(uint64_t us)
+{
+	if (simInInterrupt())
+	{
+		sd_stats.stream_us += us;
+		return;
+	}
+
+	sd_stats.busy_us += us;
+	simAdvance((uint32_t) us);
+}
+
+static void hostPath(const TCHAR* path, char* dst, size_t size)
+{
+	while (*path == '\\' || *path == '/')
+		path++;
+
+	snprintf(dst, size, "%s/%s", sd_root, path);
+
+	for (char* c = dst; *c; c++)
+	{
+		if (*c == '\\')
+			*c = '/';
+	}
+}
+
+static FRESULT errnoToResult()
+{
+	switch (errno)
+	{
+		case ENOENT:	return FR_NO_FILE;
+		case ENOTDIR:	return FR_NO_PATH;
+		case EEXIST:	return FR_EXIST;
+		case EACCES:	return FR_DENIED;
+		default:		return FR_DISK_ERR;
+	}
+}
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode)
+{
+	char host[512];
+	const char* fmode;
+	struct stat st;
+
+	hostPath(path, host, sizeof(host));
+	fp->handle = NULL;
+
+	sd_stats.opens++;
+	charge(sd_open_us);
+
+	bool exists = (stat(host, &st) == 0);
+	if (exists && S_ISDIR(st.st_mode))
+		return FR_DENIED;
+
+	if (mode & FA_CREATE_NEW)
+	{
+		if (exists)
+			return FR_EXIST;
+		fmode = "w+b";
+	} else if (mode & FA_CREATE_ALWAYS)
+	{
+		fmode = "w+b";
+	} else if (mode & FA_OPEN_ALWAYS)
+	{
+		fmode = exists ? "r+b" : "w+b";
+	} else {
+		if (!exists)
+			return FR_NO_FILE;
+		fmode = (mode & FA_WRITE) ? "r+b" : "rb";
+	}
+
+	FILE* f = fopen(host, fmode);
+	if (!f)
+		return errnoToResult();
+
+	fseek(f, 0, SEEK_END);
+	fp->fsize = (FSIZE_t) ftell(f);
+	fp->fptr = 0;
+	fp->flag = mode;
+	fp->handle = f;
+
+	if ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND)
+		fp->fptr = fp->fsize;
+
+	fseek(f, fp->fptr, SEEK_SET);
+	return FR_OK;
+}
+
+FRESULT f_close(FIL* fp)
+{
+	if (!fp->handle)
+		return FR_INVALID_OBJECT;
+
+	fclose((FILE*) fp->handle);
+	fp->handle = NULL;
+	return FR_OK;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br)
+{
+	*br = 0;
+	if (!fp->handle)
+		return FR_INVALID_OBJECT;
+
+	FILE* f = (FILE*) fp->handle;
+	fseek(f, fp->fptr, SEEK_SET);
+	size_t n = fread(buff, 1, btr, f);
+	fp->fptr += n;
+	*br = (UINT) n;
+
+	sd_stats.reads++;
+	sd_stats.bytes_read += n;
+	charge(sd_access_us + ((uint64_t) n * sd_ns_per_byte) / 1000);
+	return FR_OK;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw)
+{
+	*bw = 0;
+	if (!fp->handle)
+		return FR_INVALID_OBJECT;
+
+	if (!(fp->flag & (FA_WRITE | FA_CREATE_ALWAYS | FA_CREATE_NEW | FA_OPEN_ALWAYS)))
+		return FR_DENIED;
+
+	FILE* f = (FILE*) fp->handle;
+	fseek(f, fp->fptr, SEEK_SET);
+	size_t n = fwrite(buff, 1, btw, f);
+	fp->fptr += n;
+	if (fp->fptr > fp->fsize)
+		fp->fsize = fp->fptr;
+	*bw = (UINT) n;
+
+	sd_stats.writes++;
+	sd_stats.bytes_written += n;
+	charge(sd_access_us + ((uint64_t) n * sd_ns_per_byte) / 1000);
+	return FR_OK;
+}
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs)
+{
+	if (!fp->handle)
+		return FR_INVALID_OBJECT;
+
+	if (ofs > fp->fsize && !(fp->flag & FA_WRITE))
+		ofs = fp->fsize;
+
+	fp->fptr = ofs;
+	sd_stats.seeks++;
+	return FR_OK;
+}
+
+FRESULT f_truncate(FIL* fp)
+{
+	if (!fp->handle)
+		return FR_INVALID_OBJECT;
+
+	FILE* f = (FILE*) fp->handle;
+	fflush(f);
+	if (ftruncate(fileno(f), fp->fptr) != 0)
+		return FR_DISK_ERR;
+
+	fp->fsize = fp->fptr;
+	return FR_OK;
+}
+
+FRESULT f_sync(FIL* fp)
+{
+	if (!fp->handle)
+		return FR_INVALID_OBJECT;
+
+	fflush((FILE*) fp->handle);
+	charge(sd_access_us);
+	return FR_OK;
+}
+
+// FAT date and time of a host timestamp
+static void fatTime(time_t t, WORD* fdate, WORD* ftime)
+{
+	struct tm tm;
+	localtime_r(&t, &tm);
+
+	*fdate = (WORD) (((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+	*ftime = (WORD) ((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+}
+
+FRESULT f_opendir(DIR* dp, const TCHAR* path)
+{
+	char host[512];
+	hostPath(path, host, sizeof(host));
+
+	sd_stats.opens++;
+	charge(sd_open_us);
+
+	dp->handle = hostOpenDir(host);
+	if (!dp->handle)
+		return FR_NO_PATH;
+
+	return FR_OK;
+}
+
+FRESULT f_closedir(DIR* dp)
+{
+	if (!dp->handle)
+		return FR_INVALID_OBJECT;
+
+	hostCloseDir(dp->handle);
+	dp->handle = NULL;
+	return FR_OK;
+}
+
+FRESULT f_readdir(DIR* dp, FILINFO* fno)
+{
+	if (!dp->handle)
+		return FR_INVALID_OBJECT;
+
+	char name[256];
+	bool is_dir;
+
+	memset(fno, 0, sizeof(FILINFO));
+	if (hostReadDir(dp->handle, name, sizeof(name), &is_dir))
+	{
+		long long size;
+		time_t mtime;
+
+		snprintf(fno->fname, sizeof(fno->fname), "%s", name);
+		fno->fattrib = is_dir ? AM_DIR : AM_ARC;
+
+		if (hostStatDir(dp->handle, name, &size, &mtime))
+		{
+			fno->fsize = (FSIZE_t) size;
+			fatTime(mtime, &fno->fdate, &fno->ftime);
+		}
+	}
+
+	charge(sd_access_us);
+	return FR_OK;
+}
+
+FRESULT f_stat(const TCHAR* path, FILINFO* fno)
+{
+	char host[512];
+	struct stat st;
+
+	hostPath(path, host, sizeof(host));
+	charge(sd_open_us);
+
+	if (stat(host, &st) != 0)
+		return FR_NO_FILE;
+
+	if (fno)
+	{
+		memset(fno, 0, sizeof(FILINFO));
+		fno->fsize = (FSIZE_t) st.st_size;
+		fno->fattrib = S_ISDIR(st.st_mode) ? AM_DIR : AM_ARC;
+		fatTime(st.st_mtime, &fno->fdate, &fno->ftime);
+
+		const char* name = strrchr(host, '/');
+		if (snprintf(fno->fname, sizeof(fno->fname), "%s", name ? name + 1 : host) >=
+			(int) sizeof(fno->fname))
+			return FR_INVALID_NAME;
+	}
+
+	return FR_OK;
+}
+
+FRESULT f_unlink(const TCHAR* path)
+{
+	char host[512];
+	hostPath(path, host, sizeof(host));
+	charge(sd_open_us);
+
+	if (remove(host) != 0)
+		return errnoToResult();
+
+	return FR_OK;
+}
+
+FRESULT f_rename(const TCHAR* path_old, const TCHAR* path_new)
+{
+	char host_old[512];
+	char host_new[512];
+	hostPath(path_old, host_old, sizeof(host_old));
+	hostPath(path_new, host_new, sizeof(host_new));
+	charge(sd_open_us);
+
+	if (access(host_new, F_OK) == 0)
+		return FR_EXIST;
+
+	if (rename(host_old, host_new) != 0)
+		return errnoToResult();
+
+	return FR_OK;
+}
+
+FRESULT f_mkdir(const TCHAR* path)
+{
+	char host[512];
+	hostPath(path, host, sizeof(host));
+	charge(sd_open_us);
+
+	if (mkdir(host, 0755) != 0)
+		return errnoToResult();
+
+	return FR_OK;
+}
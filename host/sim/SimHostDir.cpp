@@ -0,0 +1,72 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### SimHostDir.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * Host directory access, kept apart from the FatFs stand-in because both define DIR.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+void* hostOpenDir(const char* path)
+{
+	return opendir(path);
+}
+
+bool hostReadDir(void* handle, char* name, size_t size, bool* is_dir)
+{
+	struct dirent* ent;
+
+	do {
+		ent = readdir((DIR*) handle);
+	} while (ent && (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0));
+
+	if (!ent)
+		return false;
+
+	snprintf(name, size, "%s", ent->d_name);
+	*is_dir = (ent->d_type == DT_DIR);
+	return true;
+}
+
+bool hostStatDir(void* handle, const char* name, long long* size, time_t* mtime)
+{
+	struct stat st;
+
+	if (fstatat(dirfd((DIR*) handle), name, &st, 0) != 0)
+		return false;
+
+	*size = (long long) st.st_size;
+	*mtime = st.st_mtime;
+	return true;
+}
+
+void hostCloseDir(void* handle)
+{
+	closedir((DIR*) handle);
+}
@@ -0,0 +1,213 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### SimLedStrip.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * LED strip driver, high-brightness LED driver and color helpers for the host build.
+ */
+
+#include <Arduino.h>
+#include <LedStripDriver.h>
+#include <bitmap.h>
+#include "Sim.h"
+
+// CIE 1931 lightness correction
+const uint8_t cie_lut[256] =
+{
+	  0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,
+	  2,   2,   2,   2,   2,   2,   2,   3,   3,   3,   3,   3,   3,   3,   3,   4,
+	  4,   4,   4,   4,   4,   5,   5,   5,   5,   5,   6,   6,   6,   6,   6,   7,
+	  7,   7,   7,   8,   8,   8,   8,   9,   9,   9,  10,  10,  10,  10,  11,  11,
+	 11,  12,  12,  12,  13,  13,  13,  14,  14,  15,  15,  15,  16,  16,  17,  17,
+	 17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,  23,  23,  24,  24,  25,
+	 25,  26,  26,  27,  28,  28,  29,  29,  30,  31,  31,  32,  32,  33,  34,  34,
+	 35,  36,  37,  37,  38,  39,  39,  40,  41,  42,  43,  43,  44,  45,  46,  47,
+	 47,  48,  49,  50,  51,  52,  53,  54,  54,  55,  56,  57,  58,  59,  60,  61,
+	 62,  63,  64,  65,  66,  67,  68,  70,  71,  72,  73,  74,  75,  76,  77,  79,
+	 80,  81,  82,  83,  85,  86,  87,  88,  90,  91,  92,  94,  95,  96,  98,  99,
+	100, 102, 103, 105, 106, 108, 109, 110, 112, 113, 115, 116, 118, 120, 121, 123,
+	124, 126, 128, 129, 131, 132, 134, 136, 138, 139, 141, 143, 145, 146, 148, 150,
+	152, 154, 155, 157, 159, 161, 163, 165, 167, 169, 171, 173, 175, 177, 179, 181,
+	183, 185, 187, 189, 191, 193, 196, 198, 200, 202, 204, 207, 209, 211, 214, 216,
+	218, 220, 223, 225, 228, 230, 232, 235, 237, 240, 242, 245, 247, 250, 252, 255,
+};
+
+COLOR randomColor()
+{
+	return COLOR((uint8_t) getRandom(0, 255), (uint8_t) getRandom(0, 255),
+				 (uint8_t) getRandom(0, 255), 0);
+}
+
+bool HBLED::begin(uint16_t max_current)
+{
+	current = max_current;
+	return current != 0;
+}
+
+LedStripData::LedStripData(uint32_t count) : count(count)
+{
+	leds = new COLOR[count];
+}
+
+LedStripData::~LedStripData()
+{
+	delete[] leds;
+}
+
+LedStripDriver::LedStripDriver() :
+	initialized(false), led_data(NULL), strip_type(WS2812B), led_count(0), brightness(1.0f),
+	tx_buffer(NULL), tx_size(0), busy_until(0), frames(0)
+{
+}
+
+LedStripDriver::~LedStripDriver()
+{
+	delete led_data;
+	delete[] tx_buffer;
+}
+
+bool LedStripDriver::begin(uint32_t count, LedStripeType type)
+{
+	if (!count)
+		return false;
+
+	delete led_data;
+	delete[] tx_buffer;
+
+	strip_type = type;
+	led_count = count;
+	led_data = new LedStripData(count);
+
+	// WS2812/SK6812 are driven through SPI with 3 bits per data bit, APA102 uses
+	// start/end frames plus 4 bytes per LED.
+	if (type == APA102)
+		tx_size = 4 + count * 4 + (count / 16) + 1;
+	else
+		tx_size = count * (type == SK6812RGBW ? 4 : 3) * 3;
+
+	tx_buffer = new uint8_t[tx_size];
+	initialized = true;
+	return true;
+}
+
+bool LedStripDriver::busy()
+{
+	return simMicros() < busy_until;
+}
+
+bool LedStripDriver::update(uint32_t index, bool async)
+{
+	return updateInternal(index, NULL, async);
+}
+
+void LedStripDriver::set(uint32_t index, const COLOR& color)
+{
+	set(index, color.r, color.g, color.b, color.w);
+}
+
+void LedStripDriver::set(uint32_t index, uint8_t r, uint8_t g, uint8_t b, uint8_t w)
+{
+	if (!initialized)
+		return;
+
+	if (index == 0)
+		setRange(1, led_count, r, g, b, w);
+	else
+		led_data->set(index, COLOR(r, g, b, w));
+}
+
+void LedStripDriver::setRange(uint32_t start, uint32_t end, const COLOR& color)
+{
+	setRange(start, end, color.r, color.g, color.b, color.w);
+}
+
+void LedStripDriver::setRange(uint32_t start, uint32_t end, uint8_t r, uint8_t g, uint8_t b,
+							  uint8_t w)
+{
+	if (!initialized)
+		return;
+
+	if (!start)
+		start = 1;
+
+	if (end > led_count)
+		end = led_count;
+
+	COLOR color(r, g, b, w);
+	for (uint32_t i = start; i <= end; i++)
+		led_data->set(i, color);
+}
+
+bool LedStripDriver::updateInternal(uint32_t index, LedStripData* data, bool async)
+{
+	UNUSED(index);
+	UNUSED(async);
+
+	if (!initialized || busy())
+		return false;
+
+	if (!data)
+		data = led_data;
+
+	// Encode the frame the way the SPI/DMA driver does
+	uint32_t out = 0;
+	for (uint32_t i = 1; i <= led_count; i++)
+	{
+		COLOR c = data->get(i);
+		uint8_t bytes[4] = { cie_lut[c.g], cie_lut[c.r], cie_lut[c.b], cie_lut[c.w] };
+		uint8_t len = (strip_type == SK6812RGBW) ? 4 : 3;
+
+		if (strip_type == APA102)
+		{
+			tx_buffer[4 + (i-1)*4] = 0xFF;
+			tx_buffer[4 + (i-1)*4 + 1] = bytes[2];
+			tx_buffer[4 + (i-1)*4 + 2] = bytes[0];
+			tx_buffer[4 + (i-1)*4 + 3] = bytes[1];
+			continue;
+		}
+
+		for (uint8_t j = 0; j < len; j++)
+		{
+			// Each data bit becomes 0b100 or 0b110
+			uint32_t bits = 0;
+			for (int8_t k = 7; k >= 0; k--)
+				bits = (bits << 3) | ((bytes[j] & (1 << k)) ? 0x6 : 0x4);
+
+			tx_buffer[out++] = (uint8_t) (bits >> 16);
+			tx_buffer[out++] = (uint8_t) (bits >> 8);
+			tx_buffer[out++] = (uint8_t) bits;
+		}
+	}
+
+	// Wire time: 1.25us per bit for WS2812/SK6812, 8MHz clock for APA102
+	uint64_t wire_us;
+	if (strip_type == APA102)
+		wire_us = (tx_size * 8) / 8;
+	else
+		wire_us = (led_count * (strip_type == SK6812RGBW ? 32 : 24) * 5) / 4;
+
+	busy_until = simMicros() + wire_us;
+	frames++;
+	return true;
+}
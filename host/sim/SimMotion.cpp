@@ -0,0 +1,154 @@
+/***************************************************************************
+ * PBSaber
+ * https://www.artekit.eu/doc/guides/propboard-pbsaber
+ *
+ * for Artekit PropBoard
+ * https://www.artekit.eu/products/devboards/propboard
+ *
+ * Written by Ivan Meleca
+ * Copyright (c) 2018 Artekit Labs
+ * https://www.artekit.eu
+
+### SimMotion.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+/*
+ * MMA8452 motion driver for the host build.
+ */
+
+#include <Arduino.h>
+
+MotionClass Motion;
+
+MotionClass::MotionClass() : enabled(false)
+{
+	memset(regs, 0, sizeof(regs));
+	callbacks[0] = callbacks[1] = NULL;
+	params[0] = params[1] = NULL;
+	accel[0] = accel[1] = 0;
+	accel[2] = 1.0f;
+}
+
+bool MotionClass::begin(uint8_t range, uint32_t odr, bool low_noise)
+{
+	UNUSED(range);
+	UNUSED(odr);
+	UNUSED(low_noise);
+	return true;
+}
+
+bool MotionClass::configPulse(uint8_t axis, float force, uint32_t time, uint32_t latency,
+							  MotionInterrupt intr)
+{
+	UNUSED(axis);
+	UNUSED(force);
+	UNUSED(time);
+	UNUSED(latency);
+	UNUSED(intr);
+	return true;
+}
+
+bool MotionClass::configTransient(uint8_t axis, float force, uint32_t time, MotionInterrupt intr)
+{
+	UNUSED(axis);
+	UNUSED(force);
+	UNUSED(time);
+	UNUSED(intr);
+	return true;
+}
+
+void MotionClass::attachInterruptWithParam(MotionInterrupt intr, motionCallback* fn, void* param)
+{
+	callbacks[intr - 1] = fn;
+	params[intr - 1] = param;
+}
+
+bool MotionClass::readRegister(uint8_t reg, uint8_t* value)
+{
+	if (reg >= sizeof(regs))
+		return false;
+
+	*value = regs[reg];
+	return true;
+}
+
+bool MotionClass::writeRegister(uint8_t reg, uint8_t value)
+{
+	if (reg >= sizeof(regs))
+		return false;
+
+	regs[reg] = value;
+	return true;
+}
+
+bool MotionClass::enable()
+{
+	enabled = true;
+	return true;
+}
+
+bool MotionClass::disable()
+{
+	enabled = false;
+	return true;
+}
+
+uint8_t MotionClass::getPulseSource()
+{
+	uint8_t src = regs[MMA8452_PULSE_SRC];
+	regs[MMA8452_PULSE_SRC] = 0;
+	return src;
+}
+
+uint8_t MotionClass::getTransientSource()
+{
+	uint8_t src = regs[MMA8452_TRANSIENT_SRC];
+	regs[MMA8452_TRANSIENT_SRC] = 0;
+	return src;
+}
+
+bool MotionClass::readAcceleration(float* x, float* y, float* z)
+{
+	*x = accel[0];
+	*y = accel[1];
+	*z = accel[2];
+	return true;
+}
+
+void MotionClass::simPulse(uint8_t src)
+{
+	if (!enabled)
+		return;
+
+	regs[MMA8452_PULSE_SRC] = src;
+	if (callbacks[0])
+		callbacks[0](params[0]);
+}
+
+void MotionClass::simTransient(uint8_t src)
+{
+	if (!enabled)
+		return;
+
+	regs[MMA8452_TRANSIENT_SRC] = src;
+	if (callbacks[1])
+		callbacks[1](params[1]);
+}
+
+void MotionClass::simSetAcceleration(float x, float y, float z)
+{
+	accel[0] = x;
+	accel[1] = y;
+	accel[2] = z;
+}